@@ -31,16 +31,56 @@ Lightweight C99 framework made for 7drl 2025.
 //use this define to make use of a dedicated game viewport (e.g. for 3d rendering)
 // #define CRLF_USE_GAMEVIEWPORT
 
-//use this define to add a scissor test to discard all stuff that is outside the
-//game's square viewport
+//use this define to cull all stuff that is outside the game's square viewport
 #define CRLF_USE_SQUARE_SCISSOR
 
+//use this define to upload rects in a quantized 48 byte format instead of the
+//124 byte float format: integer pixel positions, unorm colors and tex coords.
+//Enabled for web by default, where upload bandwidth is the most expensive.
+#if defined(SDL_PLATFORM_EMSCRIPTEN)
+#define CRLF_USE_PACKED_RECT_INSTANCES
+#endif
+
+//use this define to build the rect instances on a pool of worker threads.
+//Not available for web, as the emscripten build does not enable pthreads.
+#if !defined(SDL_PLATFORM_EMSCRIPTEN)
+#define CRLF_USE_RECT_BUILD_THREADS
+#endif
+
+//use this define to issue all gl calls from a dedicated render thread that
+//draws the previous frame while the main thread builds the next one. Not
+//available for web (no pthreads) and apple platforms, where the window and its
+//gl context are expected to stay on the main thread.
+#if !defined(SDL_PLATFORM_EMSCRIPTEN) && !defined(SDL_PLATFORM_APPLE)
+#define CRLF_USE_RENDER_THREAD
+#endif
+
+//use this define to capture frames (screenshots and frame sequences) through
+//asynchronous pixel buffer readback. Not available for web, as WebGL2 has no
+//glMapBufferRange and the emscripten build does not enable pthreads.
+#if !defined(SDL_PLATFORM_EMSCRIPTEN)
+#define CRLF_USE_FRAME_CAPTURE
+#endif
+
+//use this define to draw the ui straight into an srgb back buffer whenever
+//viewport_ui isn't needed, instead of blitting it with the gamma shader. The
+//back buffer of WebGL can't encode srgb.
+#if !defined(SDL_PLATFORM_EMSCRIPTEN)
+#define CRLF_USE_SRGB_BACK_BUFFER
+#endif
+
+//use this define to keep viewport_ui between frames and only redraw the
+//regions of the ui that changed since the previous frame
+#define CRLF_USE_UI_DAMAGE
+
 /* DEBUG DEFINES **************************************************************/
 #if !defined(__LEAK_DETECTION__)
 #define CRLF_malloc SDL_malloc
+#define CRLF_realloc SDL_realloc
 #define CRLF_free SDL_free
 #else
 #define CRLF_malloc malloc
+#define CRLF_realloc realloc
 #define CRLF_free free
 #if defined(__MSVC_CRT_LEAK_DETECTION__)
 #define _CRTDBG_MAP_ALLOC
@@ -48,6 +88,117 @@ Lightweight C99 framework made for 7drl 2025.
 #endif
 #endif
 
+/* SIMD ***********************************************************************/
+//The instruction set is picked at compile time, there is no runtime dispatch.
+//AVX2 has to be enabled explicitly (CRLF_ENABLE_AVX2 in CMake), SSE2 is the
+//baseline on x64, NEON on arm64 and simd128 on web (CRLF_ENABLE_SIMD128).
+//Only the handful of operations the rect kernels and the software renderer
+//need are wrapped here.
+//Floats are converted to integers with truncation, callers floor first.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CRLF_SIMD_AVX2
+#define CRLF_SIMD_NAME "avx2"
+#define CRLF_SIMD_LANES 8
+typedef __m256 Simd_F32;
+#define simd_load_f32 _mm256_loadu_ps
+#define simd_set1_f32 _mm256_set1_ps
+#define simd_add_f32 _mm256_add_ps
+#define simd_sub_f32 _mm256_sub_ps
+#define simd_mul_f32 _mm256_mul_ps
+#define simd_min_f32 _mm256_min_ps
+#define simd_max_f32 _mm256_max_ps
+#define simd_floor_f32 _mm256_floor_ps
+void simd_store_i32(i32* p, const Simd_F32 a) {
+    _mm256_storeu_si256((__m256i*)p, _mm256_cvttps_epi32(a));
+}
+//bit n is set if lane n of a is greater than lane n of b
+i32 simd_cmpgt_mask_f32(const Simd_F32 a, const Simd_F32 b) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ));
+}
+#elif defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CRLF_SIMD_SSE2
+#define CRLF_SIMD_NAME "sse2"
+#define CRLF_SIMD_LANES 4
+typedef __m128 Simd_F32;
+#define simd_load_f32 _mm_loadu_ps
+#define simd_set1_f32 _mm_set1_ps
+#define simd_add_f32 _mm_add_ps
+#define simd_sub_f32 _mm_sub_ps
+#define simd_mul_f32 _mm_mul_ps
+#define simd_min_f32 _mm_min_ps
+#define simd_max_f32 _mm_max_ps
+//SSE2 has no floor (SSE4.1): truncate and subtract one where that rounded up.
+//Only valid within the i32 range, which all kernel inputs are clamped to.
+Simd_F32 simd_floor_f32(const Simd_F32 a) {
+    const Simd_F32 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(
+        truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.f))
+    );
+}
+void simd_store_i32(i32* p, const Simd_F32 a) {
+    _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(a));
+}
+i32 simd_cmpgt_mask_f32(const Simd_F32 a, const Simd_F32 b) {
+    return _mm_movemask_ps(_mm_cmpgt_ps(a, b));
+}
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CRLF_SIMD_NEON
+#define CRLF_SIMD_NAME "neon"
+#define CRLF_SIMD_LANES 4
+typedef float32x4_t Simd_F32;
+#define simd_load_f32 vld1q_f32
+#define simd_set1_f32 vdupq_n_f32
+#define simd_add_f32 vaddq_f32
+#define simd_sub_f32 vsubq_f32
+#define simd_mul_f32 vmulq_f32
+#define simd_min_f32 vminq_f32
+#define simd_max_f32 vmaxq_f32
+//vrndmq_f32 is armv8 only, so floor the same way as the SSE2 path
+Simd_F32 simd_floor_f32(const Simd_F32 a) {
+    const Simd_F32 truncated = vcvtq_f32_s32(vcvtq_s32_f32(a));
+    const uint32x4_t rounded_up = vcgtq_f32(truncated, a);
+    return vsubq_f32(truncated, vreinterpretq_f32_u32(vandq_u32(
+        rounded_up, vreinterpretq_u32_f32(vdupq_n_f32(1.f))
+    )));
+}
+void simd_store_i32(i32* p, const Simd_F32 a) {
+    vst1q_s32(p, vcvtq_s32_f32(a));
+}
+//NEON has no movemask, weight the lanes and add them up instead
+i32 simd_cmpgt_mask_f32(const Simd_F32 a, const Simd_F32 b) {
+    static const u32 lane_bits[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vandq_u32(vcgtq_f32(a, b), vld1q_u32(lane_bits));
+    const uint32x2_t sum  = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+    return (i32)(vget_lane_u32(sum, 0) | vget_lane_u32(sum, 1));
+}
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define CRLF_SIMD_WASM
+#define CRLF_SIMD_NAME "simd128"
+#define CRLF_SIMD_LANES 4
+typedef v128_t Simd_F32;
+#define simd_load_f32 wasm_v128_load
+#define simd_set1_f32 wasm_f32x4_splat
+#define simd_add_f32 wasm_f32x4_add
+#define simd_sub_f32 wasm_f32x4_sub
+#define simd_mul_f32 wasm_f32x4_mul
+#define simd_min_f32 wasm_f32x4_min
+#define simd_max_f32 wasm_f32x4_max
+#define simd_floor_f32 wasm_f32x4_floor
+void simd_store_i32(i32* p, const Simd_F32 a) {
+    wasm_v128_store(p, wasm_i32x4_trunc_sat_f32x4(a));
+}
+i32 simd_cmpgt_mask_f32(const Simd_F32 a, const Simd_F32 b) {
+    return (i32)wasm_i32x4_bitmask(wasm_f32x4_gt(a, b));
+}
+#else
+#define CRLF_SIMD_NAME "none"
+#endif
+
 /* GLOBALS ********************************************************************/
 const char* APP_TITLE      = "ROGUELIKE GAME";
 const char* APP_VERSION    = "0.1.0";
@@ -74,6 +225,11 @@ UI_Context* ui_ctx;
 //for the entire Unicode range we use 96 characters
 #define FONT_UNICODE_START 32
 #define FONT_UNICODE_RANGE 96
+//Fonts are baked as signed distance fields: the alpha channel holds the
+//distance to the glyph edge, FONT_SDF_ON_EDGE on the edge itself and 0 at
+//FONT_SDF_PADDING texels outside of it. Outlines can be up to the padding wide.
+#define FONT_SDF_PADDING 2
+#define FONT_SDF_ON_EDGE 128
 
 const char* GLSL_SOURCE_HEADER =
 #if defined(SDL_PLATFORM_EMSCRIPTEN)
@@ -96,44 +252,241 @@ const char* test_shader_frag =
     "void main() {\n"
     "   FragColor = vec4(Color.rgb, 1.0);\n"
     "}";
+//Instanced: location 0 is the static unit quad, all other attributes advance
+//once per rect. The corner expansion formerly done on the cpu happens here.
+//Animated rects (UI_Animation) wobble and pulse against the time uniform, the
+//same way as the animated tiles in tilemap_shader_frag.
 const char* rect_shader_vert =
-    "layout(location = 0) in vec2 inPos;\n"
-    "layout(location = 1) in vec3 inColor;\n"
-    "layout(location = 2) in vec2 inTexCoord;\n"
-    "layout(location = 3) in float inSortOrder;\n"
-    "layout(location = 4) in int inTextureId;\n"
+    "precision highp float;\n"
+    "layout(location = 0) in vec2 inCorner;\n"
+    "layout(location = 1) in vec2 inPos;\n"
+    "layout(location = 2) in vec2 inSize;\n"
+    "layout(location = 3) in vec2 inPivot;\n"
+    "layout(location = 4) in vec4 inColor;\n"
+    "layout(location = 5) in float inSortOrder;\n"
+    "layout(location = 6) in vec4 inTexCoords;\n"
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES)
+    "layout(location = 7) in uvec2 inTextureId;\n" //texture id, animation flags
+#else
+    "layout(location = 7) in ivec2 inTextureId;\n"
+#endif
+    "layout(location = 8) in vec4 inOutline;\n"
+    "layout(location = 9) in vec2 inSlice;\n"
+    "layout(location = 10) in vec4 inAnimation;\n" //phase xy, amplitude xy
+    "layout(location = 11) in vec3 inPulseColor;\n"
+    "layout(location = 12) in float inFrequency;\n"
     "out vec2 TexCoords;\n"
-    "out vec3 Color;\n"
+    "out vec4 Color;\n"
+    "out vec4 Outline;\n"
+    "out vec2 SlicePos;\n"
     "flat out int TextureId;\n"
+    "flat out int Layer;\n"
+    "flat out vec4 SliceRect;\n" //size.xy, border pixels, border fraction
+    "flat out vec4 TexRect;\n"
     "uniform mat4 projection;\n"
+    "uniform vec2 sortOrderRange;\n"
+    "uniform float time;\n"
+    //first texture id of every array, see TEXTURE ARRAY SET
+    "uniform ivec4 textureArrayFirstIds;\n"
     "void main(){\n"
-    "    gl_Position = projection * vec4(inPos.xy, inSortOrder, 1.0);\n"
+    "    vec2 pos = inPos + (inCorner - inPivot) * inSize;\n"
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES)
+    "    vec2 slice = vec2(inSlice.x, inSlice.y / 32767.0);\n"
+    "    vec4 animation = inAnimation / 16.0;\n"
+    "    float frequency = inFrequency / 256.0;\n"
+#else
+    "    vec2 slice = inSlice;\n"
+    "    vec4 animation = inAnimation;\n"
+    "    float frequency = inFrequency;\n"
+#endif
+    "    int animationFlags = int(inTextureId.y);\n"
+    "    if ((animationFlags & 2) != 0) {\n" //UI_ANIMATION_WOBBLE
+    "        pos += vec2(\n"
+    "            sin((time + animation.x) * frequency) * animation.z,\n"
+    "            sin((time + animation.y) * frequency * 0.75) * animation.w\n"
+    "        );\n"
+    "    }\n"
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES)
+    //packed sort order is unorm16 across the sort order range
+    "    float sortOrder = mix(sortOrderRange.x, sortOrderRange.y, inSortOrder);\n"
+#else
+    "    float sortOrder = inSortOrder;\n"
+#endif
+    "    gl_Position = projection * vec4(pos, sortOrder, 1.0);\n"
     "    Color = inColor;\n"
-    "    TexCoords = inTexCoord;\n"
-    "    TextureId = inTextureId;\n"
+    "    if ((animationFlags & 1) != 0) {\n" //UI_ANIMATION_PULSE
+    "        Color.rgb = mix(\n"
+    "            inColor.rgb, inPulseColor, (sin(time + animation.x) + 1.0) * 0.5\n"
+    "        );\n"
+    "    }\n"
+    "    Outline = inOutline;\n"
+    "    TexCoords = mix(inTexCoords.xy, inTexCoords.zw, inCorner);\n"
+    "    TextureId = int(inTextureId.x);\n"
+    "    Layer = TextureId;\n"
+    "    for (int i = 3; i >= 0; i--) {\n"
+    "        if (TextureId >= textureArrayFirstIds[i]) {\n"
+    "            Layer = TextureId - textureArrayFirstIds[i];\n"
+    "            break;\n"
+    "        }\n"
+    "    }\n"
+    "    SlicePos = inCorner * inSize;\n"
+    "    SliceRect = vec4(inSize, slice);\n"
+    "    TexRect = inTexCoords;\n"
     "}";
+//Layers flagged in sdfLayers hold distance fields (sdf fonts). The texture
+//array uses nearest filtering for the pixel art, so the distance is filtered
+//by hand. Edges are resolved per screen pixel, which keeps glyphs crisp at any
+//scale, and the outline is just a second distance threshold.
+//Nine slices are a single quad: the borders keep their pixel size and the
+//center stretches, the tex coords of the slice are computed per pixel.
 const char* rect_shader_frag =
     "in vec2 TexCoords;\n"
-    "in vec3 Color;\n"
+    "in vec4 Color;\n"
+    "in vec4 Outline;\n"
+    "in vec2 SlicePos;\n"
     "flat in int TextureId;\n"
+    "flat in int Layer;\n"
+    "flat in vec4 SliceRect;\n"
+    "flat in vec4 TexRect;\n"
     "out vec4 FragColor;\n"
     "uniform mediump sampler2DArray textureArray;\n"
     "uniform float alphaClipThreshold;\n"
+    "uniform highp uint sdfLayers;\n"
+    "uniform float sdfPadding;\n"
+    //0-1 along one axis of the slice, pos and size in pixels
+    "float sliceAxis(float pos, float size, float border, float fraction) {\n"
+    "    if (pos < border) {\n"
+    "        return pos / border * fraction;\n"
+    "    }\n"
+    "    if (pos > size - border) {\n"
+    "        return 1.0 - (size - pos) / border * fraction;\n"
+    "    }\n"
+    "    return fraction + (pos - border) / max(size - 2.0 * border, 0.0001) *\n"
+    "        (1.0 - 2.0 * fraction);\n"
+    "}\n"
+    "float sampleDistance(vec2 uv) {\n"
+    "    ivec2 size = textureSize(textureArray, 0).xy;\n"
+    "    vec2 p = uv * vec2(size) - 0.5;\n"
+    "    ivec2 p0 = clamp(ivec2(floor(p)), ivec2(0), size - 1);\n"
+    "    ivec2 p1 = min(p0 + 1, size - 1);\n"
+    "    vec2 f = fract(p);\n"
+    "    float a00 = texelFetch(textureArray, ivec3(p0.x, p0.y, Layer), 0).a;\n"
+    "    float a10 = texelFetch(textureArray, ivec3(p1.x, p0.y, Layer), 0).a;\n"
+    "    float a01 = texelFetch(textureArray, ivec3(p0.x, p1.y, Layer), 0).a;\n"
+    "    float a11 = texelFetch(textureArray, ivec3(p1.x, p1.y, Layer), 0).a;\n"
+    "    float a = mix(mix(a00, a10, f.x), mix(a01, a11, f.x), f.y);\n"
+    //in texels, positive inside of the glyph
+    "    return (a * 255.0 - 128.0) / 128.0 * sdfPadding;\n"
+    "}\n"
     "void main() {\n"
     "    //TODO: Find out how stb_tt deals with the y-axis for the glyphs. For now we'll simply hardcode the flip here\n"
-    "    vec4 sampleColor = texture(textureArray, vec3(TexCoords.x, 1.0 - TexCoords.y, float(TextureId)));\n"
+    "    vec2 uv = vec2(TexCoords.x, 1.0 - TexCoords.y);\n"
+    "    if (SliceRect.z != 0.0) {\n"
+    "        float border = abs(SliceRect.z);\n"
+    "        vec2 slice = vec2(\n"
+    "            sliceAxis(SlicePos.x, SliceRect.x, border, SliceRect.w),\n"
+    "            sliceAxis(SlicePos.y, SliceRect.y, border, SliceRect.w)\n"
+    "        );\n"
+    "        bool isCenter = all(greaterThanEqual(SlicePos, vec2(border))) &&\n"
+    "            all(lessThanEqual(SlicePos, SliceRect.xy - border));\n"
+    "        if (SliceRect.z < 0.0 && isCenter) {\n"
+    "            discard;\n"
+    "        }\n"
+    "        vec2 sliceCoords = mix(TexRect.xy, TexRect.zw, slice);\n"
+    "        uv = vec2(sliceCoords.x, 1.0 - sliceCoords.y);\n"
+    "    }\n"
+    "    if (((sdfLayers >> uint(TextureId)) & 1u) != 0u) {\n"
+    "        float dist = sampleDistance(uv);\n"
+    "        float pixel = max(fwidth(dist), 0.0001);\n"
+    "        float coverage = clamp((dist + Outline.w * sdfPadding) / pixel + 0.5, 0.0, 1.0);\n"
+    "        if(coverage < alphaClipThreshold) {\n"
+    "            discard;\n"
+    "        }\n"
+    "        float fill = clamp(dist / pixel + 0.5, 0.0, 1.0);\n"
+    "        FragColor = vec4(mix(Outline.rgb, Color.rgb, fill), Color.a);\n"
+    "        return;\n"
+    "    }\n"
+    "    vec4 sampleColor = texture(textureArray, vec3(uv, float(Layer)));\n"
+    "    if(sampleColor.a < alphaClipThreshold) {\n"
+    "        discard;\n"
+    "    }\n"
+    "    FragColor = vec4(sampleColor.rgb * Color.rgb, Color.a);\n"
+    "}";
+const char* tilemap_shader_vert =
+    "precision highp float;\n"
+    "layout(location = 0) in vec2 inCorner;\n"
+    "out vec2 MapCoord;\n"
+    "uniform mat4 projection;\n"
+    "uniform vec4 screenRect;\n" //min.xy, size.zw
+    "uniform vec4 viewRect;\n"   //min.xy, size.zw in tiles
+    "uniform float sortOrder;\n"
+    "void main(){\n"
+    "    vec2 pos = screenRect.xy + inCorner * screenRect.zw;\n"
+    "    gl_Position = projection * vec4(pos, sortOrder, 1.0);\n"
+    "    MapCoord = viewRect.xy + inCorner * viewRect.zw;\n"
+    "}";
+//One lookup of the tile type per pixel, the cost only depends on the screen
+//size of the map. The animation of animated tiles mirrors the old per tile
+//UI_IMAGE: the wobble moves the texture inside its cell.
+const char* tilemap_shader_frag =
+    "precision highp float;\n"
+    "in vec2 MapCoord;\n"
+    "out vec4 FragColor;\n"
+    "uniform highp usampler2D tiles;\n"
+    "uniform mediump sampler2DArray textureArray;\n"
+    "uniform int textureLayer;\n"
+    "uniform ivec2 mapSize;\n"
+    "uniform int numTileTypes;\n"
+    //array sizes are UI_TILEMAP_MAX_TILE_TYPES
+    "uniform vec4 tileTexCoords[16];\n" //min.xy, max.zw
+    "uniform vec4 tileColors[16];\n"    //w > 0 = animated
+    "uniform vec3 tilePulseColors[16];\n"
+    "uniform vec2 tileWobble[16];\n"    //speed, displace
+    "uniform float time;\n"
+    "uniform float alphaClipThreshold;\n"
+    "void main() {\n"
+    "    ivec2 tile = ivec2(floor(MapCoord));\n"
+    "    if (any(lessThan(tile, ivec2(0))) || any(greaterThanEqual(tile, mapSize))) {\n"
+    "        discard;\n"
+    "    }\n"
+    "    int tileType = int(texelFetch(tiles, tile, 0).r);\n"
+    "    if (tileType >= numTileTypes) {\n"
+    "        discard;\n"
+    "    }\n"
+    "    vec2 local = MapCoord - vec2(tile);\n"
+    "    vec3 color = tileColors[tileType].rgb;\n"
+    "    if (tileColors[tileType].w > 0.0) {\n"
+    "        vec2 p = vec2(tile);\n"
+    "        vec2 wobble = tileWobble[tileType];\n"
+    "        vec2 offset = vec2(\n"
+    "            sin((time + p.x * p.y) * wobble.x) * wobble.y / 40.0,\n"
+    "            sin((time + p.x) * wobble.x * 0.75) * wobble.y / 20.0\n"
+    "        );\n"
+    "        local = fract(local - offset);\n"
+    "        color = mix(color, tilePulseColors[tileType], (sin(time + p.x * p.y) + 1.0) * 0.5);\n"
+    "    }\n"
+    "    vec4 cell = tileTexCoords[tileType];\n"
+    "    vec2 uv = mix(cell.xy, cell.zw, local);\n"
+    //local wraps at every tile edge, take the gradients from the continuous
+    //map coords so the mip selection doesn't jump there
+    "    vec2 cellSize = cell.zw - cell.xy;\n"
+    "    vec4 sampleColor = textureGrad(\n"
+    "        textureArray, vec3(uv.x, 1.0 - uv.y, float(textureLayer)),\n"
+    "        dFdx(MapCoord) * cellSize, dFdy(MapCoord) * cellSize\n"
+    "    );\n"
     "    if(sampleColor.a < alphaClipThreshold) {\n"
     "        discard;\n"
     "    }\n"
-    "    FragColor = vec4(sampleColor.rgb * Color, 1.0);\n"
+    "    FragColor = vec4(sampleColor.rgb * color, 1.0);\n"
     "}";
 const char* viewport_shader_vert =
     "layout (location = 0) in vec2 inPos;\n"
     "layout (location = 1) in vec2 inTexCoords;\n"
     "out vec2 TexCoords;\n"
+    "uniform vec2 texCoordScale;\n"
     "void main() {\n"
     "    gl_Position = vec4(inPos.x, inPos.y, 0.0, 1.0);\n"
-    "    TexCoords = inTexCoords;\n"
+    "    TexCoords = inTexCoords * texCoordScale;\n"
     "}";
 
 const char* viewport_shader_frag =
@@ -160,8 +513,330 @@ char TEMP_PATH[MAX_PATH_LEN];
 //For desktop this is 32 - but we'll go with the lowest common denominator: web
 #define MAX_TEXTURE_SLOTS 16
 
-#define RECT_BUFFER_CAPACITY 2048
-#define RECT_VERTEX_BUFFER_CAPACITY (RECT_BUFFER_CAPACITY*6)
+//Rect and instance buffers start at this capacity and grow on demand
+#define RECT_BUFFER_INITIAL_CAPACITY 2048
+//Max. instances per draw call - also the size of a rect stream buffer segment
+#define RECT_BATCH_CAPACITY 2048
+
+/* GL STATE *******************************************************************/
+/*  Shadows the gl state we touch, so redundant state changes are skipped.
+    On web every gl call crosses over to javascript, so this pays off most
+    there. All binds, blend, depth and scissor changes have to go through
+    here - a raw gl call would leave the shadow state stale. Deleting an
+    object unbinds it, the gl_state_forget_* functions mirror that.
+    Unknown values (-1 / GL_STATE_UNKNOWN) always get issued.
+*/
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+typedef struct {
+    u32 program;
+    u32 vertex_array;
+    u32 array_buffer;
+    u32 active_texture; //slot, not GL_TEXTUREi
+    u32 texture_2d[MAX_TEXTURE_SLOTS];
+    u32 texture_2d_array[MAX_TEXTURE_SLOTS];
+    i32 blend; //-1 unknown, 0 disabled, 1 enabled
+    i32 depth_test;
+    i32 scissor_test;
+    i32 framebuffer_srgb;
+    i32 depth_mask;
+    u32 blend_func[4]; //src rgb, dst rgb, src alpha, dst alpha
+    i32 scissor_box[4];
+    //per frame
+    i32 num_issued;
+    i32 num_elided;
+} GL_State;
+
+GL_State gl_state;
+
+//Forgets everything, e.g. after a new context was created
+void gl_state_invalidate() {
+    SDL_memset(&gl_state.program, 0xFF, offsetof(GL_State, num_issued));
+}
+
+void gl_state_begin_frame() {
+    gl_state.num_issued = 0;
+    gl_state.num_elided = 0;
+}
+
+//Returns true if the call has to be issued
+bool gl_state_update_u32(u32* cached, const u32 value) {
+    if (*cached == value) {
+        gl_state.num_elided++;
+        return false;
+    }
+    *cached = value;
+    gl_state.num_issued++;
+    return true;
+}
+
+bool gl_state_update_i32(i32* cached, const i32 value) {
+    return gl_state_update_u32((u32*)cached, (u32)value);
+}
+
+void gl_state_use_program(const u32 program) {
+    if (gl_state_update_u32(&gl_state.program, program)) glUseProgram(program);
+}
+
+void gl_state_bind_vertex_array(const u32 vertex_array) {
+    if (gl_state_update_u32(&gl_state.vertex_array, vertex_array))
+        glBindVertexArray(vertex_array);
+}
+
+void gl_state_bind_array_buffer(const u32 buffer) {
+    if (gl_state_update_u32(&gl_state.array_buffer, buffer))
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+}
+
+void gl_state_active_texture(const u32 slot) {
+    SDL_assert(slot < MAX_TEXTURE_SLOTS);
+    if (gl_state_update_u32(&gl_state.active_texture, slot))
+        glActiveTexture(GL_TEXTURE0 + slot);
+}
+
+//Also leaves slot as the active texture, as texture uploads rely on that
+void gl_state_bind_texture(
+    const u32 slot, const u32 target, const u32 texture
+) {
+    gl_state_active_texture(slot);
+    u32* cached = target == GL_TEXTURE_2D_ARRAY ?
+                      &gl_state.texture_2d_array[slot] :
+                      &gl_state.texture_2d[slot];
+    SDL_assert(target == GL_TEXTURE_2D || target == GL_TEXTURE_2D_ARRAY);
+    if (gl_state_update_u32(cached, texture)) glBindTexture(target, texture);
+}
+
+void gl_state_set_capability(const u32 capability, const bool enabled) {
+    i32* cached = NULL;
+    switch (capability) {
+    default: SDL_assert(0);
+        return;
+    case GL_BLEND: cached = &gl_state.blend;
+        break;
+    case GL_DEPTH_TEST: cached = &gl_state.depth_test;
+        break;
+    case GL_SCISSOR_TEST: cached = &gl_state.scissor_test;
+        break;
+#if defined(CRLF_USE_SRGB_BACK_BUFFER)
+    case GL_FRAMEBUFFER_SRGB: cached = &gl_state.framebuffer_srgb;
+        break;
+#endif
+    }
+    if (!gl_state_update_i32(cached, enabled)) return;
+    if (enabled) glEnable(capability);
+    else glDisable(capability);
+}
+
+void gl_state_depth_mask(const bool enabled) {
+    if (gl_state_update_i32(&gl_state.depth_mask, enabled))
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+}
+
+void gl_state_blend_func_separate(
+    const u32 src_rgb, const u32 dst_rgb, const u32 src_alpha,
+    const u32 dst_alpha
+) {
+    const u32 func[4] = {src_rgb, dst_rgb, src_alpha, dst_alpha};
+    if (SDL_memcmp(gl_state.blend_func, func, sizeof(func)) == 0) {
+        gl_state.num_elided++;
+        return;
+    }
+    SDL_memcpy(gl_state.blend_func, func, sizeof(func));
+    gl_state.num_issued++;
+    glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+}
+
+void gl_state_scissor(
+    const i32 x, const i32 y, const i32 width, const i32 height
+) {
+    const i32 box[4] = {x, y, width, height};
+    if (SDL_memcmp(gl_state.scissor_box, box, sizeof(box)) == 0) {
+        gl_state.num_elided++;
+        return;
+    }
+    SDL_memcpy(gl_state.scissor_box, box, sizeof(box));
+    gl_state.num_issued++;
+    glScissor(x, y, width, height);
+}
+
+void gl_state_forget_program(const u32 program) {
+    if (gl_state.program == program) gl_state.program = 0;
+}
+
+void gl_state_forget_vertex_array(const u32 vertex_array) {
+    if (gl_state.vertex_array == vertex_array) gl_state.vertex_array = 0;
+}
+
+void gl_state_forget_buffer(const u32 buffer) {
+    if (gl_state.array_buffer == buffer) gl_state.array_buffer = 0;
+}
+
+void gl_state_forget_texture(const u32 texture) {
+    for (u32 i = 0; i < MAX_TEXTURE_SLOTS; i++) {
+        if (gl_state.texture_2d[i] == texture) gl_state.texture_2d[i] = 0;
+        if (gl_state.texture_2d_array[i] == texture)
+            gl_state.texture_2d_array[i] = 0;
+    }
+}
+
+/* GPU TIMER ******************************************************************/
+/*  GL_TIME_ELAPSED queries around the render passes. A frame's results are
+    read back GPU_TIMER_FRAMES_IN_FLIGHT frames later, right before its queries
+    get reused. A result that is still pending by then is dropped rather than
+    waited for, so the timer never stalls the pipeline. Timer queries are core
+    since gl 3.3, on web they need EXT_disjoint_timer_query_webgl2 - without
+    it the timings just report is_available = false.
+*/
+#define GPU_TIMER_FRAMES_IN_FLIGHT 4
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+
+typedef struct {
+    bool is_available;
+    u32  queries[GPU_TIMER_FRAMES_IN_FLIGHT][CRLF_GPU_PASS_COUNT];
+    bool is_issued[GPU_TIMER_FRAMES_IN_FLIGHT][CRLF_GPU_PASS_COUNT];
+    i32  frame;       //slot of the frame being recorded
+    i32  active_pass; //-1 if no query is running
+    PFNGLGETQUERYOBJECTUI64VPROC get_query_u64;
+    SDL_Mutex*                   mutex; //guards timings and the frame totals
+    CRLF_GPU_Timings             timings;
+    float                        frame_ms;   //all passes of the newest frame
+    i32                          num_frames; //read back with a frame_ms
+} GPU_Timer;
+
+GPU_Timer gpu_timer;
+
+void gpu_timer_init() {
+    gpu_timer = (GPU_Timer){
+        .active_pass = -1,
+        .mutex = SDL_CreateMutex(),
+    };
+    SDL_assert(gpu_timer.mutex != NULL);
+#if defined(SDL_PLATFORM_EMSCRIPTEN)
+    if (SDL_GL_ExtensionSupported("GL_EXT_disjoint_timer_query_webgl2")) {
+        gpu_timer.get_query_u64 = (PFNGLGETQUERYOBJECTUI64VPROC)
+            SDL_GL_GetProcAddress("glGetQueryObjectui64vEXT");
+    }
+#else
+    if (GLAD_GL_VERSION_3_3) gpu_timer.get_query_u64 = glGetQueryObjectui64v;
+#endif
+    if (gpu_timer.get_query_u64 == NULL) {
+        log_msg("gpu timer queries: unavailable");
+        return;
+    }
+    glGenQueries(
+        GPU_TIMER_FRAMES_IN_FLIGHT * CRLF_GPU_PASS_COUNT,
+        &gpu_timer.queries[0][0]
+    );
+    gpu_timer.is_available         = true;
+    gpu_timer.timings.is_available = true;
+}
+
+void gpu_timer_cleanup() {
+    if (gpu_timer.is_available) {
+        glDeleteQueries(
+            GPU_TIMER_FRAMES_IN_FLIGHT * CRLF_GPU_PASS_COUNT,
+            &gpu_timer.queries[0][0]
+        );
+    }
+    if (gpu_timer.mutex != NULL) SDL_DestroyMutex(gpu_timer.mutex);
+    gpu_timer = (GPU_Timer){0};
+}
+
+void gpu_pass_timing_push(CRLF_GPU_Pass_Timing* timing, const float ms) {
+    timing->newest = timing->num_samples == 0 ? 0 :
+        (timing->newest + 1) % CRLF_GPU_TIMING_HISTORY;
+    timing->history_ms[timing->newest] = ms;
+    timing->num_samples = SDL_min(
+        timing->num_samples + 1, CRLF_GPU_TIMING_HISTORY
+    );
+    float total_ms = 0.f;
+    for (i32 i = 0; i < timing->num_samples; i++) {
+        total_ms += timing->history_ms[i];
+    }
+    timing->avg_ms = total_ms / (float)timing->num_samples;
+}
+
+//Collects the results of the oldest frame in flight and starts recording the
+//current one into its queries
+void gpu_timer_begin_frame() {
+    if (!gpu_timer.is_available) return;
+    SDL_assert(gpu_timer.active_pass < 0);
+    gpu_timer.frame = (gpu_timer.frame + 1) % GPU_TIMER_FRAMES_IN_FLIGHT;
+
+    //a disjoint operation (e.g. a gpu clock change) invalidates all results
+    bool is_disjoint = false;
+#if defined(SDL_PLATFORM_EMSCRIPTEN)
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    is_disjoint = disjoint != 0;
+#endif
+
+    const u32* queries   = gpu_timer.queries[gpu_timer.frame];
+    bool*      is_issued = gpu_timer.is_issued[gpu_timer.frame];
+    float      frame_ms  = 0.f;
+    bool       is_frame_complete = !is_disjoint;
+    SDL_LockMutex(gpu_timer.mutex);
+    for (i32 pass = 0; pass < CRLF_GPU_PASS_COUNT; pass++) {
+        if (!is_issued[pass]) continue;
+        is_issued[pass] = false;
+        GLuint is_ready = GL_FALSE;
+        glGetQueryObjectuiv(
+            queries[pass], GL_QUERY_RESULT_AVAILABLE, &is_ready
+        );
+        if (!is_ready) is_frame_complete = false;
+        if (!is_ready || is_disjoint) continue;
+        GLuint64 elapsed_ns = 0;
+        gpu_timer.get_query_u64(queries[pass], GL_QUERY_RESULT, &elapsed_ns);
+        gpu_pass_timing_push(
+            &gpu_timer.timings.passes[pass], (float)(elapsed_ns / 1.0e6)
+        );
+        frame_ms += (float)(elapsed_ns / 1.0e6);
+    }
+    if (is_frame_complete && frame_ms > 0.f) {
+        gpu_timer.frame_ms = frame_ms;
+        gpu_timer.num_frames++;
+    }
+    SDL_UnlockMutex(gpu_timer.mutex);
+}
+
+//Time elapsed queries can't be nested, every begin needs its end first
+void gpu_timer_begin(const CRLF_GPU_Pass pass) {
+    if (!gpu_timer.is_available) return;
+    SDL_assert(gpu_timer.active_pass < 0);
+    glBeginQuery(GL_TIME_ELAPSED, gpu_timer.queries[gpu_timer.frame][pass]);
+    gpu_timer.active_pass = pass;
+}
+
+void gpu_timer_end() {
+    if (!gpu_timer.is_available) return;
+    SDL_assert(gpu_timer.active_pass >= 0);
+    glEndQuery(GL_TIME_ELAPSED);
+    gpu_timer.is_issued[gpu_timer.frame][gpu_timer.active_pass] = true;
+    gpu_timer.active_pass = -1;
+}
+
+//CRLF_API.get_gpu_timings, may be called from any thread
+void gpu_timer_get_timings(CRLF_GPU_Timings* timings) {
+    if (gpu_timer.mutex == NULL) {
+        *timings = (CRLF_GPU_Timings){0};
+        return;
+    }
+    SDL_LockMutex(gpu_timer.mutex);
+    *timings = gpu_timer.timings;
+    SDL_UnlockMutex(gpu_timer.mutex);
+}
+
+//The gpu time of the newest frame read back since *num_frames, which gets
+//updated. Returns false if there is none, may be called from any thread.
+bool gpu_timer_get_frame_ms(i32* num_frames, float* frame_ms) {
+    if (gpu_timer.mutex == NULL) return false;
+    SDL_LockMutex(gpu_timer.mutex);
+    const bool is_new = gpu_timer.num_frames != *num_frames;
+    *num_frames       = gpu_timer.num_frames;
+    *frame_ms         = gpu_timer.frame_ms;
+    SDL_UnlockMutex(gpu_timer.mutex);
+    return is_new;
+}
 
 /* RENDERER *******************************************************************/
 typedef struct {
@@ -180,101 +855,607 @@ void renderer_bind(const Renderer* renderer) {
     SDL_assert(renderer != NULL);
     SDL_assert(renderer->vao != 0);
     SDL_assert(renderer->vbo != 0);
-    glBindBuffer(GL_ARRAY_BUFFER, renderer->vbo);
-    glBindVertexArray(renderer->vao); //TODO: really required for drawing?
+    gl_state_bind_array_buffer(renderer->vbo);
+    gl_state_bind_vertex_array(renderer->vao);
 }
 
 void renderer_cleanup(const Renderer* renderer) {
     SDL_assert(renderer->vbo != 0);
+    gl_state_forget_buffer(renderer->vbo);
     glDeleteBuffers(1, &renderer->vbo);
 
     SDL_assert(renderer->vao != 0);
+    gl_state_forget_vertex_array(renderer->vao);
     glDeleteVertexArrays(1, &renderer->vao);
 }
 
-/* PATH ***********************************************************************/
-typedef struct {
-    size_t length;
-    char   str[MAX_PATH_LEN];
-} Path;
+/* STREAM BUFFER **************************************************************/
+/*
+    Vertex data that is re-uploaded every frame goes through a stream buffer.
+
+    The gl buffer holds STREAM_BUFFER_FRAMES_IN_FLIGHT segments. Each frame
+    writes to its own segment via an unsynchronized map and places a fence
+    after its draw calls. A segment is only reused once its fence is signaled,
+    which under normal load happened long before we get there - so the upload
+    never waits on the gpu finishing the previous frame.
+
+    Frames that upload more than a segment simply move on to the next segment
+    mid-frame. That only stalls once a single frame wraps around the ring.
+    Writes that have to stay valid until later draws (all rect batches of a
+    frame are uploaded ahead of their draws) are reserved up front instead,
+    which grows the segments if a single one is too small.
+
+    WebGL2 has no glMapBufferRange, so there we fall back to orphaning the
+    buffer (glBufferData with NULL) and let the browser rename the storage.
+
+    The delta mode keeps the previous frame's data instead: a frame's writes
+    are laid out from the start of one growable buffer and every block of
+    STREAM_BUFFER_DELTA_BLOCK_SIZE bytes remembers the hash of its last upload.
+    Only the blocks whose hash changed are uploaded, unless so much changed
+    that a single upload of the whole write is cheaper. This is the default
+    for web, where every glBufferSubData is a copy on the js side. In return
+    the driver may have to synchronize with the previous frame's draws.
+ */
+#define STREAM_BUFFER_FRAMES_IN_FLIGHT 3
+//1ms - only used once the non-blocking check of a fence failed
+#define STREAM_BUFFER_FENCE_TIMEOUT_NS 1000000
+#define STREAM_BUFFER_DELTA_BLOCK_SIZE 4096
+//above this ratio of changed bytes the whole write is uploaded at once
+#define STREAM_BUFFER_DELTA_MAX_CHANGE_RATIO 0.5f
 
-void asset_path_init(const char* base_path, Path* asset_path) {
-    const char*  asset_str = "assets";
-    const size_t str_len   = SDL_strlen(base_path) + SDL_strlen(asset_str) + 4;
-    SDL_assert(str_len < MAX_PATH_LEN);
+typedef enum {
+    STREAM_BUFFER_MODE_RING,   //fenced ring of per-frame segments
+    STREAM_BUFFER_MODE_ORPHAN, //glBufferData(NULL) + glBufferSubData
+    STREAM_BUFFER_MODE_SYNC,   //plain glBufferSubData, kept for comparison
+    STREAM_BUFFER_MODE_DELTA,  //glBufferSubData of the changed blocks only
+    STREAM_BUFFER_MODE_COUNT,
+} Stream_Buffer_Mode;
+
+typedef struct {
+    u32                vbo;
+    Stream_Buffer_Mode mode;
+    size_t             segment_size; //in bytes, the max. upload per write
+    i32                segment;      //segment of the current frame
+    size_t             write_offset; //in bytes, relative to the segment
+    GLsync             fences[STREAM_BUFFER_FRAMES_IN_FLIGHT];
+    i32                num_fence_stalls; //waits that actually blocked
+    size_t             upload_bytes;     //uploaded during the current frame
+    //delta mode only
+    size_t capacity;         //in bytes, grows with the largest frame
+    u64*   block_hashes;     //hash of the last upload per block
+    u64*   temp_hashes;      //hashes of the write in progress
+    size_t num_valid_blocks; //blocks from here on have unknown contents
+} Stream_Buffer;
+
+const char* stream_buffer_mode_name(const Stream_Buffer_Mode mode) {
+    switch (mode) {
+    case STREAM_BUFFER_MODE_RING: return "ring";
+    case STREAM_BUFFER_MODE_ORPHAN: return "orphan";
+    case STREAM_BUFFER_MODE_SYNC: return "sync";
+    case STREAM_BUFFER_MODE_DELTA: return "delta";
+    default: SDL_assert(0);
+        return "";
+    }
+}
 
+Stream_Buffer_Mode stream_buffer_default_mode() {
 #if defined(SDL_PLATFORM_EMSCRIPTEN)
-    SDL_snprintf(asset_path->str, MAX_PATH_LEN, "%s%s%c",
-     base_path, asset_str, PATH_SLASH);
+    return STREAM_BUFFER_MODE_DELTA;
 #else
-    SDL_snprintf(
-        asset_path->str, MAX_PATH_LEN, "%s..%c%s%c",
-        base_path, PATH_SLASH, asset_str, PATH_SLASH
-    );
+    return STREAM_BUFFER_MODE_RING;
 #endif
-    asset_path->length = SDL_strlen(asset_path->str);
 }
 
-char* temp_path_append(const char* base, const char* file) {
-    SDL_assert(SDL_strlen(base) + SDL_strlen(file) < MAX_PATH_LEN);
-    SDL_snprintf(TEMP_PATH, MAX_PATH_LEN, "%s%s", base, file);
-    return TEMP_PATH;
+void stream_buffer_wait_fence(Stream_Buffer* stream, const GLsync fence) {
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        return;
+
+    stream->num_fence_stalls++;
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(
+            fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_BUFFER_FENCE_TIMEOUT_NS
+        );
+    }
+    SDL_assert(result != GL_WAIT_FAILED);
 }
 
-/* TEXTURE ********************************************************************/
-/*
-    For 7drl 2025 we want to use a SINGLE texture array for all things ui.
- */
-typedef enum {
-    TEXTURE_RAW_SOURCE_STB_IMAGE, //loaded via STB_Image
-    TEXTURE_RAW_SOURCE_DYNAMIC,   //loaded from Memory
-} Raw_Texture_Source;
+void stream_buffer_release_fences(Stream_Buffer* stream) {
+    for (i32 i = 0; i < STREAM_BUFFER_FRAMES_IN_FLIGHT; i++) {
+        if (stream->fences[i] == NULL) continue;
+        stream_buffer_wait_fence(stream, stream->fences[i]);
+        glDeleteSync(stream->fences[i]);
+        stream->fences[i] = NULL;
+    }
+}
 
-typedef struct {
-    i32 rows;
-    i32 columns;
-} Texture_Atlas;
+void stream_buffer_allocate(Stream_Buffer* stream) {
+    size_t size  = stream->segment_size;
+    GLenum usage = GL_STREAM_DRAW;
+    switch (stream->mode) {
+    default: SDL_assert(0);
+        break;
+    case STREAM_BUFFER_MODE_RING:
+        size *= STREAM_BUFFER_FRAMES_IN_FLIGHT;
+        break;
+    case STREAM_BUFFER_MODE_ORPHAN:
+        break;
+    case STREAM_BUFFER_MODE_SYNC:
+        usage = GL_STATIC_DRAW;
+        break;
+    case STREAM_BUFFER_MODE_DELTA: {
+        const size_t num_blocks = stream->capacity /
+            STREAM_BUFFER_DELTA_BLOCK_SIZE;
+        size  = stream->capacity;
+        usage = GL_DYNAMIC_DRAW;
+        stream->block_hashes = CRLF_realloc(
+            stream->block_hashes, num_blocks * sizeof(u64)
+        );
+        stream->temp_hashes = CRLF_realloc(
+            stream->temp_hashes, num_blocks * sizeof(u64)
+        );
+        SDL_assert(stream->block_hashes != NULL);
+        SDL_assert(stream->temp_hashes != NULL);
+        stream->num_valid_blocks = 0;
+        break;
+    }
+    }
+    gl_state_bind_array_buffer(stream->vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, NULL, usage);
+}
 
-typedef struct {
-    i32                width, height, channels;
-    u8*                data;
-    Raw_Texture_Source source;
-} Raw_Texture;
+void stream_buffer_init(
+    Stream_Buffer*           stream,
+    const size_t             segment_size,
+    const Stream_Buffer_Mode mode
+) {
+    *stream = (Stream_Buffer){
+        .mode = mode,
+        .segment_size = segment_size,
+        //enough for a few segments per frame, rounded up to whole blocks
+        .capacity = (segment_size * STREAM_BUFFER_FRAMES_IN_FLIGHT +
+                STREAM_BUFFER_DELTA_BLOCK_SIZE - 1) /
+            STREAM_BUFFER_DELTA_BLOCK_SIZE * STREAM_BUFFER_DELTA_BLOCK_SIZE,
+    };
+    glGenBuffers(1, &stream->vbo);
+    SDL_assert(stream->vbo != 0);
+    stream_buffer_allocate(stream);
+}
 
-typedef struct {
-    u32 id;
-    i32 width, height, channels;
-} GL_Texture;
+void stream_buffer_set_mode(
+    Stream_Buffer*           stream,
+    const Stream_Buffer_Mode mode
+) {
+#if defined(SDL_PLATFORM_EMSCRIPTEN)
+    if (mode == STREAM_BUFFER_MODE_RING) return;
+#endif
+    stream_buffer_release_fences(stream);
+    stream->mode         = mode;
+    stream->segment      = 0;
+    stream->write_offset = 0;
+    stream_buffer_allocate(stream);
+}
 
-typedef struct {
-    i32 internal_format;
-    u32 format;
-} GL_Texture_Format;
+void stream_buffer_cleanup(Stream_Buffer* stream) {
+    stream_buffer_release_fences(stream);
+    CRLF_free(stream->block_hashes);
+    CRLF_free(stream->temp_hashes);
+    stream->block_hashes = NULL;
+    stream->temp_hashes  = NULL;
+    SDL_assert(stream->vbo != 0);
+    gl_state_forget_buffer(stream->vbo);
+    glDeleteBuffers(1, &stream->vbo);
+}
 
-typedef struct {
-    bool filter;
-    bool repeat;
-    bool gamma_correction;
-} Texture_Config;
+//Fences the draws issued from the current segment (unless that already
+//happened) and moves on to the next one, waiting only if the gpu still reads
+//from it.
+void stream_buffer_next_segment(Stream_Buffer* stream) {
+    stream->write_offset = 0;
+    if (stream->mode != STREAM_BUFFER_MODE_RING) return;
 
-Texture_Config default_texture_config() {
-    return (Texture_Config){
-        .filter = false,
-        .repeat = true,
-        .gamma_correction = false,
-    };
+    if (stream->fences[stream->segment] == NULL) {
+        stream->fences[stream->segment] = glFenceSync(
+            GL_SYNC_GPU_COMMANDS_COMPLETE, 0
+        );
+    }
+    stream->segment = (stream->segment + 1) % STREAM_BUFFER_FRAMES_IN_FLIGHT;
+    const GLsync fence = stream->fences[stream->segment];
+    if (fence == NULL) return;
+    stream_buffer_wait_fence(stream, fence);
+    glDeleteSync(fence);
+    stream->fences[stream->segment] = NULL;
 }
 
-Texture_Config default_texture_config_gammacorrect() {
-    return (Texture_Config){
-        .filter = false,
-        .repeat = true,
-        .gamma_correction = true,
-    };
+void stream_buffer_begin_frame(Stream_Buffer* stream) {
+    stream->upload_bytes = 0;
+    stream_buffer_next_segment(stream);
 }
 
-Raw_Texture* raw_texture_rgba_from_single_channel(
-    const u8* single_channel_data,
+//Makes sure the next num_writes writes of size bytes in total neither move on
+//to another segment nor reallocate the buffer, so none of their offsets gets
+//invalidated before the draws reading them are issued.
+void stream_buffer_reserve(
+    Stream_Buffer* stream,
+    const size_t   size,
+    const size_t   num_writes
+) {
+    if (stream->mode == STREAM_BUFFER_MODE_DELTA) {
+        //every write starts at a block boundary
+        const size_t block_size = STREAM_BUFFER_DELTA_BLOCK_SIZE;
+        const size_t end        = stream->write_offset + size +
+            num_writes * (block_size - 1);
+        if (end <= stream->capacity) return;
+        stream->capacity = SDL_max(
+            stream->capacity * 2,
+            (end + block_size - 1) / block_size * block_size
+        );
+        stream_buffer_allocate(stream);
+        return;
+    }
+    if (stream->write_offset + size <= stream->segment_size) return;
+    if (size <= stream->segment_size) {
+        stream_buffer_next_segment(stream);
+        return;
+    }
+    stream_buffer_release_fences(stream);
+    stream->segment_size = SDL_max(stream->segment_size * 2, size);
+    stream->segment      = 0;
+    stream->write_offset = 0;
+    stream_buffer_allocate(stream);
+}
+
+//FNV-1a variant that consumes 8 bytes per step
+u64 stream_buffer_hash_block(const u8* bytes, const size_t size) {
+    u64    hash = 0xcbf29ce484222325ULL ^ size;
+    size_t i    = 0;
+    for (; i + sizeof(u64) <= size; i += sizeof(u64)) {
+        u64 word;
+        SDL_memcpy(&word, &bytes[i], sizeof(u64));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+//Writes start at block boundaries, so no block is shared between two writes
+size_t stream_buffer_write_delta(
+    Stream_Buffer* stream,
+    const void*    data,
+    const size_t   size
+) {
+    const size_t block_size = STREAM_BUFFER_DELTA_BLOCK_SIZE;
+    const size_t offset     = (stream->write_offset + block_size - 1) /
+        block_size * block_size;
+    if (offset + size > stream->capacity) {
+        //the draws issued so far keep reading from the orphaned storage
+        stream->capacity = SDL_max(
+            stream->capacity * 2,
+            (offset + size + block_size - 1) / block_size * block_size
+        );
+        stream_buffer_allocate(stream);
+    }
+    gl_state_bind_array_buffer(stream->vbo);
+
+    const u8*    bytes       = data;
+    const size_t first_block = offset / block_size;
+    const size_t num_blocks  = (size + block_size - 1) / block_size;
+    size_t       changed     = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+        const size_t block = first_block + i;
+        const size_t len   = SDL_min(block_size, size - i * block_size);
+        stream->temp_hashes[block] = stream_buffer_hash_block(
+            &bytes[i * block_size], len
+        );
+        if (block >= stream->num_valid_blocks ||
+            stream->temp_hashes[block] != stream->block_hashes[block]) {
+            changed += len;
+        }
+    }
+
+    if ((float)changed > (float)size * STREAM_BUFFER_DELTA_MAX_CHANGE_RATIO) {
+        glBufferSubData(
+            GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)size, data
+        );
+        stream->upload_bytes += size;
+    } else {
+        //one upload per run of adjacent changed blocks
+        size_t run_start = 0, run_len = 0;
+        for (size_t i = 0; i <= num_blocks; i++) {
+            const size_t block      = first_block + i;
+            const bool   is_changed = i < num_blocks && (
+                block >= stream->num_valid_blocks ||
+                stream->temp_hashes[block] != stream->block_hashes[block]);
+            if (is_changed) {
+                if (run_len == 0) run_start = i * block_size;
+                run_len += SDL_min(block_size, size - i * block_size);
+                continue;
+            }
+            if (run_len == 0) continue;
+            glBufferSubData(
+                GL_ARRAY_BUFFER, (GLintptr)(offset + run_start),
+                (GLsizeiptr)run_len, &bytes[run_start]
+            );
+            stream->upload_bytes += run_len;
+            run_len = 0;
+        }
+    }
+
+    SDL_memcpy(
+        &stream->block_hashes[first_block], &stream->temp_hashes[first_block],
+        num_blocks * sizeof(u64)
+    );
+    //only extend the known prefix - blocks before a mid-frame grow are unknown
+    if (first_block <= stream->num_valid_blocks) {
+        stream->num_valid_blocks = SDL_max(
+            stream->num_valid_blocks, first_block + num_blocks
+        );
+    }
+    stream->write_offset = offset + size;
+    return offset;
+}
+
+//Copies the data to the current segment and returns its byte offset inside
+//the gl buffer. The stream buffer is left bound to GL_ARRAY_BUFFER.
+size_t stream_buffer_write(
+    Stream_Buffer* stream,
+    const void*    data,
+    const size_t   size
+) {
+    SDL_assert(size <= stream->segment_size);
+    if (stream->mode == STREAM_BUFFER_MODE_DELTA) {
+        return stream_buffer_write_delta(stream, data, size);
+    }
+    if (stream->write_offset + size > stream->segment_size) {
+        stream_buffer_next_segment(stream);
+    }
+    gl_state_bind_array_buffer(stream->vbo);
+
+    size_t offset = stream->write_offset;
+    switch (stream->mode) {
+    default: SDL_assert(0);
+        break;
+    case STREAM_BUFFER_MODE_RING: {
+        offset += (size_t)stream->segment * stream->segment_size;
+        void* dst = glMapBufferRange(
+            GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT
+        );
+        SDL_assert(dst != NULL);
+        SDL_memcpy(dst, data, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        break;
+    }
+    case STREAM_BUFFER_MODE_ORPHAN:
+        if (stream->write_offset == 0) {
+            glBufferData(
+                GL_ARRAY_BUFFER, (GLsizeiptr)stream->segment_size, NULL,
+                GL_STREAM_DRAW
+            );
+        }
+        glBufferSubData(
+            GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)size, data
+        );
+        break;
+    case STREAM_BUFFER_MODE_SYNC:
+        glBufferSubData(
+            GL_ARRAY_BUFFER, (GLintptr)offset, (GLsizeiptr)size, data
+        );
+        break;
+    }
+
+    stream->write_offset += size;
+    stream->upload_bytes += size;
+    return offset;
+}
+
+//Call after the last draw call reading from this frame's segment
+void stream_buffer_end_frame(Stream_Buffer* stream) {
+    if (stream->mode != STREAM_BUFFER_MODE_RING) return;
+    if (stream->fences[stream->segment] != NULL) return;
+    stream->fences[stream->segment] = glFenceSync(
+        GL_SYNC_GPU_COMMANDS_COMPLETE, 0
+    );
+}
+
+/* FRAME TIMING ***************************************************************/
+//Averages cpu frame times over a number of frames, used to benchmark the
+//renderer in debug builds.
+#define FRAME_TIMING_SAMPLES 300
+
+typedef struct {
+    u64 begin;
+    u64 total;
+    i32 num_samples;
+} Frame_Timing;
+
+void frame_timing_begin(Frame_Timing* timing) {
+    timing->begin = SDL_GetPerformanceCounter();
+}
+
+//Returns true once FRAME_TIMING_SAMPLES frames have been measured. The average
+//frame time in ms is then written to avg_ms and the timing starts over.
+bool frame_timing_end(Frame_Timing* timing, double* avg_ms) {
+    timing->total += SDL_GetPerformanceCounter() - timing->begin;
+    timing->num_samples++;
+    if (timing->num_samples < FRAME_TIMING_SAMPLES) return false;
+
+    *avg_ms = (double)timing->total * 1000.0 /
+        (double)SDL_GetPerformanceFrequency() / (double)timing->num_samples;
+    timing->total       = 0;
+    timing->num_samples = 0;
+    return true;
+}
+
+/* DYNAMIC RESOLUTION *********************************************************/
+/*  Scales the frame buffers of the viewports to keep the frame time within
+    RESOLUTION_TARGET_MS. The frame time is the gpu time of all passes. Without
+    timer queries (web without the extension) the scaler stays off: the time
+    between two frames is paced by vsync and says nothing about the fill cost.
+    The quality is a factor on the render_scale_max of every viewport. The fill
+    cost goes with the number of pixels, so the quality that hits a frame time
+    is quality * sqrt(frame time / smoothed frame time). To not oscillate, the
+    quality only goes down above RESOLUTION_DOWN_MS and back up below
+    RESOLUTION_UP_MS, aiming in between. After a change the scaler waits
+    RESOLUTION_SETTLE_FRAMES before the next one, as the gpu timings lag behind
+    and the smoothed frame time has to catch up.
+*/
+#define RESOLUTION_TARGET_MS 16.6f
+#define RESOLUTION_DOWN_MS (RESOLUTION_TARGET_MS * .9f)
+#define RESOLUTION_UP_MS (RESOLUTION_TARGET_MS * .7f)
+#define RESOLUTION_AIM_MS (RESOLUTION_TARGET_MS * .8f)
+#define RESOLUTION_SETTLE_FRAMES 30
+#define RESOLUTION_SMOOTHING .1f
+#define RESOLUTION_QUALITY_MIN .5f
+#define RESOLUTION_QUALITY_STEPS 16 //between quality 0 and 1
+
+typedef struct {
+    bool  is_automatic;
+    float quality;    //RESOLUTION_QUALITY_MIN to 1
+    float frame_ms;   //smoothed
+    i32   num_frames; //since the last change
+    i32   num_gpu_frames;
+} Resolution_Scaler;
+
+Resolution_Scaler resolution_scaler_create(const bool is_automatic) {
+    return (Resolution_Scaler){
+        .is_automatic = is_automatic,
+        .quality = 1.f,
+    };
+}
+
+float resolution_quality_clamp(const float quality) {
+    return SDL_clamp(quality, RESOLUTION_QUALITY_MIN, 1.f);
+}
+
+//Steps the quality by num_steps, e.g. for the debug keys
+void resolution_scaler_step(Resolution_Scaler* scaler, const i32 num_steps) {
+    const float step   = 1.f / (float)RESOLUTION_QUALITY_STEPS;
+    scaler->quality    = resolution_quality_clamp(
+        scaler->quality + step * (float)num_steps
+    );
+    scaler->num_frames = 0;
+}
+
+//Once per frame, before the frame buffer sizes get picked
+void resolution_scaler_update(Resolution_Scaler* scaler) {
+    if (!scaler->is_automatic || !gpu_timer.is_available) return;
+    float ms;
+    if (!gpu_timer_get_frame_ms(&scaler->num_gpu_frames, &ms)) return;
+    //a hitch (or a window that was in the background) must not count much
+    ms = SDL_min(ms, RESOLUTION_TARGET_MS * 2.f);
+    scaler->frame_ms = scaler->num_frames == 0 ? ms :
+        scaler->frame_ms + (ms - scaler->frame_ms) * RESOLUTION_SMOOTHING;
+    scaler->num_frames++;
+    if (scaler->num_frames < RESOLUTION_SETTLE_FRAMES) return;
+
+    const float frame_ms = scaler->frame_ms;
+    if (frame_ms <= RESOLUTION_DOWN_MS && frame_ms >= RESOLUTION_UP_MS) return;
+    const float steps = (float)RESOLUTION_QUALITY_STEPS;
+    const float aim   = scaler->quality *
+        SDL_sqrtf(RESOLUTION_AIM_MS / SDL_max(frame_ms, .01f));
+    //at least one step, in the direction of the aim
+    const i32 num_steps = (i32)((aim - scaler->quality) * steps);
+    resolution_scaler_step(
+        scaler, frame_ms > RESOLUTION_DOWN_MS ?
+                    SDL_min(num_steps, -1) : SDL_max(num_steps, 1)
+    );
+}
+
+//The render scale of a viewport at the current quality
+float resolution_scale(
+    const Resolution_Scaler* scaler,
+    const float              render_scale_max
+) {
+    return render_scale_max * scaler->quality;
+}
+
+/* PATH ***********************************************************************/
+typedef struct {
+    size_t length;
+    char   str[MAX_PATH_LEN];
+} Path;
+
+void asset_path_init(const char* base_path, Path* asset_path) {
+    const char*  asset_str = "assets";
+    const size_t str_len   = SDL_strlen(base_path) + SDL_strlen(asset_str) + 4;
+    SDL_assert(str_len < MAX_PATH_LEN);
+
+#if defined(SDL_PLATFORM_EMSCRIPTEN)
+    SDL_snprintf(asset_path->str, MAX_PATH_LEN, "%s%s%c",
+     base_path, asset_str, PATH_SLASH);
+#else
+    SDL_snprintf(
+        asset_path->str, MAX_PATH_LEN, "%s..%c%s%c",
+        base_path, PATH_SLASH, asset_str, PATH_SLASH
+    );
+#endif
+    asset_path->length = SDL_strlen(asset_path->str);
+}
+
+char* temp_path_append(const char* base, const char* file) {
+    SDL_assert(SDL_strlen(base) + SDL_strlen(file) < MAX_PATH_LEN);
+    SDL_snprintf(TEMP_PATH, MAX_PATH_LEN, "%s%s", base, file);
+    return TEMP_PATH;
+}
+
+/* TEXTURE ********************************************************************/
+/*
+    For 7drl 2025 we want to use a SINGLE texture array for all things ui.
+ */
+typedef enum {
+    TEXTURE_RAW_SOURCE_STB_IMAGE, //loaded via STB_Image
+    TEXTURE_RAW_SOURCE_DYNAMIC,   //loaded from Memory
+} Raw_Texture_Source;
+
+typedef struct {
+    i32 rows;
+    i32 columns;
+} Texture_Atlas;
+
+typedef struct {
+    i32                width, height, channels;
+    u8*                data;
+    Raw_Texture_Source source;
+} Raw_Texture;
+
+typedef struct {
+    u32 id;
+    i32 width, height, channels;
+} GL_Texture;
+
+typedef struct {
+    i32 internal_format;
+    u32 format;
+} GL_Texture_Format;
+
+typedef struct {
+    bool filter;
+    bool repeat;
+    bool gamma_correction;
+} Texture_Config;
+
+Texture_Config default_texture_config() {
+    return (Texture_Config){
+        .filter = false,
+        .repeat = true,
+        .gamma_correction = false,
+    };
+}
+
+Texture_Config default_texture_config_gammacorrect() {
+    return (Texture_Config){
+        .filter = false,
+        .repeat = true,
+        .gamma_correction = true,
+    };
+}
+
+Raw_Texture* raw_texture_rgba_from_single_channel(
+    const u8* single_channel_data,
     const i32 width, const i32 height
 ) {
     Raw_Texture* raw_texture = CRLF_malloc(sizeof(Raw_Texture));
@@ -297,6 +1478,22 @@ Raw_Texture* raw_texture_rgba_from_single_channel(
     return raw_texture;
 }
 
+//White rgb with the single channel in alpha, as used by the sdf fonts
+Raw_Texture* raw_texture_rgba_from_alpha(
+    const u8* alpha_data,
+    const i32 width, const i32 height
+) {
+    Raw_Texture* raw_texture = raw_texture_rgba_from_single_channel(
+        alpha_data, width, height
+    );
+    for (i32 i = 0; i < width * height; i++) {
+        raw_texture->data[i * 4 + 0] = 255; //R
+        raw_texture->data[i * 4 + 1] = 255; //G
+        raw_texture->data[i * 4 + 2] = 255; //B
+    }
+    return raw_texture;
+}
+
 Raw_Texture* raw_texture_from_file(
     const char* file_path
 ) {
@@ -339,10 +1536,7 @@ void gl_texture_bind(const GL_Texture* texture, const u32 slot) {
     SDL_assert(texture != NULL);
     SDL_assert(texture->id > 0);
     SDL_assert(slot < MAX_TEXTURE_SLOTS);
-
-    // TODO: optimize via caching the active texture!
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, texture->id);
+    gl_state_bind_texture(slot, GL_TEXTURE_2D, texture->id);
 }
 
 GL_Texture_Format gl_texture_get_format(
@@ -427,6 +1621,7 @@ GL_Texture gl_texture_from_raw_texture(
 void gl_texture_delete(const GL_Texture* texture) {
     SDL_assert(texture != NULL);
     SDL_assert(texture->id > 0);
+    gl_state_forget_texture(texture->id);
     glDeleteTextures(1, &texture->id);
 }
 
@@ -445,8 +1640,7 @@ void gl_texture_array_bind(
     SDL_assert(texture_array != NULL);
     SDL_assert(texture_array->id > 0);
     SDL_assert(slot < MAX_TEXTURE_SLOTS);
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array->id);
+    gl_state_bind_texture(slot, GL_TEXTURE_2D_ARRAY, texture_array->id);
 }
 
 GL_Texture_Array gl_texture_array_generate(
@@ -517,9 +1711,101 @@ GL_Texture_Array gl_texture_array_generate(
 void texture_array_free(const GL_Texture_Array* texture_array) {
     SDL_assert(texture_array != NULL);
     SDL_assert(texture_array->id > 0);
+    gl_state_forget_texture(texture_array->id);
     glDeleteTextures(1, &texture_array->id);
 }
 
+/* TEXTURE ARRAY SET **********************************************************/
+/*  One texture array per layer resolution, so big art and tiny icons don't
+    have to share the size of a single array. app_init hands out the texture
+    resource ids array by array: every array holds a contiguous range of ids
+    and the layer of a texture is its id minus the first id of its array.
+    The rects are sorted by array (see RECT SORTING), a run of rects sampling
+    the same array is drawn with one draw call.
+*/
+#define TEXTURE_ARRAY_COUNT 4
+//square layers only, a texture has to match one of the sizes exactly
+const i32 TEXTURE_ARRAY_SIZES[TEXTURE_ARRAY_COUNT] = {64, 128, 512, 2048};
+
+//the rect shader looks the arrays up through an ivec4, the sort key has 2 bits
+SDL_COMPILE_TIME_ASSERT(texture_array_count, TEXTURE_ARRAY_COUNT == 4);
+
+//Which texture ids live in which array, immutable after app_init
+typedef struct {
+    i32 first_texture_id[TEXTURE_ARRAY_COUNT];
+    i32 num_layers[TEXTURE_ARRAY_COUNT];
+} Texture_Array_Layout;
+
+//Index into TEXTURE_ARRAY_SIZES or -1 if no array fits
+i32 texture_array_size_index(const i32 width, const i32 height) {
+    for (i32 i = 0; i < TEXTURE_ARRAY_COUNT; i++) {
+        if (width == TEXTURE_ARRAY_SIZES[i] && height == TEXTURE_ARRAY_SIZES[i])
+            return i;
+    }
+    return -1;
+}
+
+//Same lookup as in rect_shader_vert
+i32 texture_array_layout_find(
+    const Texture_Array_Layout* layout,
+    const i32                   texture_id
+) {
+    for (i32 i = TEXTURE_ARRAY_COUNT - 1; i > 0; i--) {
+        if (texture_id >= layout->first_texture_id[i]) return i;
+    }
+    return 0;
+}
+
+//Including the mip chain
+size_t texture_array_memory_size(const i32 size, const i32 num_layers) {
+    size_t bytes = 0;
+    for (i32 level_size = size; level_size > 0; level_size /= 2) {
+        bytes += (size_t)level_size * (size_t)level_size * 4;
+    }
+    return bytes * (size_t)num_layers;
+}
+
+typedef struct {
+    GL_Texture_Array     arrays[TEXTURE_ARRAY_COUNT]; //id 0 = no layers
+    Texture_Array_Layout layout;
+} Texture_Array_Set;
+
+//textures are ordered by array, see Texture_Array_Layout. Frees the raw
+//textures.
+Texture_Array_Set texture_array_set_generate(
+    Raw_Texture**               textures,
+    const Texture_Array_Layout* layout,
+    const Texture_Config        config
+) {
+    Texture_Array_Set set = {.layout = *layout};
+    for (i32 i = 0; i < TEXTURE_ARRAY_COUNT; i++) {
+        const i32 num_layers = layout->num_layers[i];
+        if (num_layers == 0) continue;
+        const i32 size = TEXTURE_ARRAY_SIZES[i];
+        set.arrays[i]  = gl_texture_array_generate(
+            &textures[layout->first_texture_id[i]], num_layers, size, size, 4,
+            config, true
+        );
+        log_msg(
+            "texture array %dx%d: %d layers, %.1f KiB", size, size, num_layers,
+            (double)texture_array_memory_size(size, num_layers) / 1024.0
+        );
+    }
+    return set;
+}
+
+void texture_array_set_cleanup(Texture_Array_Set* set) {
+    for (i32 i = 0; i < TEXTURE_ARRAY_COUNT; i++) {
+        if (set->arrays[i].id != 0) texture_array_free(&set->arrays[i]);
+    }
+    *set = (Texture_Array_Set){0};
+}
+
+void texture_array_set_bind(const Texture_Array_Set* set, const i32 array) {
+    SDL_assert(set->arrays[array].id != 0);
+    gl_texture_array_bind(&set->arrays[array], 0);
+}
+
 /* FONT ***********************************************************************/
 typedef enum {
     FONT_TEXTURE_TYPE_SINGLE,
@@ -532,6 +1818,7 @@ typedef struct {
     stbtt_packedchar   char_data[FONT_UNICODE_RANGE];
     Font_Texture_Type  texture_type;
     float              size;
+    bool               is_sdf; //false if the sdf glyphs did not fit the atlas
 
     union {
         GL_Texture texture;
@@ -539,8 +1826,92 @@ typedef struct {
     } texture_union;
 } Font;
 
+typedef struct {
+    u8* pixels;
+    i32 width, height;
+    i32 xoff, yoff;
+} Font_SDF_Glyph;
+
+int font_sdf_glyph_compare_height(const void* a, const void* b) {
+    const Font_SDF_Glyph* glyph_a = *(const Font_SDF_Glyph* const*)a;
+    const Font_SDF_Glyph* glyph_b = *(const Font_SDF_Glyph* const*)b;
+    return glyph_b->height - glyph_a->height;
+}
+
+//Bakes the glyphs as distance fields into pixels and fills char_data the way
+//stbtt_PackFontRange would, so stbtt_GetPackedQuad works for both.
+//The glyphs are packed in rows, tallest first. Returns false if they don't fit.
+bool font_bake_sdf(Font* font, u8* pixels) {
+    const float scale = stbtt_ScaleForPixelHeight(&font->info, font->size);
+    Font_SDF_Glyph  glyphs[FONT_UNICODE_RANGE]        = {0};
+    Font_SDF_Glyph* sorted_glyphs[FONT_UNICODE_RANGE] = {0};
+    for (i32 i = 0; i < FONT_UNICODE_RANGE; i++) {
+        const i32 codepoint = FONT_UNICODE_START + i;
+        i32       advance, left_side_bearing;
+        stbtt_GetCodepointHMetrics(
+            &font->info, codepoint, &advance, &left_side_bearing
+        );
+        font->char_data[i] = (stbtt_packedchar){
+            .xadvance = scale * (float)advance,
+        };
+        //NULL for glyphs without an outline (space)
+        glyphs[i].pixels = stbtt_GetCodepointSDF(
+            &font->info, scale, codepoint, FONT_SDF_PADDING,
+            FONT_SDF_ON_EDGE, (float)FONT_SDF_ON_EDGE / FONT_SDF_PADDING,
+            &glyphs[i].width, &glyphs[i].height,
+            &glyphs[i].xoff, &glyphs[i].yoff
+        );
+        sorted_glyphs[i] = &glyphs[i];
+    }
+    SDL_qsort(
+        sorted_glyphs, FONT_UNICODE_RANGE, sizeof(Font_SDF_Glyph*),
+        font_sdf_glyph_compare_height
+    );
+
+    SDL_memset(pixels, 0, FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE);
+    bool fits = true;
+    i32  x    = 0, y = 0, row_height = 0;
+    for (i32 i = 0; i < FONT_UNICODE_RANGE && fits; i++) {
+        const Font_SDF_Glyph* glyph = sorted_glyphs[i];
+        if (glyph->pixels == NULL) continue;
+        if (x + glyph->width > FONT_TEXTURE_SIZE) {
+            x = 0;
+            y += row_height;
+            row_height = 0;
+        }
+        if (glyph->width > FONT_TEXTURE_SIZE ||
+            y + glyph->height > FONT_TEXTURE_SIZE) {
+            fits = false;
+            break;
+        }
+        for (i32 row = 0; row < glyph->height; row++) {
+            SDL_memcpy(
+                &pixels[(y + row) * FONT_TEXTURE_SIZE + x],
+                &glyph->pixels[row * glyph->width], glyph->width
+            );
+        }
+        stbtt_packedchar* char_data = &font->char_data[glyph - &glyphs[0]];
+        char_data->x0    = (unsigned short)x;
+        char_data->y0    = (unsigned short)y;
+        char_data->x1    = (unsigned short)(x + glyph->width);
+        char_data->y1    = (unsigned short)(y + glyph->height);
+        char_data->xoff  = (float)glyph->xoff;
+        char_data->yoff  = (float)glyph->yoff;
+        char_data->xoff2 = (float)(glyph->xoff + glyph->width);
+        char_data->yoff2 = (float)(glyph->yoff + glyph->height);
+        x += glyph->width;
+        row_height = SDL_max(row_height, glyph->height);
+    }
+
+    for (i32 i = 0; i < FONT_UNICODE_RANGE; i++) {
+        if (glyphs[i].pixels != NULL) stbtt_FreeSDF(glyphs[i].pixels, NULL);
+    }
+    return fits;
+}
+
 //Loads the ttf, packs the glyphs it to an atlas and generates a rgba texture
 //If we will switch to texture arrays later on we'll need to split the logic.
+//The glyphs are baked as distance fields if they fit, as bitmaps otherwise.
 Raw_Texture* font_load_raw_texture(
     const char* file_path,
     Font*       font,
@@ -565,6 +1936,19 @@ Raw_Texture* font_load_raw_texture(
     }
 
     u8 pixels[FONT_TEXTURE_SIZE * FONT_TEXTURE_SIZE];
+    font->size   = size;
+    font->is_sdf = font_bake_sdf(font, &pixels[0]);
+    if (font->is_sdf) {
+        CRLF_free(file_data);
+        return raw_texture_rgba_from_alpha(
+            pixels, FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE
+        );
+    }
+    SDL_LogWarn(
+        0, "Font glyphs don't fit as sdf, falling back to a bitmap atlas: %s",
+        file_path
+    );
+
     if (!stbtt_PackBegin(
         &font->pack_context, &pixels[0],
         FONT_TEXTURE_SIZE, FONT_TEXTURE_SIZE,
@@ -574,7 +1958,6 @@ Raw_Texture* font_load_raw_texture(
         return NULL;
     }
 
-    font->size = size;
     if (!stbtt_PackFontRange(
         &font->pack_context, file_data, 0, size,
         FONT_UNICODE_START, FONT_UNICODE_RANGE,
@@ -635,10 +2018,42 @@ typedef struct {
     Shader_Type type;
 } Shader;
 
+//Uniform locations are looked up once per name and program. The names are
+//kept by pointer, so they have to outlive the program (string literals).
+#define SHADER_MAX_UNIFORMS 32
+
 typedef struct {
-    u32 id;
+    const char* name;
+    i32         location;
+} Shader_Uniform;
+
+typedef struct {
+    u32            id;
+    Shader_Uniform uniforms[SHADER_MAX_UNIFORMS];
+    i32            num_uniforms;
 } Shader_Program;
 
+i32 shader_uniform_location(Shader_Program* program, const char* name) {
+    for (i32 i = 0; i < program->num_uniforms; i++) {
+        const Shader_Uniform* uniform = &program->uniforms[i];
+        //names are usually literals, compare the pointers first
+        if (uniform->name == name || SDL_strcmp(uniform->name, name) == 0) {
+            gl_state.num_elided++;
+            return uniform->location;
+        }
+    }
+    const i32 location = glGetUniformLocation(program->id, name);
+    gl_state.num_issued++;
+    SDL_assert(program->num_uniforms < SHADER_MAX_UNIFORMS);
+    if (program->num_uniforms < SHADER_MAX_UNIFORMS) {
+        program->uniforms[program->num_uniforms++] = (Shader_Uniform){
+            .name = name,
+            .location = location,
+        };
+    }
+    return location;
+}
+
 bool check_shader_compilation(const u32 shader) {
     int success;
     int shaderType;
@@ -703,78 +2118,44 @@ Shader_Program compile_shader_program(const char* vert, const char* frag) {
 void delete_shader_program(const Shader_Program* shader) {
     SDL_assert(shader != NULL);
     SDL_assert(shader->id != 0);
+    gl_state_forget_program(shader->id);
     glDeleteProgram(shader->id);
 }
 
-/* VIEWPORT *******************************************************************/
-/*
-    Viewports are frame buffers on which we can render to.
-    They can be any size, and are scaled up or down to fit the screen when their
-    when rendering their framebuffers to the window.
-
-    For now, we are using a framebuffer divisor - but we might switch to a hard
-    coded pixel dimension.
-
-    Still to be decided: How to handle coordinates between different resolutions
-    especially for UI layout and mouse click input handling.
-
-    Viewport Layers:
-    1. Game
-    2. UI
+/* RENDER TARGET POOL *********************************************************/
+/*  Frame buffers with a color texture and an optional depth/stencil buffer,
+    handed out to the passes of the render graph. Targets are keyed by format
+    and size class: sizes are rounded up to RENDER_TARGET_SIZE_STEP, a pass
+    renders into the bottom left of its target. Resizing within a size class
+    allocates nothing, and targets that go unused are only freed after
+    RENDER_TARGET_MAX_UNUSED_FRAMES - a drag-resize no longer re-creates the
+    frame buffers on every event.
+*/
+#define RENDER_TARGET_POOL_CAPACITY 8
+#define RENDER_TARGET_SIZE_STEP 128
+#define RENDER_TARGET_MAX_UNUSED_FRAMES 120
 
- */
 typedef struct {
-    bool  is_initialized;
-    vec2  screen_pos;
-    ivec2 display_size;
-    ivec2 frame_buffer_size;
-    float aspect_ratio;
-    u32   frame_buffer;
-    u32   frame_buffer_texture;
-    u32   render_buffer;
-
-    //These members should be configured first
-    vec4 clear_color;
-    i32  frame_buffer_divisor;
-    bool has_blending;
+    bool has_alpha;
     bool has_depth_buffer;
     bool floating_point_precision;
-} Viewport;
+} Render_Target_Format;
 
-#if defined(CRLF_USE_GAMEVIEWPORT)
-Viewport default_viewport_game() {
-    return (Viewport){
-        .screen_pos = (vec2){256, 0},
-        .clear_color = (vec4){0.f, 0.f, 0.f, 1.f},
-        .frame_buffer_divisor = 2,
-        .has_blending = false,
-        .has_depth_buffer = true,
-        .floating_point_precision = false,
-    };
-}
-#endif
-
-Viewport default_viewport_ui() {
-    return (Viewport){
-        .clear_color =
-#if defined(CRLF_USE_GAMEVIEWPORT)
-         (vec4){0},//transparent
-#else
-        (vec4){0, 0, 0, 1},
-#endif
-        .frame_buffer_divisor = 1,
-        .has_blending = true,
-        .has_depth_buffer = true,
-        .floating_point_precision = false,
-    };
-}
+typedef struct {
+    u32                  frame_buffer; //0 = free slot
+    u32                  texture;
+    u32                  render_buffer; //0 without depth buffer
+    ivec2                size;          //allocated size, see size class
+    Render_Target_Format format;
+    bool                 is_in_use;
+    i32                  unused_frames;
+} Render_Target;
 
-void viewport_cleanup(const Viewport* viewport) {
-    if (!viewport->is_initialized) return;
-    glDeleteFramebuffers(1, &viewport->frame_buffer);
-    glDeleteTextures(1, &viewport->frame_buffer_texture);
-    glDeleteRenderbuffers(1, &viewport->render_buffer);
-}
+typedef struct {
+    Render_Target targets[RENDER_TARGET_POOL_CAPACITY];
+    size_t        memory_size;     //of all allocated targets
+    i32           num_allocations; //since the start, for the debug output
+} Render_Target_Pool;
 
 i32 viewport_get_internal_format(
     const bool has_blending,
@@ -786,35 +2167,58 @@ i32 viewport_get_internal_format(
     return has_blending ? GL_RGBA : GL_RGB;
 }
 
-void viewport_generate(
-    Viewport*   viewport,
-    const ivec2 display_size
-) {
-    viewport_cleanup(viewport);
-    viewport->display_size      = display_size;
-    viewport->frame_buffer_size = (ivec2){
-        display_size.x / viewport->frame_buffer_divisor,
-        display_size.y / viewport->frame_buffer_divisor,
+ivec2 render_target_size_class(const ivec2 size) {
+    const i32 step = RENDER_TARGET_SIZE_STEP;
+    return (ivec2){
+        SDL_max(1, (size.x + step - 1) / step) * step,
+        SDL_max(1, (size.y + step - 1) / step) * step,
     };
-    viewport->aspect_ratio = (float)display_size.x / (float)display_size.y;
+}
+
+bool render_target_format_equals(
+    const Render_Target_Format a,
+    const Render_Target_Format b
+) {
+    return a.has_alpha == b.has_alpha &&
+        a.has_depth_buffer == b.has_depth_buffer &&
+        a.floating_point_precision == b.floating_point_precision;
+}
 
-    glGenFramebuffers(1, &viewport->frame_buffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, viewport->frame_buffer);
+size_t render_target_memory_size(
+    const ivec2                size,
+    const Render_Target_Format format
+) {
+    size_t texel_size = format.has_alpha ? 4 : 3;
+    if (format.floating_point_precision) texel_size *= 2;
+    if (format.has_depth_buffer) texel_size += 4;
+    return (size_t)size.x * (size_t)size.y * texel_size;
+}
+
+void render_target_create(
+    Render_Target*             target,
+    const ivec2                size,
+    const Render_Target_Format format
+) {
+    *target = (Render_Target){
+        .size = size,
+        .format = format,
+    };
+    glGenFramebuffers(1, &target->frame_buffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->frame_buffer);
 
-    glGenTextures(1, &viewport->frame_buffer_texture);
-    glBindTexture(GL_TEXTURE_2D, viewport->frame_buffer_texture);
+    glGenTextures(1, &target->texture);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, target->texture);
     glTexImage2D(
         GL_TEXTURE_2D, 0,
         viewport_get_internal_format(
-            viewport->has_blending,
-            viewport->floating_point_precision
+            format.has_alpha, format.floating_point_precision
         ),
-        viewport->frame_buffer_size.x,
-        viewport->frame_buffer_size.y,
+        size.x,
+        size.y,
         0,
-        viewport->has_blending ? GL_RGBA : GL_RGB,
+        format.has_alpha ? GL_RGBA : GL_RGB,
         //BUG: Floating point precision using GL_FLOAT is not supported in web, check GL ES 3.0 specs for an equivalent!
-        viewport->floating_point_precision ? GL_FLOAT : GL_UNSIGNED_BYTE,
+        format.floating_point_precision ? GL_FLOAT : GL_UNSIGNED_BYTE,
         NULL
     );
 
@@ -822,21 +2226,18 @@ void viewport_generate(
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(
         GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-        viewport->frame_buffer_texture, 0
+        target->texture, 0
     );
 
-    glGenRenderbuffers(1, &viewport->render_buffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, viewport->render_buffer);
-
-    if (viewport->has_depth_buffer) {
+    if (format.has_depth_buffer) {
+        glGenRenderbuffers(1, &target->render_buffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target->render_buffer);
         glRenderbufferStorage(
-            GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
-            viewport->frame_buffer_size.x,
-            viewport->frame_buffer_size.y
+            GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y
         );
         glFramebufferRenderbuffer(
             GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
-            GL_RENDERBUFFER, viewport->render_buffer
+            GL_RENDERBUFFER, target->render_buffer
         );
     }
 
@@ -846,7 +2247,184 @@ void viewport_generate(
     );
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    viewport->is_initialized = true;
+}
+
+void render_target_free(Render_Target* target) {
+    glDeleteFramebuffers(1, &target->frame_buffer);
+    gl_state_forget_texture(target->texture);
+    glDeleteTextures(1, &target->texture);
+    if (target->render_buffer != 0) {
+        glDeleteRenderbuffers(1, &target->render_buffer);
+    }
+    *target = (Render_Target){0};
+}
+
+void render_target_pool_cleanup(Render_Target_Pool* pool) {
+    for (i32 i = 0; i < RENDER_TARGET_POOL_CAPACITY; i++) {
+        if (pool->targets[i].frame_buffer != 0) {
+            render_target_free(&pool->targets[i]);
+        }
+    }
+    *pool = (Render_Target_Pool){0};
+}
+
+//A target of at least size, its contents are undefined
+Render_Target* render_target_pool_acquire(
+    Render_Target_Pool*        pool,
+    const ivec2                size,
+    const Render_Target_Format format
+) {
+    const ivec2    size_class = render_target_size_class(size);
+    Render_Target* free_slot  = NULL;
+    Render_Target* stale      = NULL; //free target of another key
+    for (i32 i = 0; i < RENDER_TARGET_POOL_CAPACITY; i++) {
+        Render_Target* target = &pool->targets[i];
+        if (target->frame_buffer == 0) {
+            if (free_slot == NULL) free_slot = target;
+            continue;
+        }
+        if (target->is_in_use) continue;
+        if (target->size.x == size_class.x && target->size.y == size_class.y &&
+            render_target_format_equals(target->format, format)) {
+            target->is_in_use     = true;
+            target->unused_frames = 0;
+            return target;
+        }
+        if (stale == NULL || target->unused_frames > stale->unused_frames) {
+            stale = target;
+        }
+    }
+
+    if (free_slot == NULL) {
+        SDL_assert(stale != NULL); //more targets in use than the capacity
+        pool->memory_size -= render_target_memory_size(
+            stale->size, stale->format
+        );
+        render_target_free(stale);
+        free_slot = stale;
+    }
+    render_target_create(free_slot, size_class, format);
+    free_slot->is_in_use = true;
+    pool->memory_size += render_target_memory_size(size_class, format);
+    pool->num_allocations++;
+    return free_slot;
+}
+
+void render_target_pool_release(Render_Target* target) {
+    SDL_assert(target->is_in_use);
+    target->is_in_use = false;
+}
+
+//Frees the targets that went unused for too long
+void render_target_pool_end_frame(Render_Target_Pool* pool) {
+    for (i32 i = 0; i < RENDER_TARGET_POOL_CAPACITY; i++) {
+        Render_Target* target = &pool->targets[i];
+        if (target->frame_buffer == 0 || target->is_in_use) continue;
+        target->unused_frames++;
+        if (target->unused_frames > RENDER_TARGET_MAX_UNUSED_FRAMES) {
+            pool->memory_size -= render_target_memory_size(
+                target->size, target->format
+            );
+            render_target_free(target);
+        }
+    }
+}
+
+/* VIEWPORT *******************************************************************/
+/*
+    Viewports are frame buffers on which we can render to.
+    They can be any size, and are scaled up or down to fit the screen when their
+    when rendering their framebuffers to the window.
+
+    The frame buffer is the display size times the render scale, which is
+    picked per frame by the resolution scaler (see DYNAMIC RESOLUTION) and
+    can be fractional.
+
+    Still to be decided: How to handle coordinates between different resolutions
+    especially for UI layout and mouse click input handling.
+
+    Viewport Layers:
+    1. Game
+    2. UI
+
+    The frame buffer itself is a render target the render graph assigns for
+    the duration of a frame. Without a target, the viewport is drawn straight
+    into the window's back buffer (see CRLF_USE_SRGB_BACK_BUFFER).
+ */
+typedef struct {
+    vec2           screen_pos;
+    ivec2          display_size;
+    ivec2          frame_buffer_size;
+    float          aspect_ratio;
+    Render_Target* target; //only valid while the render graph executes, or
+                           //NULL for the back buffer
+
+    //These members should be configured first
+    vec4  clear_color;
+    float render_scale;     //of the frame buffer, up to render_scale_max
+    float render_scale_max; //at full quality, constant
+    bool  has_blending;
+    bool  has_depth_buffer;
+    bool  floating_point_precision;
+} Viewport;
+
+#if defined(CRLF_USE_GAMEVIEWPORT)
+Viewport default_viewport_game() {
+    return (Viewport){
+        .screen_pos = (vec2){256, 0},
+        .clear_color = (vec4){0.f, 0.f, 0.f, 1.f},
+        .render_scale = .5f,
+        .render_scale_max = .5f,
+        .has_blending = false,
+        .has_depth_buffer = true,
+        .floating_point_precision = false,
+    };
+}
+#endif
+
+Viewport default_viewport_ui() {
+    return (Viewport){
+        .clear_color =
+#if defined(CRLF_USE_GAMEVIEWPORT)
+         (vec4){0},//transparent
+#else
+        (vec4){0, 0, 0, 1},
+#endif
+        .render_scale = 1.f,
+        .render_scale_max = 1.f,
+        .has_blending = true,
+        .has_depth_buffer = true,
+        .floating_point_precision = false,
+    };
+}
+
+Render_Target_Format viewport_format(const Viewport* viewport) {
+    return (Render_Target_Format){
+        .has_alpha = viewport->has_blending,
+        .has_depth_buffer = viewport->has_depth_buffer,
+        .floating_point_precision = viewport->floating_point_precision,
+    };
+}
+
+//The frame buffer size viewport_resize picks, lets the ui layout run without
+//touching the viewport itself (which belongs to the thread drawing the frame)
+ivec2 viewport_frame_buffer_size(const ivec2 display_size, const float scale) {
+    return (ivec2){
+        SDL_max(1, (i32)((float)display_size.x * scale)),
+        SDL_max(1, (i32)((float)display_size.y * scale)),
+    };
+}
+
+//No gl calls, the render target pool takes care of the frame buffers
+void viewport_resize(
+    Viewport*   viewport,
+    const ivec2 display_size
+) {
+    viewport->display_size      = display_size;
+    viewport->frame_buffer_size = viewport_frame_buffer_size(
+        display_size, viewport->render_scale
+    );
+    viewport->aspect_ratio = (float)display_size.x / (float)display_size.y;
 }
 
 void viewport_bind(const Viewport* viewport) {
@@ -855,7 +2433,10 @@ void viewport_bind(const Viewport* viewport) {
         viewport->frame_buffer_size.x,
         viewport->frame_buffer_size.y
     );
-    glBindFramebuffer(GL_FRAMEBUFFER, viewport->frame_buffer);
+    glBindFramebuffer(
+        GL_FRAMEBUFFER,
+        viewport->target != NULL ? viewport->target->frame_buffer : 0
+    );
     glClearColor(
         viewport->clear_color.r,
         viewport->clear_color.g,
@@ -864,20 +2445,39 @@ void viewport_bind(const Viewport* viewport) {
     );
     if (viewport->has_depth_buffer) {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
+        gl_state_set_capability(GL_DEPTH_TEST, true);
     } else {
         glClear(GL_COLOR_BUFFER_BIT);
-        glDisable(GL_DEPTH_TEST);
+        gl_state_set_capability(GL_DEPTH_TEST, false);
     }
 }
 
 //unbinds the current framebuffer and gets back to the full screen
 void viewport_unbind(const i32 width, const i32 height) {
-    glDisable(GL_DEPTH_TEST);
+    gl_state_set_capability(GL_DEPTH_TEST, false);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glViewport(0, 0, width, height);
 }
 
+#if defined(CRLF_USE_SRGB_BACK_BUFFER)
+//Whether a viewport can be drawn straight into the window: the back buffer has
+//to encode srgb and needs a depth buffer as precise as the render targets'
+bool back_buffer_supports_srgb() {
+    GLint encoding   = GL_LINEAR;
+    GLint depth_bits = 0;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glGetFramebufferAttachmentParameteriv(
+        GL_FRAMEBUFFER, GL_BACK_LEFT,
+        GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding
+    );
+    glGetFramebufferAttachmentParameteriv(
+        GL_FRAMEBUFFER, GL_DEPTH,
+        GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depth_bits
+    );
+    return encoding == GL_SRGB && depth_bits >= 24;
+}
+#endif
+
 void viewport_renderer_init(Renderer* renderer) {
     const float vertices[] = {
         //Position(XY)  TexCoord(XY)
@@ -906,27 +2506,460 @@ void viewport_renderer_init(Renderer* renderer) {
 }
 
 void viewport_render_to_window(
-    const Viewport*       viewport,
-    const Renderer*       renderer,
-    const Shader_Program* viewport_shader
+    const Viewport* viewport,
+    const Renderer* renderer,
+    Shader_Program* viewport_shader
 ) {
     if (viewport->has_blending) {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        gl_state_set_capability(GL_BLEND, true);
+        gl_state_blend_func_separate(
+            GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+            GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+        );
     }
     //TODO: make use of viewport screen_pos (apply matrix / offset in shader)
 
-    glUseProgram(viewport_shader->id);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, viewport->frame_buffer_texture);
-    glUniform1i(
-        glGetUniformLocation(viewport_shader->id, "viewportTexture"), 0
+    SDL_assert(viewport->target != NULL);
+    gl_state_use_program(viewport_shader->id);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, viewport->target->texture);
+    glUniform1i(shader_uniform_location(viewport_shader, "viewportTexture"), 0);
+    //the viewport only covers the bottom left of its target
+    glUniform2f(
+        shader_uniform_location(viewport_shader, "texCoordScale"),
+        (float)viewport->frame_buffer_size.x / (float)viewport->target->size.x,
+        (float)viewport->frame_buffer_size.y / (float)viewport->target->size.y
     );
-    glBindVertexArray(renderer->vao);
+    gl_state_bind_vertex_array(renderer->vao);
     glDrawArrays(GL_TRIANGLES, 0, 6);
     if (viewport->has_blending)
-        glDisable(GL_BLEND);
+        gl_state_set_capability(GL_BLEND, false);
+}
+
+/* RENDER GRAPH ***************************************************************/
+/*  A frame is a list of passes, each declaring the attachment it renders into
+    and the attachments it samples. render_graph_execute runs the passes in the
+    order they were added. Every attachment is acquired from the render target
+    pool right before its first pass and released right after its last one,
+    so attachments whose lifetimes don't overlap share a frame buffer.
+    The graph is rebuilt every frame - declaring it is cheap, the frame buffers
+    are what the pool keeps around. Imported attachments are targets that
+    outlive the frame, the graph leaves acquiring and releasing them to their
+    owner.
+*/
+#define RENDER_GRAPH_MAX_PASSES 8
+#define RENDER_GRAPH_MAX_ATTACHMENTS 8
+#define RENDER_GRAPH_MAX_INPUTS 4
+//attachment index of the window's back buffer
+#define RENDER_GRAPH_WINDOW (-1)
+
+typedef struct {
+    ivec2                size;
+    Render_Target_Format format;
+    i32                  first_pass, last_pass;
+    Render_Target*       target; //only while the attachment is alive
+    bool                 is_imported;
+} Render_Graph_Attachment;
+
+//output is NULL for the window
+typedef void (*Render_Pass_Func)(
+    void* user_data, Render_Target* const* inputs, Render_Target* output
+);
+
+typedef struct {
+    Render_Pass_Func execute;
+    void*            user_data;
+    i32              output; //attachment index or RENDER_GRAPH_WINDOW
+    i32              inputs[RENDER_GRAPH_MAX_INPUTS];
+    i32              num_inputs;
+} Render_Pass;
+
+typedef struct {
+    Render_Graph_Attachment attachments[RENDER_GRAPH_MAX_ATTACHMENTS];
+    i32                     num_attachments;
+    Render_Pass             passes[RENDER_GRAPH_MAX_PASSES];
+    i32                     num_passes;
+} Render_Graph;
+
+void render_graph_reset(Render_Graph* graph) {
+    graph->num_attachments = 0;
+    graph->num_passes      = 0;
+}
+
+i32 render_graph_add_attachment(
+    Render_Graph*              graph,
+    const ivec2                size,
+    const Render_Target_Format format
+) {
+    SDL_assert(graph->num_attachments < RENDER_GRAPH_MAX_ATTACHMENTS);
+    graph->attachments[graph->num_attachments] = (Render_Graph_Attachment){
+        .size = size,
+        .format = format,
+        .first_pass = -1,
+        .last_pass = -1,
+    };
+    return graph->num_attachments++;
+}
+
+//A target acquired by the caller, its contents are kept from the last frame
+i32 render_graph_import_attachment(Render_Graph* graph, Render_Target* target) {
+    SDL_assert(target != NULL && target->is_in_use);
+    SDL_assert(graph->num_attachments < RENDER_GRAPH_MAX_ATTACHMENTS);
+    graph->attachments[graph->num_attachments] = (Render_Graph_Attachment){
+        .size = target->size,
+        .format = target->format,
+        .first_pass = -1,
+        .last_pass = -1,
+        .target = target,
+        .is_imported = true,
+    };
+    return graph->num_attachments++;
+}
+
+void render_graph_add_pass(Render_Graph* graph, const Render_Pass pass) {
+    SDL_assert(graph->num_passes < RENDER_GRAPH_MAX_PASSES);
+    SDL_assert(pass.num_inputs <= RENDER_GRAPH_MAX_INPUTS);
+    graph->passes[graph->num_passes++] = pass;
+}
+
+void render_graph_use_attachment(
+    Render_Graph* graph,
+    const i32     attachment,
+    const i32     pass
+) {
+    if (attachment == RENDER_GRAPH_WINDOW) return;
+    SDL_assert(attachment >= 0 && attachment < graph->num_attachments);
+    Render_Graph_Attachment* a = &graph->attachments[attachment];
+    if (a->first_pass < 0) a->first_pass = pass;
+    a->last_pass = pass;
+}
+
+void render_graph_execute(Render_Graph* graph, Render_Target_Pool* pool) {
+    for (i32 i = 0; i < graph->num_passes; i++) {
+        const Render_Pass* pass = &graph->passes[i];
+        render_graph_use_attachment(graph, pass->output, i);
+        for (i32 j = 0; j < pass->num_inputs; j++) {
+            render_graph_use_attachment(graph, pass->inputs[j], i);
+        }
+    }
+
+    for (i32 i = 0; i < graph->num_passes; i++) {
+        for (i32 j = 0; j < graph->num_attachments; j++) {
+            Render_Graph_Attachment* a = &graph->attachments[j];
+            if (a->first_pass != i || a->is_imported) continue;
+            a->target = render_target_pool_acquire(pool, a->size, a->format);
+        }
+
+        const Render_Pass* pass = &graph->passes[i];
+        Render_Target*     inputs[RENDER_GRAPH_MAX_INPUTS];
+        for (i32 j = 0; j < pass->num_inputs; j++) {
+            inputs[j] = graph->attachments[pass->inputs[j]].target;
+            SDL_assert(inputs[j] != NULL); //read before it was written
+        }
+        Render_Target* output = pass->output == RENDER_GRAPH_WINDOW ? NULL :
+            graph->attachments[pass->output].target;
+        pass->execute(pass->user_data, inputs, output);
+
+        for (i32 j = 0; j < graph->num_attachments; j++) {
+            Render_Graph_Attachment* a = &graph->attachments[j];
+            if (a->last_pass != i || a->is_imported) continue;
+            render_target_pool_release(a->target);
+            a->target = NULL;
+        }
+    }
+    render_target_pool_end_frame(pool);
+}
+
+/* BMP ************************************************************************/
+//Writes linear rgba pixels (bottom row first, like gl reads them) as a bmp,
+//with the gamma of viewport_shader_frag applied
+bool save_bmp_linear_rgba(
+    const u8*   pixels,
+    const i32   width,
+    const i32   height,
+    const char* path
+) {
+    u8 to_gamma[256];
+    for (i32 i = 0; i < 256; i++) {
+        to_gamma[i] = (u8)SDL_floorf(
+            SDL_powf((float)i / 255.f, 1.f / 2.2f) * 255.f + .5f
+        );
+    }
+    const size_t pitch  = (size_t)width * 4;
+    u8*          output = CRLF_malloc(pitch * (size_t)height);
+    SDL_assert(output != NULL);
+    //bmp rows go top to bottom
+    for (i32 y = 0; y < height; y++) {
+        const u8* src = &pixels[(size_t)y * pitch];
+        u8*       dst = &output[(size_t)(height - 1 - y) * pitch];
+        for (size_t x = 0; x < pitch; x += 4) {
+            dst[x + 0] = to_gamma[src[x + 0]];
+            dst[x + 1] = to_gamma[src[x + 1]];
+            dst[x + 2] = to_gamma[src[x + 2]];
+            dst[x + 3] = src[x + 3];
+        }
+    }
+    SDL_Surface* surface = SDL_CreateSurfaceFrom(
+        width, height, SDL_PIXELFORMAT_RGBA32, output, (int)pitch
+    );
+    const bool is_saved = surface != NULL && SDL_SaveBMP(surface, path);
+    if (!is_saved)
+        log_error("Failed to save %s: %s", path, SDL_GetError());
+    if (surface != NULL) SDL_DestroySurface(surface);
+    CRLF_free(output);
+    return is_saved;
+}
+
+/* FRAME CAPTURE **************************************************************/
+/*  Reads frames back without stalling the pipeline. The capture pass of the
+    render graph copies the viewports into a ring of pixel pack buffers and
+    puts a fence behind each copy. A buffer is mapped once its fence signaled,
+    FRAME_CAPTURE_LATENCY frames later at the earliest - by then the gpu is
+    long done with it. Its pixels are copied out and handed to a worker thread
+    that converts and writes them, so the thread drawing the frames only pays
+    for the copy.
+    Files go to the working directory:
+        capture_<sequence>_<frame>_<viewport>.bmp
+    Frames are dropped (and counted) rather than waited for when the ring or
+    the worker queue is full.
+*/
+#if defined(CRLF_USE_FRAME_CAPTURE)
+#define FRAME_CAPTURE_RING_SIZE 6
+#define FRAME_CAPTURE_LATENCY 2
+#define FRAME_CAPTURE_MAX_JOBS 16
+#define FRAME_CAPTURE_MAX_VIEWPORTS 2
+
+typedef enum {
+    FRAME_CAPTURE_REQUEST_NONE,
+    FRAME_CAPTURE_REQUEST_SCREENSHOT,
+    FRAME_CAPTURE_REQUEST_TOGGLE_SEQUENCE,
+} Frame_Capture_Request;
+
+typedef struct {
+    u32         pbo;
+    size_t      capacity; //of the pbo in bytes
+    GLsync      fence;    //NULL = slot is free
+    ivec2       size;
+    i32         age; //frames since the readback was issued
+    u32         sequence;
+    u32         frame;
+    const char* viewport_name;
+} Frame_Capture_Slot;
+
+typedef struct {
+    u8*         pixels; //rgba, bottom row first
+    ivec2       size;
+    u32         sequence;
+    u32         frame;
+    const char* viewport_name;
+} Frame_Capture_Job;
+
+typedef struct {
+    Frame_Capture_Slot slots[FRAME_CAPTURE_RING_SIZE];
+    i32                next_slot;
+    i32                frames_left; //to capture, -1 = until toggled off
+    u32                sequence;    //bumped for every screenshot / sequence
+    u32                frame;       //within the sequence
+    i32                num_dropped;
+
+    //shared with the worker, guarded by mutex
+    SDL_Thread*       thread;
+    SDL_Mutex*        mutex;
+    SDL_Condition*    has_jobs;
+    Frame_Capture_Job jobs[FRAME_CAPTURE_MAX_JOBS];
+    i32               first_job;
+    i32               num_jobs;
+    bool              quit;
+} Frame_Capture;
+
+int frame_capture_worker_run(void* data) {
+    Frame_Capture* capture = data;
+    for (;;) {
+        SDL_LockMutex(capture->mutex);
+        while (capture->num_jobs == 0 && !capture->quit) {
+            SDL_WaitCondition(capture->has_jobs, capture->mutex);
+        }
+        //queued captures are still written when quitting
+        if (capture->num_jobs == 0) {
+            SDL_UnlockMutex(capture->mutex);
+            return 0;
+        }
+        const Frame_Capture_Job job = capture->jobs[capture->first_job];
+        capture->first_job = (capture->first_job + 1) % FRAME_CAPTURE_MAX_JOBS;
+        capture->num_jobs--;
+        SDL_UnlockMutex(capture->mutex);
+
+        char path[64];
+        SDL_snprintf(
+            path, sizeof(path), "capture_%03u_%05u_%s.bmp", job.sequence,
+            job.frame, job.viewport_name
+        );
+        save_bmp_linear_rgba(job.pixels, job.size.x, job.size.y, path);
+        CRLF_free(job.pixels);
+    }
+}
+
+bool frame_capture_init(Frame_Capture* capture) {
+    *capture = (Frame_Capture){
+        .mutex = SDL_CreateMutex(),
+        .has_jobs = SDL_CreateCondition(),
+    };
+    if (capture->mutex == NULL || capture->has_jobs == NULL) return false;
+    capture->thread = SDL_CreateThread(
+        frame_capture_worker_run, "frame_capture", capture
+    );
+    if (capture->thread == NULL) {
+        log_error("Failed to create frame capture thread: %s", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+//Waits for the worker to write the queued captures, pending readbacks are lost
+void frame_capture_cleanup(Frame_Capture* capture) {
+    if (capture->thread != NULL) {
+        SDL_LockMutex(capture->mutex);
+        capture->quit = true;
+        SDL_SignalCondition(capture->has_jobs);
+        SDL_UnlockMutex(capture->mutex);
+        SDL_WaitThread(capture->thread, NULL);
+    }
+    for (i32 i = 0; i < FRAME_CAPTURE_RING_SIZE; i++) {
+        Frame_Capture_Slot* slot = &capture->slots[i];
+        if (slot->fence != NULL) glDeleteSync(slot->fence);
+        if (slot->pbo != 0) glDeleteBuffers(1, &slot->pbo);
+    }
+    if (capture->has_jobs != NULL) SDL_DestroyCondition(capture->has_jobs);
+    if (capture->mutex != NULL) SDL_DestroyMutex(capture->mutex);
+    *capture = (Frame_Capture){0};
+}
+
+void frame_capture_request(
+    Frame_Capture*              capture,
+    const Frame_Capture_Request request
+) {
+    if (capture->thread == NULL) return; //frame_capture_init failed
+    switch (request) {
+    case FRAME_CAPTURE_REQUEST_NONE:
+        return;
+    case FRAME_CAPTURE_REQUEST_SCREENSHOT:
+        if (capture->frames_left != 0) return; //a sequence is running
+        capture->frames_left = 1;
+        break;
+    case FRAME_CAPTURE_REQUEST_TOGGLE_SEQUENCE:
+        if (capture->frames_left != 0) {
+            log_msg(
+                "frame capture: sequence %u stopped after %u frames, "
+                "%d dropped", capture->sequence, capture->frame,
+                capture->num_dropped
+            );
+            capture->frames_left = 0;
+            return;
+        }
+        capture->frames_left = -1;
+        break;
+    }
+    capture->sequence++;
+    capture->frame       = 0;
+    capture->num_dropped = 0;
+}
+
+bool frame_capture_is_active(const Frame_Capture* capture) {
+    return capture->frames_left != 0;
+}
+
+//Hands the readbacks that finished to the worker, never blocks on the gpu
+void frame_capture_update(Frame_Capture* capture) {
+    for (i32 i = 0; i < FRAME_CAPTURE_RING_SIZE; i++) {
+        Frame_Capture_Slot* slot = &capture->slots[i];
+        if (slot->fence == NULL) continue;
+        if (++slot->age < FRAME_CAPTURE_LATENCY) continue;
+        const GLenum result = glClientWaitSync(slot->fence, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            continue;
+        glDeleteSync(slot->fence);
+        slot->fence = NULL;
+
+        SDL_LockMutex(capture->mutex);
+        const bool is_full = capture->num_jobs == FRAME_CAPTURE_MAX_JOBS;
+        SDL_UnlockMutex(capture->mutex);
+        if (is_full) {
+            capture->num_dropped++;
+            continue;
+        }
+        const size_t size = (size_t)slot->size.x * (size_t)slot->size.y * 4;
+        u8*          pixels = CRLF_malloc(size);
+        SDL_assert(pixels != NULL);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+        const void* mapped = glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT
+        );
+        if (mapped != NULL) SDL_memcpy(pixels, mapped, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (mapped == NULL) {
+            CRLF_free(pixels);
+            capture->num_dropped++;
+            continue;
+        }
+
+        SDL_LockMutex(capture->mutex);
+        const i32 job = (capture->first_job + capture->num_jobs) %
+            FRAME_CAPTURE_MAX_JOBS;
+        capture->jobs[job] = (Frame_Capture_Job){
+            .pixels = pixels,
+            .size = slot->size,
+            .sequence = slot->sequence,
+            .frame = slot->frame,
+            .viewport_name = slot->viewport_name,
+        };
+        capture->num_jobs++;
+        SDL_SignalCondition(capture->has_jobs);
+        SDL_UnlockMutex(capture->mutex);
+    }
+}
+
+//Issues the asynchronous readback of the bottom left size pixels of target
+void frame_capture_read_target(
+    Frame_Capture*       capture,
+    const Render_Target* target,
+    const ivec2          size,
+    const char*          viewport_name
+) {
+    Frame_Capture_Slot* slot = &capture->slots[capture->next_slot];
+    if (slot->fence != NULL) {
+        capture->num_dropped++; //the ring is full
+        return;
+    }
+    capture->next_slot = (capture->next_slot + 1) % FRAME_CAPTURE_RING_SIZE;
+
+    const size_t bytes = (size_t)size.x * (size_t)size.y * 4;
+    if (slot->pbo == 0) glGenBuffers(1, &slot->pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+    if (slot->capacity < bytes) {
+        glBufferData(
+            GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bytes, NULL, GL_STREAM_READ
+        );
+        slot->capacity = bytes;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->frame_buffer);
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot->fence         = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->size          = size;
+    slot->age           = 0;
+    slot->sequence      = capture->sequence;
+    slot->frame         = capture->frame;
+    slot->viewport_name = viewport_name;
+}
+
+//Call after all viewports of a frame were read
+void frame_capture_end_frame(Frame_Capture* capture) {
+    capture->frame++;
+    if (capture->frames_left > 0) capture->frames_left--;
 }
+#endif
 
 /* TEXTURE COORD QUADS ********************************************************/
 typedef struct {
@@ -1000,174 +3033,2409 @@ Tex_Coords tex_coords_from_cell_index(
     return tex_coords_from_cell(row, column, rows, columns);
 }
 
-Tex_Coords tex_coords_mul_float(
-    const Tex_Coords tex_coords,
-    const float      factor
+Tex_Coords tex_coords_mul_float(
+    const Tex_Coords tex_coords,
+    const float      factor
+) {
+    return (Tex_Coords){
+        .bottom_left = vec2_mul_float(tex_coords.bottom_left, factor),
+        .bottom_right = vec2_mul_float(tex_coords.bottom_right, factor),
+        .top_left = vec2_mul_float(tex_coords.top_left, factor),
+        .top_right = vec2_mul_float(tex_coords.top_right, factor),
+    };
+}
+
+Tex_Coords tex_coords_mul_vec2(
+    const Tex_Coords tex_coords,
+    const vec2       factor
+) {
+    return (Tex_Coords){
+        .bottom_left = vec2_mul_vec2(tex_coords.bottom_left, factor),
+        .bottom_right = vec2_mul_vec2(tex_coords.bottom_right, factor),
+        .top_left = vec2_mul_vec2(tex_coords.top_left, factor),
+        .top_right = vec2_mul_vec2(tex_coords.top_right, factor),
+    };
+}
+
+Tex_Coords tex_coords_add_vec2(
+    const Tex_Coords tex_coords,
+    const vec2       vec
+) {
+    return (Tex_Coords){
+        .bottom_left = vec2_add_vec2(tex_coords.bottom_left, vec),
+        .bottom_right = vec2_add_vec2(tex_coords.bottom_right, vec),
+        .top_left = vec2_add_vec2(tex_coords.top_left, vec),
+        .top_right = vec2_add_vec2(tex_coords.top_right, vec),
+    };
+}
+
+Tex_Coords tex_coords_sub_vec2(
+    const Tex_Coords tex_coords,
+    const vec2       vec
+) {
+    return (Tex_Coords){
+        .bottom_left = vec2_sub_vec2(tex_coords.bottom_left, vec),
+        .bottom_right = vec2_sub_vec2(tex_coords.bottom_right, vec),
+        .top_left = vec2_sub_vec2(tex_coords.top_left, vec),
+        .top_right = vec2_sub_vec2(tex_coords.top_right, vec),
+    };
+}
+
+Tex_Coords tex_coords_map_to_quad(
+    const Tex_Coords tex_coords,
+    const Tex_Quad*  quad
+) {
+    const vec2 scale = vec2_sub_vec2(quad->max, quad->min);
+    return tex_coords_add_vec2(
+        tex_coords_mul_vec2(tex_coords, scale), quad->min
+    );
+}
+
+/* RECT RENDERING *************************************************************/
+/*
+    Instead of the previous 'single-buffer-partial-update-only-on-change'
+    caching approach we're aiming for an immediate mode approach this time.
+ */
+typedef struct {
+    vec2  pos;
+    vec2  size;
+    vec3  color;
+    float sort_order;
+    //the vertices of the rect will be aligned relative to the pivot
+    //value range 0-1, where 0 = left/bottom, 1 = right/top, {0.5,0.5} = center
+    vec2       pivot;
+    i32        texture_id;
+    Tex_Coords tex_coords;
+    //0 = opaque (default), translucent rects are blended back to front
+    float transparency;
+    //sdf font glyphs only: outline width as a fraction of FONT_SDF_PADDING
+    float outline;
+    vec3  outline_color;
+    //nine slices only, see render_nine_slice: x = border in pixels (negative =
+    //the center is not drawn), y = border as a fraction of the tex coords.
+    //{0, 0} = plain rect
+    vec2 slice;
+    //evaluated in rect_shader_vert, amplitude in pixels
+    UI_Animation animation;
+} Rect;
+
+//Structure of arrays: every member of Rect lives in its own array, which lets
+//the instance kernels below process several rects per simd instruction.
+//Grows on demand, so a frame can contain any number of rects.
+//Tex coords are stored as the bottom_left (min) / top_right (max) pair. This is
+//sufficient as all tex coords we generate (atlas cells, glyphs, nine slices)
+//are axis aligned.
+#define RECT_BUFFER_FIELDS(X)                                                  \
+    X(float, pos_x)                                                            \
+    X(float, pos_y)                                                            \
+    X(float, size_x)                                                           \
+    X(float, size_y)                                                           \
+    X(float, pivot_x)                                                          \
+    X(float, pivot_y)                                                          \
+    X(float, color_r)                                                          \
+    X(float, color_g)                                                          \
+    X(float, color_b)                                                          \
+    X(float, sort_order)                                                       \
+    X(float, tex_min_x)                                                        \
+    X(float, tex_min_y)                                                        \
+    X(float, tex_max_x)                                                        \
+    X(float, tex_max_y)                                                        \
+    X(float, transparency)                                                     \
+    X(float, outline)                                                          \
+    X(float, outline_r)                                                        \
+    X(float, outline_g)                                                        \
+    X(float, outline_b)                                                        \
+    X(float, slice_border)                                                     \
+    X(float, slice_uv)                                                         \
+    X(float, anim_phase_x)                                                     \
+    X(float, anim_phase_y)                                                     \
+    X(float, anim_amplitude_x)                                                 \
+    X(float, anim_amplitude_y)                                                 \
+    X(float, anim_frequency)                                                   \
+    X(float, pulse_r)                                                          \
+    X(float, pulse_g)                                                          \
+    X(float, pulse_b)                                                          \
+    X(i32, anim_flags)                                                         \
+    X(i32, texture_id)
+
+typedef struct {
+#define RECT_BUFFER_FIELD(type, name) type* name;
+    RECT_BUFFER_FIELDS(RECT_BUFFER_FIELD)
+#undef RECT_BUFFER_FIELD
+    size_t curr_len;
+    size_t capacity;
+} Rect_Buffer;
+
+void rect_buffer_init(Rect_Buffer* rect_buffer, const size_t capacity) {
+    *rect_buffer = (Rect_Buffer){
+        .capacity = capacity,
+    };
+#define RECT_BUFFER_FIELD(type, name)                                          \
+    rect_buffer->name = CRLF_malloc(capacity * sizeof(type));                  \
+    SDL_assert(rect_buffer->name != NULL);
+    RECT_BUFFER_FIELDS(RECT_BUFFER_FIELD)
+#undef RECT_BUFFER_FIELD
+}
+
+void rect_buffer_cleanup(Rect_Buffer* rect_buffer) {
+#define RECT_BUFFER_FIELD(type, name)                                          \
+    SDL_assert(rect_buffer->name != NULL);                                     \
+    CRLF_free(rect_buffer->name);                                              \
+    rect_buffer->name = NULL;
+    RECT_BUFFER_FIELDS(RECT_BUFFER_FIELD)
+#undef RECT_BUFFER_FIELD
+}
+
+void rect_buffer_reserve(Rect_Buffer* rect_buffer, const size_t capacity) {
+    if (capacity <= rect_buffer->capacity) return;
+    const size_t new_capacity = SDL_max(capacity, rect_buffer->capacity * 2);
+#define RECT_BUFFER_FIELD(type, name)                                          \
+    rect_buffer->name = CRLF_realloc(                                          \
+        rect_buffer->name, new_capacity * sizeof(type)                         \
+    );                                                                         \
+    SDL_assert(rect_buffer->name != NULL);
+    RECT_BUFFER_FIELDS(RECT_BUFFER_FIELD)
+#undef RECT_BUFFER_FIELD
+    rect_buffer->capacity = new_capacity;
+}
+
+void add_rect_to_buffer(Rect_Buffer* rect_buffer, const Rect rect) {
+    rect_buffer_reserve(rect_buffer, rect_buffer->curr_len + 1);
+    const size_t i = rect_buffer->curr_len;
+    rect_buffer->pos_x[i]        = rect.pos.x;
+    rect_buffer->pos_y[i]        = rect.pos.y;
+    rect_buffer->size_x[i]       = rect.size.x;
+    rect_buffer->size_y[i]       = rect.size.y;
+    rect_buffer->pivot_x[i]      = rect.pivot.x;
+    rect_buffer->pivot_y[i]      = rect.pivot.y;
+    rect_buffer->color_r[i]      = rect.color.x;
+    rect_buffer->color_g[i]      = rect.color.y;
+    rect_buffer->color_b[i]      = rect.color.z;
+    rect_buffer->sort_order[i]   = rect.sort_order;
+    rect_buffer->tex_min_x[i]    = rect.tex_coords.bottom_left.x;
+    rect_buffer->tex_min_y[i]    = rect.tex_coords.bottom_left.y;
+    rect_buffer->tex_max_x[i]    = rect.tex_coords.top_right.x;
+    rect_buffer->tex_max_y[i]    = rect.tex_coords.top_right.y;
+    rect_buffer->transparency[i] = rect.transparency;
+    rect_buffer->outline[i]      = rect.outline;
+    rect_buffer->outline_r[i]    = rect.outline_color.x;
+    rect_buffer->outline_g[i]    = rect.outline_color.y;
+    rect_buffer->outline_b[i]    = rect.outline_color.z;
+    rect_buffer->slice_border[i] = rect.slice.x;
+    rect_buffer->slice_uv[i]     = rect.slice.y;
+    rect_buffer->anim_phase_x[i]     = rect.animation.phase.x;
+    rect_buffer->anim_phase_y[i]     = rect.animation.phase.y;
+    rect_buffer->anim_amplitude_x[i] = rect.animation.amplitude.x;
+    rect_buffer->anim_amplitude_y[i] = rect.animation.amplitude.y;
+    rect_buffer->anim_frequency[i]   = rect.animation.frequency;
+    rect_buffer->pulse_r[i]          = rect.animation.pulse_color.x;
+    rect_buffer->pulse_g[i]          = rect.animation.pulse_color.y;
+    rect_buffer->pulse_b[i]          = rect.animation.pulse_color.z;
+    rect_buffer->anim_flags[i]       = (i32)rect.animation.flags;
+    rect_buffer->texture_id[i]   = rect.texture_id;
+    rect_buffer->curr_len += 1;
+}
+
+void add_rect_to_buffer_quadmap(
+    Rect_Buffer*    rect_buffer,
+    Rect            rect,
+    const Tex_Quad* quad
+) {
+    SDL_assert(quad != NULL);
+    rect.tex_coords = tex_coords_map_to_quad(rect.tex_coords, quad);
+    add_rect_to_buffer(rect_buffer, rect);
+}
+
+void reset_rect_buffer(Rect_Buffer* rect_buffer) {
+    rect_buffer->curr_len = 0;
+}
+
+typedef struct {
+    size_t num_culled;
+    size_t num_kept;
+} Rect_Cull_Stats;
+
+//Removes the rects [first, curr_len) that lie entirely outside of the clip
+//region, the order of the remaining rects is preserved. Passing the rect count
+//from before a subtree was rendered as first clips only that subtree.
+Rect_Cull_Stats rect_buffer_cull(
+    Rect_Buffer* rect_buffer,
+    const size_t first,
+    const vec2   clip_min,
+    const vec2   clip_max
+) {
+    SDL_assert(first <= rect_buffer->curr_len);
+    Rect_Buffer* rb       = rect_buffer;
+    size_t       num_kept = first;
+    for (size_t i = first; i < rb->curr_len; i++) {
+        const float x0 = rb->pos_x[i] - rb->pivot_x[i] * rb->size_x[i];
+        const float y0 = rb->pos_y[i] - rb->pivot_y[i] * rb->size_y[i];
+        const float x1 = x0 + rb->size_x[i];
+        const float y1 = y0 + rb->size_y[i];
+        //sizes may be negative (mirrored rects)
+        const bool is_outside =
+            SDL_max(x0, x1) <= clip_min.x || SDL_min(x0, x1) >= clip_max.x ||
+            SDL_max(y0, y1) <= clip_min.y || SDL_min(y0, y1) >= clip_max.y;
+        if (is_outside) continue;
+
+        if (num_kept != i) {
+#define RECT_BUFFER_FIELD(type, name) rb->name[num_kept] = rb->name[i];
+            RECT_BUFFER_FIELDS(RECT_BUFFER_FIELD)
+#undef RECT_BUFFER_FIELD
+        }
+        num_kept++;
+    }
+
+    const Rect_Cull_Stats stats = {
+        .num_culled = rb->curr_len - num_kept,
+        .num_kept = num_kept - first,
+    };
+    rb->curr_len = num_kept;
+    return stats;
+}
+
+//The screen bounds of rect i, including how far its wobble animation can move
+//it. Widened by a pixel, as the packed instances round to whole pixels.
+void rect_buffer_bounds(
+    const Rect_Buffer* rect_buffer,
+    const size_t       i,
+    vec2*              min,
+    vec2*              max
+) {
+    const Rect_Buffer* rb = rect_buffer;
+    const float        x0 = rb->pos_x[i] - rb->pivot_x[i] * rb->size_x[i];
+    const float        y0 = rb->pos_y[i] - rb->pivot_y[i] * rb->size_y[i];
+    const float        x1 = x0 + rb->size_x[i];
+    const float        y1 = y0 + rb->size_y[i];
+    vec2               reach = {1.f, 1.f};
+    if (rb->anim_flags[i] & UI_ANIMATION_WOBBLE) {
+        reach.x += SDL_fabsf(rb->anim_amplitude_x[i]);
+        reach.y += SDL_fabsf(rb->anim_amplitude_y[i]);
+    }
+    //sizes may be negative (mirrored rects)
+    *min = (vec2){SDL_min(x0, x1) - reach.x, SDL_min(y0, y1) - reach.y};
+    *max = (vec2){SDL_max(x0, x1) + reach.x, SDL_max(y0, y1) + reach.y};
+}
+
+//Maps 0-1 to 0-max. Rounds as floor(value + 0.5) to match the simd kernels.
+i32 quantize_unorm(const float value, const float max) {
+    return (i32)SDL_floorf(SDL_clamp(value, 0.f, 1.f) * max + 0.5f);
+}
+
+//One instance per rect - the unit quad corners are expanded in rect_shader_vert
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES)
+//Quantized variant of the instance below (48 instead of 124 bytes).
+//The pivot is applied on the cpu and both corners are rounded to whole
+//framebuffer pixels, so that adjacent rects (e.g. tiles) stay seamless.
+//The sort order uses 16 bits instead of 8: the +-0.1 offsets between text,
+//outlines and their containers would collapse otherwise.
+typedef struct {
+    i16 pos[2];        //bottom left corner in framebuffer pixels
+    i16 size[2];       //in framebuffer pixels
+    u8  color[4];      //unorm rgba
+    u16 tex_coords[4]; //unorm bottom_left.xy, top_right.xy
+    u16 sort_order;    //unorm across SORT_ORDER_MIN - SORT_ORDER_MAX
+    u8  texture_id;
+    u8  animation_flags;
+    u8  outline[4];    //unorm rgb, width
+    //border in framebuffer pixels (negative = hollow), border fraction * 32767
+    i16 slice[2];
+    //phase xy in 1/16 s, amplitude xy in 1/16 pixels, frequency in 1/256
+    //radians per second, unused
+    i16 animation[6];
+    u8  pulse_color[4]; //unorm rgb, unused
+} Rect_Instance;
+
+SDL_COMPILE_TIME_ASSERT(rect_instance_size, sizeof(Rect_Instance) == 48);
+
+//Rounding is done as floor(clamp(value) + 0.5) - that is reproducible with
+//every simd instruction set below, which keeps scalar and simd output
+//identical bit for bit.
+#define RECT_QUANTIZE_PIXEL_MIN (-32768.f)
+#define RECT_QUANTIZE_PIXEL_MAX 32767.f
+#define RECT_QUANTIZE_SORT_ORDER_SCALE                                         \
+    (1.f / (CRLF_SORT_ORDER_MAX - CRLF_SORT_ORDER_MIN))
+
+//Animation phases wrap around after this many seconds to fit into 16 bits
+#define RECT_ANIMATION_PHASE_PERIOD 2048.f
+
+i32 quantize_pixel(const float value) {
+    return (i32)SDL_floorf(
+        SDL_clamp(value, RECT_QUANTIZE_PIXEL_MIN, RECT_QUANTIZE_PIXEL_MAX) +
+        0.5f
+    );
+}
+
+float rect_animation_wrap_phase(const float phase) {
+    return phase - SDL_floorf(phase * (1.f / RECT_ANIMATION_PHASE_PERIOD)) *
+        RECT_ANIMATION_PHASE_PERIOD;
+}
+
+//The quantized values of a single rect, shared by the scalar and simd kernels
+typedef enum {
+    RECT_QUANTIZED_MIN_X,
+    RECT_QUANTIZED_MIN_Y,
+    RECT_QUANTIZED_MAX_X,
+    RECT_QUANTIZED_MAX_Y,
+    RECT_QUANTIZED_COLOR_R,
+    RECT_QUANTIZED_COLOR_G,
+    RECT_QUANTIZED_COLOR_B,
+    RECT_QUANTIZED_COLOR_A,
+    RECT_QUANTIZED_TEX_MIN_X,
+    RECT_QUANTIZED_TEX_MIN_Y,
+    RECT_QUANTIZED_TEX_MAX_X,
+    RECT_QUANTIZED_TEX_MAX_Y,
+    RECT_QUANTIZED_SORT_ORDER,
+    RECT_QUANTIZED_OUTLINE_R,
+    RECT_QUANTIZED_OUTLINE_G,
+    RECT_QUANTIZED_OUTLINE_B,
+    RECT_QUANTIZED_OUTLINE_W,
+    RECT_QUANTIZED_SLICE_BORDER,
+    RECT_QUANTIZED_SLICE_UV,
+    RECT_QUANTIZED_ANIM_PHASE_X,
+    RECT_QUANTIZED_ANIM_PHASE_Y,
+    RECT_QUANTIZED_ANIM_AMPLITUDE_X,
+    RECT_QUANTIZED_ANIM_AMPLITUDE_Y,
+    RECT_QUANTIZED_ANIM_FREQUENCY,
+    RECT_QUANTIZED_PULSE_R,
+    RECT_QUANTIZED_PULSE_G,
+    RECT_QUANTIZED_PULSE_B,
+    RECT_QUANTIZED_COUNT,
+} Rect_Quantized;
+
+void rect_instance_pack(
+    const i32*     quantized, //RECT_QUANTIZED_COUNT values, lane stride apart
+    const size_t   stride,
+    const i32      texture_id,
+    const i32      animation_flags,
+    Rect_Instance* instance
+) {
+#define Q(value) quantized[RECT_QUANTIZED_##value * stride]
+    *instance = (Rect_Instance){
+        .pos = {(i16)Q(MIN_X), (i16)Q(MIN_Y)},
+        .size = {
+            (i16)SDL_clamp(Q(MAX_X) - Q(MIN_X), -32768, 32767),
+            (i16)SDL_clamp(Q(MAX_Y) - Q(MIN_Y), -32768, 32767),
+        },
+        .color = {
+            (u8)Q(COLOR_R), (u8)Q(COLOR_G), (u8)Q(COLOR_B), (u8)Q(COLOR_A)
+        },
+        .tex_coords = {
+            (u16)Q(TEX_MIN_X), (u16)Q(TEX_MIN_Y),
+            (u16)Q(TEX_MAX_X), (u16)Q(TEX_MAX_Y),
+        },
+        .sort_order = (u16)Q(SORT_ORDER),
+        .texture_id = (u8)texture_id,
+        .animation_flags = (u8)animation_flags,
+        .outline = {
+            (u8)Q(OUTLINE_R), (u8)Q(OUTLINE_G), (u8)Q(OUTLINE_B),
+            (u8)Q(OUTLINE_W)
+        },
+        .slice = {(i16)Q(SLICE_BORDER), (i16)Q(SLICE_UV)},
+        .animation = {
+            (i16)Q(ANIM_PHASE_X), (i16)Q(ANIM_PHASE_Y),
+            (i16)Q(ANIM_AMPLITUDE_X), (i16)Q(ANIM_AMPLITUDE_Y),
+            (i16)Q(ANIM_FREQUENCY), 0,
+        },
+        .pulse_color = {(u8)Q(PULSE_R), (u8)Q(PULSE_G), (u8)Q(PULSE_B), 0},
+    };
+#undef Q
+}
+
+void rect_kernel_scalar(
+    const Rect_Buffer* rect_buffer,
+    const size_t       first,
+    const size_t       count,
+    Rect_Instance*     instances
+) {
+    i32 quantized[RECT_QUANTIZED_COUNT];
+    for (size_t i = first; i < first + count; i++) {
+        const Rect_Buffer* rb = rect_buffer;
+        const float min_x = rb->pos_x[i] - rb->pivot_x[i] * rb->size_x[i];
+        const float min_y = rb->pos_y[i] - rb->pivot_y[i] * rb->size_y[i];
+        quantized[RECT_QUANTIZED_MIN_X] = quantize_pixel(min_x);
+        quantized[RECT_QUANTIZED_MIN_Y] = quantize_pixel(min_y);
+        quantized[RECT_QUANTIZED_MAX_X] = quantize_pixel(min_x + rb->size_x[i]);
+        quantized[RECT_QUANTIZED_MAX_Y] = quantize_pixel(min_y + rb->size_y[i]);
+        quantized[RECT_QUANTIZED_COLOR_R] = quantize_unorm(rb->color_r[i], 255.f);
+        quantized[RECT_QUANTIZED_COLOR_G] = quantize_unorm(rb->color_g[i], 255.f);
+        quantized[RECT_QUANTIZED_COLOR_B] = quantize_unorm(rb->color_b[i], 255.f);
+        quantized[RECT_QUANTIZED_COLOR_A] = quantize_unorm(
+            1.f - rb->transparency[i], 255.f
+        );
+        quantized[RECT_QUANTIZED_TEX_MIN_X] = quantize_unorm(
+            rb->tex_min_x[i], 65535.f
+        );
+        quantized[RECT_QUANTIZED_TEX_MIN_Y] = quantize_unorm(
+            rb->tex_min_y[i], 65535.f
+        );
+        quantized[RECT_QUANTIZED_TEX_MAX_X] = quantize_unorm(
+            rb->tex_max_x[i], 65535.f
+        );
+        quantized[RECT_QUANTIZED_TEX_MAX_Y] = quantize_unorm(
+            rb->tex_max_y[i], 65535.f
+        );
+        quantized[RECT_QUANTIZED_SORT_ORDER] = quantize_unorm(
+            (rb->sort_order[i] - CRLF_SORT_ORDER_MIN) *
+            RECT_QUANTIZE_SORT_ORDER_SCALE,
+            65535.f
+        );
+        quantized[RECT_QUANTIZED_OUTLINE_R] = quantize_unorm(
+            rb->outline_r[i], 255.f
+        );
+        quantized[RECT_QUANTIZED_OUTLINE_G] = quantize_unorm(
+            rb->outline_g[i], 255.f
+        );
+        quantized[RECT_QUANTIZED_OUTLINE_B] = quantize_unorm(
+            rb->outline_b[i], 255.f
+        );
+        quantized[RECT_QUANTIZED_OUTLINE_W] = quantize_unorm(
+            rb->outline[i], 255.f
+        );
+        quantized[RECT_QUANTIZED_SLICE_BORDER] = quantize_pixel(
+            rb->slice_border[i]
+        );
+        quantized[RECT_QUANTIZED_SLICE_UV] = quantize_unorm(
+            rb->slice_uv[i], 32767.f
+        );
+        quantized[RECT_QUANTIZED_ANIM_PHASE_X] = quantize_pixel(
+            rect_animation_wrap_phase(rb->anim_phase_x[i]) * 16.f
+        );
+        quantized[RECT_QUANTIZED_ANIM_PHASE_Y] = quantize_pixel(
+            rect_animation_wrap_phase(rb->anim_phase_y[i]) * 16.f
+        );
+        quantized[RECT_QUANTIZED_ANIM_AMPLITUDE_X] = quantize_pixel(
+            rb->anim_amplitude_x[i] * 16.f
+        );
+        quantized[RECT_QUANTIZED_ANIM_AMPLITUDE_Y] = quantize_pixel(
+            rb->anim_amplitude_y[i] * 16.f
+        );
+        quantized[RECT_QUANTIZED_ANIM_FREQUENCY] = quantize_pixel(
+            rb->anim_frequency[i] * 256.f
+        );
+        quantized[RECT_QUANTIZED_PULSE_R] = quantize_unorm(rb->pulse_r[i], 255.f);
+        quantized[RECT_QUANTIZED_PULSE_G] = quantize_unorm(rb->pulse_g[i], 255.f);
+        quantized[RECT_QUANTIZED_PULSE_B] = quantize_unorm(rb->pulse_b[i], 255.f);
+        rect_instance_pack(
+            quantized, 1, rb->texture_id[i], rb->anim_flags[i],
+            &instances[i - first]
+        );
+    }
+}
+
+#if defined(CRLF_SIMD_LANES)
+//Same math as rect_kernel_scalar, CRLF_SIMD_LANES rects at a time. The
+//quantized lanes are stored to a small buffer and packed per rect from there.
+void rect_kernel_simd(
+    const Rect_Buffer* rect_buffer,
+    const size_t       first,
+    const size_t       count,
+    Rect_Instance*     instances
+) {
+    const Rect_Buffer* rb = rect_buffer;
+    const Simd_F32 half             = simd_set1_f32(0.5f);
+    const Simd_F32 zero             = simd_set1_f32(0.f);
+    const Simd_F32 one              = simd_set1_f32(1.f);
+    const Simd_F32 pixel_min        = simd_set1_f32(RECT_QUANTIZE_PIXEL_MIN);
+    const Simd_F32 pixel_max        = simd_set1_f32(RECT_QUANTIZE_PIXEL_MAX);
+    const Simd_F32 unorm8_max       = simd_set1_f32(255.f);
+    const Simd_F32 unorm16_max      = simd_set1_f32(65535.f);
+    const Simd_F32 snorm16_max      = simd_set1_f32(32767.f);
+    const Simd_F32 fixed4_scale     = simd_set1_f32(16.f);
+    const Simd_F32 fixed8_scale     = simd_set1_f32(256.f);
+    const Simd_F32 phase_period     = simd_set1_f32(RECT_ANIMATION_PHASE_PERIOD);
+    const Simd_F32 phase_period_inv = simd_set1_f32(
+        1.f / RECT_ANIMATION_PHASE_PERIOD
+    );
+    const Simd_F32 sort_order_min   = simd_set1_f32(CRLF_SORT_ORDER_MIN);
+    const Simd_F32 sort_order_scale = simd_set1_f32(
+        RECT_QUANTIZE_SORT_ORDER_SCALE
+    );
+    i32 quantized[RECT_QUANTIZED_COUNT * CRLF_SIMD_LANES];
+
+#define QUANTIZE_PIXEL(index, value)                                           \
+    simd_store_i32(                                                            \
+        &quantized[RECT_QUANTIZED_##index * CRLF_SIMD_LANES],                  \
+        simd_floor_f32(simd_add_f32(                                           \
+            simd_max_f32(simd_min_f32(value, pixel_max), pixel_min), half      \
+        ))                                                                     \
+    );
+#define QUANTIZE_UNORM(index, value, max)                                      \
+    simd_store_i32(                                                            \
+        &quantized[RECT_QUANTIZED_##index * CRLF_SIMD_LANES],                  \
+        simd_floor_f32(simd_add_f32(simd_mul_f32(                              \
+            simd_max_f32(simd_min_f32(value, one), zero), max                  \
+        ), half))                                                              \
+    );
+
+//see rect_animation_wrap_phase
+#define WRAP_PHASE(value)                                                      \
+    simd_sub_f32(value, simd_mul_f32(                                          \
+        simd_floor_f32(simd_mul_f32(value, phase_period_inv)), phase_period    \
+    ))
+
+    size_t i = first;
+    for (; i + CRLF_SIMD_LANES <= first + count; i += CRLF_SIMD_LANES) {
+        const Simd_F32 size_x = simd_load_f32(&rb->size_x[i]);
+        const Simd_F32 size_y = simd_load_f32(&rb->size_y[i]);
+        const Simd_F32 min_x  = simd_sub_f32(
+            simd_load_f32(&rb->pos_x[i]),
+            simd_mul_f32(simd_load_f32(&rb->pivot_x[i]), size_x)
+        );
+        const Simd_F32 min_y = simd_sub_f32(
+            simd_load_f32(&rb->pos_y[i]),
+            simd_mul_f32(simd_load_f32(&rb->pivot_y[i]), size_y)
+        );
+        QUANTIZE_PIXEL(MIN_X, min_x)
+        QUANTIZE_PIXEL(MIN_Y, min_y)
+        QUANTIZE_PIXEL(MAX_X, simd_add_f32(min_x, size_x))
+        QUANTIZE_PIXEL(MAX_Y, simd_add_f32(min_y, size_y))
+        QUANTIZE_UNORM(COLOR_R, simd_load_f32(&rb->color_r[i]), unorm8_max)
+        QUANTIZE_UNORM(COLOR_G, simd_load_f32(&rb->color_g[i]), unorm8_max)
+        QUANTIZE_UNORM(COLOR_B, simd_load_f32(&rb->color_b[i]), unorm8_max)
+        QUANTIZE_UNORM(
+            COLOR_A,
+            simd_sub_f32(one, simd_load_f32(&rb->transparency[i])),
+            unorm8_max
+        )
+        QUANTIZE_UNORM(TEX_MIN_X, simd_load_f32(&rb->tex_min_x[i]), unorm16_max)
+        QUANTIZE_UNORM(TEX_MIN_Y, simd_load_f32(&rb->tex_min_y[i]), unorm16_max)
+        QUANTIZE_UNORM(TEX_MAX_X, simd_load_f32(&rb->tex_max_x[i]), unorm16_max)
+        QUANTIZE_UNORM(TEX_MAX_Y, simd_load_f32(&rb->tex_max_y[i]), unorm16_max)
+        QUANTIZE_UNORM(
+            SORT_ORDER,
+            simd_mul_f32(
+                simd_sub_f32(simd_load_f32(&rb->sort_order[i]), sort_order_min),
+                sort_order_scale
+            ),
+            unorm16_max
+        )
+        QUANTIZE_UNORM(OUTLINE_R, simd_load_f32(&rb->outline_r[i]), unorm8_max)
+        QUANTIZE_UNORM(OUTLINE_G, simd_load_f32(&rb->outline_g[i]), unorm8_max)
+        QUANTIZE_UNORM(OUTLINE_B, simd_load_f32(&rb->outline_b[i]), unorm8_max)
+        QUANTIZE_UNORM(OUTLINE_W, simd_load_f32(&rb->outline[i]), unorm8_max)
+        QUANTIZE_PIXEL(SLICE_BORDER, simd_load_f32(&rb->slice_border[i]))
+        QUANTIZE_UNORM(SLICE_UV, simd_load_f32(&rb->slice_uv[i]), snorm16_max)
+        QUANTIZE_PIXEL(
+            ANIM_PHASE_X, simd_mul_f32(
+                WRAP_PHASE(simd_load_f32(&rb->anim_phase_x[i])), fixed4_scale
+            )
+        )
+        QUANTIZE_PIXEL(
+            ANIM_PHASE_Y, simd_mul_f32(
+                WRAP_PHASE(simd_load_f32(&rb->anim_phase_y[i])), fixed4_scale
+            )
+        )
+        QUANTIZE_PIXEL(
+            ANIM_AMPLITUDE_X,
+            simd_mul_f32(simd_load_f32(&rb->anim_amplitude_x[i]), fixed4_scale)
+        )
+        QUANTIZE_PIXEL(
+            ANIM_AMPLITUDE_Y,
+            simd_mul_f32(simd_load_f32(&rb->anim_amplitude_y[i]), fixed4_scale)
+        )
+        QUANTIZE_PIXEL(
+            ANIM_FREQUENCY,
+            simd_mul_f32(simd_load_f32(&rb->anim_frequency[i]), fixed8_scale)
+        )
+        QUANTIZE_UNORM(PULSE_R, simd_load_f32(&rb->pulse_r[i]), unorm8_max)
+        QUANTIZE_UNORM(PULSE_G, simd_load_f32(&rb->pulse_g[i]), unorm8_max)
+        QUANTIZE_UNORM(PULSE_B, simd_load_f32(&rb->pulse_b[i]), unorm8_max)
+        for (size_t lane = 0; lane < CRLF_SIMD_LANES; lane++) {
+            rect_instance_pack(
+                &quantized[lane], CRLF_SIMD_LANES, rb->texture_id[i + lane],
+                rb->anim_flags[i + lane], &instances[i + lane - first]
+            );
+        }
+    }
+#undef WRAP_PHASE
+#undef QUANTIZE_PIXEL
+#undef QUANTIZE_UNORM
+
+    //remainder
+    rect_kernel_scalar(rect_buffer, i, first + count - i, &instances[i - first]);
+}
+#endif
+#else
+typedef struct {
+    vec2  pos;
+    vec2  size;
+    vec2  pivot;
+    vec4  color;
+    float sort_order; //Value Range SORT_ORDER_MIN - SORT_ORDER_MAX
+    vec2  tex_bottom_left;
+    vec2  tex_top_right;
+    i32   texture_id;
+    i32   animation_flags;
+    vec4  outline; //rgb, width
+    vec2  slice;   //border pixels (negative = hollow), border fraction
+    vec4  animation; //phase xy, amplitude xy
+    vec3  pulse_color;
+    float frequency;
+} Rect_Instance;
+
+//After instancing there is no math left for the float format - this is a
+//plain structure of arrays to array of structures copy, so there is no simd
+//variant for it.
+void rect_kernel_scalar(
+    const Rect_Buffer* rect_buffer,
+    const size_t       first,
+    const size_t       count,
+    Rect_Instance*     instances
+) {
+    const Rect_Buffer* rb = rect_buffer;
+    for (size_t i = first; i < first + count; i++) {
+        instances[i - first] = (Rect_Instance){
+            .pos = {rb->pos_x[i], rb->pos_y[i]},
+            .size = {rb->size_x[i], rb->size_y[i]},
+            .pivot = {rb->pivot_x[i], rb->pivot_y[i]},
+            .color = {
+                rb->color_r[i], rb->color_g[i], rb->color_b[i],
+                1.f - rb->transparency[i]
+            },
+            .sort_order = rb->sort_order[i],
+            .tex_bottom_left = {rb->tex_min_x[i], rb->tex_min_y[i]},
+            .tex_top_right = {rb->tex_max_x[i], rb->tex_max_y[i]},
+            .texture_id = rb->texture_id[i],
+            .outline = {
+                rb->outline_r[i], rb->outline_g[i], rb->outline_b[i],
+                rb->outline[i]
+            },
+            .slice = {rb->slice_border[i], rb->slice_uv[i]},
+            .animation_flags = rb->anim_flags[i],
+            .animation = {
+                rb->anim_phase_x[i], rb->anim_phase_y[i],
+                rb->anim_amplitude_x[i], rb->anim_amplitude_y[i]
+            },
+            .pulse_color = {rb->pulse_r[i], rb->pulse_g[i], rb->pulse_b[i]},
+            .frequency = rb->anim_frequency[i],
+        };
+    }
+}
+#endif
+
+typedef enum {
+    RECT_KERNEL_SCALAR,
+    RECT_KERNEL_SIMD,
+} Rect_Kernel;
+
+bool rect_kernel_has_simd() {
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES) && defined(CRLF_SIMD_LANES)
+    return true;
+#else
+    return false;
+#endif
+}
+
+//Converts rects [first, first + count) to instances, instances[0] = first rect
+void rect_kernel_build_instances(
+    const Rect_Kernel  kernel,
+    const Rect_Buffer* rect_buffer,
+    const size_t       first,
+    const size_t       count,
+    Rect_Instance*     instances
+) {
+    SDL_assert(first + count <= rect_buffer->curr_len);
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES) && defined(CRLF_SIMD_LANES)
+    if (kernel == RECT_KERNEL_SIMD) {
+        rect_kernel_simd(rect_buffer, first, count, instances);
+        return;
+    }
+#else
+    (void)kernel;
+#endif
+    rect_kernel_scalar(rect_buffer, first, count, instances);
+}
+
+//Grows along with the rect buffer, gets drawn in RECT_BATCH_CAPACITY chunks
+typedef struct {
+    Rect_Instance* instances;
+    size_t         curr_len;
+    size_t         capacity;
+} Rect_Instance_Buffer;
+
+void rect_instance_buffer_init(
+    Rect_Instance_Buffer* instance_buffer,
+    const size_t          capacity
+) {
+    *instance_buffer = (Rect_Instance_Buffer){
+        .instances = CRLF_malloc(capacity * sizeof(Rect_Instance)),
+        .capacity = capacity,
+    };
+    SDL_assert(instance_buffer->instances != NULL);
+}
+
+void rect_instance_buffer_cleanup(Rect_Instance_Buffer* instance_buffer) {
+    SDL_assert(instance_buffer->instances != NULL);
+    CRLF_free(instance_buffer->instances);
+    instance_buffer->instances = NULL;
+}
+
+void rect_instance_buffer_reserve(
+    Rect_Instance_Buffer* instance_buffer,
+    const size_t          capacity
+) {
+    if (capacity <= instance_buffer->capacity) return;
+    const size_t new_capacity = SDL_max(
+        capacity, instance_buffer->capacity * 2
+    );
+    instance_buffer->instances = CRLF_realloc(
+        instance_buffer->instances, new_capacity * sizeof(Rect_Instance)
+    );
+    SDL_assert(instance_buffer->instances != NULL);
+    instance_buffer->capacity = new_capacity;
+}
+
+void build_rect_instance_buffer(
+    const Rect_Buffer*    rect_buffer,
+    Rect_Instance_Buffer* instance_buffer
+) {
+    rect_instance_buffer_reserve(instance_buffer, rect_buffer->curr_len);
+    rect_kernel_build_instances(
+        RECT_KERNEL_SIMD, rect_buffer, 0, rect_buffer->curr_len,
+        instance_buffer->instances
+    );
+    instance_buffer->curr_len = rect_buffer->curr_len;
+}
+
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+//Splits build_rect_instance_buffer into slices that are converted in parallel.
+//Every slice writes its own range of the instance buffer, so the result is
+//identical to the serial build regardless of how the threads are scheduled.
+//The caller thread builds the first slice itself when joining - this way the
+//work in between begin and join (the ui input pass) overlaps with the build.
+#define RECT_BUILD_MAX_WORKERS 7
+//below this a slice is not worth waking up another thread for
+#define RECT_BUILD_MIN_SLICE 4096
+
+typedef struct Rect_Build_Pool Rect_Build_Pool;
+
+typedef struct {
+    Rect_Build_Pool* pool;
+    SDL_Thread*      thread;
+    SDL_Semaphore*   start;
+    i32              slice;
+} Rect_Build_Worker;
+
+struct Rect_Build_Pool {
+    Rect_Build_Worker     workers[RECT_BUILD_MAX_WORKERS];
+    i32                   num_workers;
+    SDL_Semaphore*        done;
+    SDL_AtomicInt         quit;
+    const Rect_Buffer*    rect_buffer;
+    Rect_Instance_Buffer* instance_buffer;
+    i32                   num_slices;
+    bool                  is_building;
+};
+
+void rect_build_pool_build_slice(const Rect_Build_Pool* pool, const i32 slice) {
+    const size_t len   = pool->rect_buffer->curr_len;
+    const size_t first = len * slice / pool->num_slices;
+    const size_t last  = len * (slice + 1) / pool->num_slices;
+    rect_kernel_build_instances(
+        RECT_KERNEL_SIMD, pool->rect_buffer, first, last - first,
+        &pool->instance_buffer->instances[first]
+    );
+}
+
+int rect_build_worker_run(void* data) {
+    Rect_Build_Worker* worker = data;
+    Rect_Build_Pool*   pool   = worker->pool;
+    for (;;) {
+        SDL_WaitSemaphore(worker->start);
+        if (SDL_GetAtomicInt(&pool->quit)) return 0;
+        rect_build_pool_build_slice(pool, worker->slice);
+        SDL_SignalSemaphore(pool->done);
+    }
+}
+
+void rect_build_pool_init(Rect_Build_Pool* pool) {
+    *pool = (Rect_Build_Pool){
+        .num_workers = SDL_clamp(
+            SDL_GetNumLogicalCPUCores() - 1, 0, RECT_BUILD_MAX_WORKERS
+        ),
+        .done = SDL_CreateSemaphore(0),
+    };
+    SDL_assert(pool->done != NULL);
+    SDL_SetAtomicInt(&pool->quit, 0);
+
+    for (i32 i = 0; i < pool->num_workers; i++) {
+        Rect_Build_Worker* worker = &pool->workers[i];
+        worker->pool  = pool;
+        worker->slice = i + 1; //slice 0 belongs to the joining thread
+        worker->start = SDL_CreateSemaphore(0);
+        SDL_assert(worker->start != NULL);
+        worker->thread = SDL_CreateThread(
+            rect_build_worker_run, "rect_build", worker
+        );
+        if (worker->thread == NULL) {
+            log_warning(
+                "Failed to create rect build thread: %s", SDL_GetError()
+            );
+            SDL_DestroySemaphore(worker->start);
+            pool->num_workers = i;
+            break;
+        }
+    }
+    log_msg("rect build threads: %d", pool->num_workers + 1);
+}
+
+void rect_build_pool_cleanup(Rect_Build_Pool* pool) {
+    SDL_assert(!pool->is_building);
+    SDL_SetAtomicInt(&pool->quit, 1);
+    for (i32 i = 0; i < pool->num_workers; i++) {
+        SDL_SignalSemaphore(pool->workers[i].start);
+    }
+    for (i32 i = 0; i < pool->num_workers; i++) {
+        SDL_WaitThread(pool->workers[i].thread, NULL);
+        SDL_DestroySemaphore(pool->workers[i].start);
+    }
+    SDL_DestroySemaphore(pool->done);
+    pool->num_workers = 0;
+}
+
+//The rect buffer must not be modified until rect_build_pool_join returned
+void rect_build_pool_begin(
+    Rect_Build_Pool*      pool,
+    const Rect_Buffer*    rect_buffer,
+    Rect_Instance_Buffer* instance_buffer
+) {
+    SDL_assert(!pool->is_building);
+    rect_instance_buffer_reserve(instance_buffer, rect_buffer->curr_len);
+    instance_buffer->curr_len = rect_buffer->curr_len;
+
+    pool->rect_buffer     = rect_buffer;
+    pool->instance_buffer = instance_buffer;
+    pool->is_building     = true;
+    pool->num_slices      = (i32)SDL_clamp(
+        rect_buffer->curr_len / RECT_BUILD_MIN_SLICE, 1,
+        (size_t)pool->num_workers + 1
+    );
+    for (i32 i = 0; i < pool->num_slices - 1; i++) {
+        SDL_SignalSemaphore(pool->workers[i].start);
+    }
+}
+
+void rect_build_pool_join(Rect_Build_Pool* pool) {
+    SDL_assert(pool->is_building);
+    rect_build_pool_build_slice(pool, 0);
+    for (i32 i = 0; i < pool->num_slices - 1; i++) {
+        SDL_WaitSemaphore(pool->done);
+    }
+    pool->is_building = false;
+}
+#endif
+
+#if defined(__DEBUG__)
+//Reports rects/second of the scalar and simd kernels (and of the thread pool)
+//and checks that all of them produce identical instances.
+void benchmark_rect_kernels() {
+    const size_t rect_counts[] = {10000, 25000, 50000, 100000};
+    const i32    num_counts    = sizeof(rect_counts) / sizeof(size_t);
+    const size_t max_count     = rect_counts[num_counts - 1];
+    const i32    iterations    = 20;
+
+    Rect_Buffer rect_buffer;
+    rect_buffer_init(&rect_buffer, max_count);
+    Rect_Instance* scalar_instances = CRLF_malloc(
+        max_count * sizeof(Rect_Instance)
+    );
+    Rect_Instance* simd_instances = CRLF_malloc(
+        max_count * sizeof(Rect_Instance)
+    );
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+    Rect_Build_Pool      pool;
+    Rect_Instance_Buffer threaded_instances;
+    rect_build_pool_init(&pool);
+    rect_instance_buffer_init(&threaded_instances, max_count);
+#endif
+
+    Random random;
+    random_init(&random, 1337);
+    for (size_t i = 0; i < max_count; i++) {
+        add_rect_to_buffer(&rect_buffer, (Rect){
+            .pos = {
+                random_float_range(&random, -100.f, 4000.f),
+                random_float_range(&random, -100.f, 4000.f),
+            },
+            .size = {
+                random_float_range(&random, 0.f, 500.f),
+                random_float_range(&random, 0.f, 500.f),
+            },
+            .pivot = {random_float(&random), random_float(&random)},
+            .color = {
+                random_float(&random), random_float(&random),
+                random_float(&random)
+            },
+            .sort_order = random_float_range(
+                &random, CRLF_SORT_ORDER_MIN, CRLF_SORT_ORDER_MAX
+            ),
+            .texture_id = random_int_range(&random, 0, 15),
+            .tex_coords = tex_coords_from_cell_index(
+                random_int_range(&random, 0, 15), 4, 4
+            ),
+            .transparency = random_float(&random) < 0.25f
+                                ? random_float(&random)
+                                : 0.f,
+        });
+    }
+
+    //only the packed format has a simd kernel
+    const bool has_simd = rect_kernel_has_simd();
+    if (!has_simd) {
+        log_msg("rect kernel: no simd kernel in this build, scalar only");
+    }
+    const double frequency = (double)SDL_GetPerformanceFrequency();
+    for (i32 c = 0; c < num_counts; c++) {
+        const size_t count = rect_counts[c];
+
+        u64 start = SDL_GetPerformanceCounter();
+        for (i32 i = 0; i < iterations; i++) {
+            rect_kernel_build_instances(
+                RECT_KERNEL_SCALAR, &rect_buffer, 0, count, scalar_instances
+            );
+        }
+        const double scalar_sec =
+            (double)(SDL_GetPerformanceCounter() - start) / frequency;
+        const double total = (double)count * (double)iterations;
+
+        if (has_simd) {
+            start = SDL_GetPerformanceCounter();
+            for (i32 i = 0; i < iterations; i++) {
+                rect_kernel_build_instances(
+                    RECT_KERNEL_SIMD, &rect_buffer, 0, count, simd_instances
+                );
+            }
+            const double simd_sec =
+                (double)(SDL_GetPerformanceCounter() - start) / frequency;
+
+            const bool identical = SDL_memcmp(
+                scalar_instances, simd_instances,
+                count * sizeof(Rect_Instance)
+            ) == 0;
+            log_msg(
+                "rect kernel %6zu rects: scalar %7.2f Mrects/s, %s %7.2f "
+                "Mrects/s (x%.2f) - output %s",
+                count, total / scalar_sec / 1e6, CRLF_SIMD_NAME,
+                total / simd_sec / 1e6, scalar_sec / simd_sec,
+                identical ? "identical" : "MISMATCH"
+            );
+        } else {
+            log_msg(
+                "rect kernel %6zu rects: scalar %7.2f Mrects/s",
+                count, total / scalar_sec / 1e6
+            );
+        }
+
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+        rect_buffer.curr_len = count;
+        start = SDL_GetPerformanceCounter();
+        for (i32 i = 0; i < iterations; i++) {
+            rect_build_pool_begin(&pool, &rect_buffer, &threaded_instances);
+            rect_build_pool_join(&pool);
+        }
+        const double threaded_sec =
+            (double)(SDL_GetPerformanceCounter() - start) / frequency;
+        rect_buffer.curr_len = max_count;
+
+        const bool threaded_identical = SDL_memcmp(
+            scalar_instances, threaded_instances.instances,
+            count * sizeof(Rect_Instance)
+        ) == 0;
+        log_msg(
+            "rect kernel %6zu rects: %d threads %7.2f Mrects/s (x%.2f) - "
+            "output %s",
+            count, pool.num_slices, total / threaded_sec / 1e6,
+            scalar_sec / threaded_sec,
+            threaded_identical ? "identical" : "MISMATCH"
+        );
+#endif
+    }
+
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+    rect_build_pool_cleanup(&pool);
+    rect_instance_buffer_cleanup(&threaded_instances);
+#endif
+    CRLF_free(scalar_instances);
+    CRLF_free(simd_instances);
+    rect_buffer_cleanup(&rect_buffer);
+}
+#endif
+
+/* RECT SORTING ***************************************************************/
+/*  Every rect gets a 32 bit key, the rects are drawn in ascending key order:
+        bit  31     class: 0 = opaque, 1 = translucent
+        bits 30-29  texture array, opaque rects only
+        bits 28-13  depth: sort order as unorm16, inverted for opaque rects
+        bits 12-5   texture id
+        bits 4-0    unused
+    Opaque rects come first, grouped by texture array and front to back within
+    each array, so the depth test rejects as much of the overdraw as possible
+    and every array is bound once. Translucent rects follow back to front with
+    blending enabled - their order can't be traded for fewer binds, a run ends
+    wherever the array changes. The sort is stable - rects with equal keys keep
+    the order they were added in.
+*/
+#define RECT_SORT_KEY_TRANSLUCENT (1u << 31)
+#define RECT_SORT_KEY_ARRAY_SHIFT 29
+#define RECT_SORT_KEY_DEPTH_SHIFT 13
+#define RECT_SORT_KEY_TEXTURE_SHIFT 5
+#define RECT_SORT_RADIX_BITS 8
+#define RECT_SORT_RADIX_SIZE (1 << RECT_SORT_RADIX_BITS)
+
+typedef struct {
+    u32*   keys;
+    u32*   indices; //rect indices in draw order after rect_sort_build
+    u32*   temp_keys;
+    u32*   temp_indices;
+    size_t curr_len;
+    size_t capacity;
+    size_t num_opaque;
+} Rect_Sort;
+
+void rect_sort_init(Rect_Sort* rect_sort, const size_t capacity) {
+    *rect_sort = (Rect_Sort){
+        .keys = CRLF_malloc(capacity * sizeof(u32)),
+        .indices = CRLF_malloc(capacity * sizeof(u32)),
+        .temp_keys = CRLF_malloc(capacity * sizeof(u32)),
+        .temp_indices = CRLF_malloc(capacity * sizeof(u32)),
+        .capacity = capacity,
+    };
+    SDL_assert(rect_sort->keys != NULL && rect_sort->indices != NULL);
+    SDL_assert(rect_sort->temp_keys != NULL && rect_sort->temp_indices != NULL);
+}
+
+void rect_sort_cleanup(Rect_Sort* rect_sort) {
+    CRLF_free(rect_sort->keys);
+    CRLF_free(rect_sort->indices);
+    CRLF_free(rect_sort->temp_keys);
+    CRLF_free(rect_sort->temp_indices);
+    *rect_sort = (Rect_Sort){0};
+}
+
+void rect_sort_reserve(Rect_Sort* rect_sort, const size_t capacity) {
+    if (capacity <= rect_sort->capacity) return;
+    const size_t new_capacity = SDL_max(capacity, rect_sort->capacity * 2);
+    const size_t size         = new_capacity * sizeof(u32);
+    //contents are rebuilt every frame, no need to preserve them
+    CRLF_free(rect_sort->keys);
+    CRLF_free(rect_sort->indices);
+    CRLF_free(rect_sort->temp_keys);
+    CRLF_free(rect_sort->temp_indices);
+    rect_sort->keys         = CRLF_malloc(size);
+    rect_sort->indices      = CRLF_malloc(size);
+    rect_sort->temp_keys    = CRLF_malloc(size);
+    rect_sort->temp_indices = CRLF_malloc(size);
+    SDL_assert(rect_sort->keys != NULL && rect_sort->indices != NULL);
+    SDL_assert(rect_sort->temp_keys != NULL && rect_sort->temp_indices != NULL);
+    rect_sort->capacity = new_capacity;
+}
+
+u32 rect_sort_key(
+    const float sort_order,
+    const i32   texture_id,
+    const i32   array,
+    const bool  is_translucent
+) {
+    const u32 depth = (u32)quantize_unorm(
+        (sort_order - CRLF_SORT_ORDER_MIN) /
+        (CRLF_SORT_ORDER_MAX - CRLF_SORT_ORDER_MIN),
+        65535.f
+    );
+    //a higher sort order is closer to the camera
+    if (is_translucent) {
+        return RECT_SORT_KEY_TRANSLUCENT |
+            depth << RECT_SORT_KEY_DEPTH_SHIFT |
+            ((u32)texture_id & 0xFF) << RECT_SORT_KEY_TEXTURE_SHIFT;
+    }
+    return (u32)array << RECT_SORT_KEY_ARRAY_SHIFT |
+        (65535 - depth) << RECT_SORT_KEY_DEPTH_SHIFT |
+        ((u32)texture_id & 0xFF) << RECT_SORT_KEY_TEXTURE_SHIFT;
+}
+
+//LSD radix sort of the key/index pairs, one pass per 8 bit digit. Passes in
+//which every key has the same digit are skipped (e.g. the unused low bits).
+void rect_sort_radix(Rect_Sort* rect_sort) {
+    const size_t len = rect_sort->curr_len;
+    for (u32 shift = 0; shift < 32; shift += RECT_SORT_RADIX_BITS) {
+        size_t offsets[RECT_SORT_RADIX_SIZE] = {0};
+        for (size_t i = 0; i < len; i++) {
+            offsets[(rect_sort->keys[i] >> shift) & 0xFF]++;
+        }
+        if (len == 0 || offsets[(rect_sort->keys[0] >> shift) & 0xFF] == len) {
+            continue;
+        }
+
+        size_t sum = 0;
+        for (i32 digit = 0; digit < RECT_SORT_RADIX_SIZE; digit++) {
+            const size_t count = offsets[digit];
+            offsets[digit]     = sum;
+            sum += count;
+        }
+        for (size_t i = 0; i < len; i++) {
+            const u32    key = rect_sort->keys[i];
+            const size_t dst = offsets[(key >> shift) & 0xFF]++;
+            rect_sort->temp_keys[dst]    = key;
+            rect_sort->temp_indices[dst] = rect_sort->indices[i];
+        }
+
+        u32* keys               = rect_sort->keys;
+        u32* indices            = rect_sort->indices;
+        rect_sort->keys         = rect_sort->temp_keys;
+        rect_sort->indices      = rect_sort->temp_indices;
+        rect_sort->temp_keys    = keys;
+        rect_sort->temp_indices = indices;
+    }
+}
+
+//Only reads the rect buffer, so it may run while the instances are built
+void rect_sort_build(
+    Rect_Sort*                  rect_sort,
+    const Rect_Buffer*          rect_buffer,
+    const Texture_Array_Layout* layout
+) {
+    const size_t len = rect_buffer->curr_len;
+    rect_sort_reserve(rect_sort, len);
+    rect_sort->curr_len   = len;
+    rect_sort->num_opaque = 0;
+    for (size_t i = 0; i < len; i++) {
+        const bool is_translucent = rect_buffer->transparency[i] > 0.f;
+        const i32  texture_id     = rect_buffer->texture_id[i];
+        rect_sort->keys[i]        = rect_sort_key(
+            rect_buffer->sort_order[i], texture_id,
+            texture_array_layout_find(layout, texture_id), is_translucent
+        );
+        rect_sort->indices[i] = (u32)i;
+        rect_sort->num_opaque += !is_translucent;
+    }
+    rect_sort_radix(rect_sort);
+}
+
+//Gathers the instances in sorted order
+void rect_sort_apply(
+    const Rect_Sort*            rect_sort,
+    const Rect_Instance_Buffer* instance_buffer,
+    Rect_Instance_Buffer*       sorted_buffer
+) {
+    SDL_assert(rect_sort->curr_len == instance_buffer->curr_len);
+    rect_instance_buffer_reserve(sorted_buffer, rect_sort->curr_len);
+    for (size_t i = 0; i < rect_sort->curr_len; i++) {
+        sorted_buffer->instances[i] =
+            instance_buffer->instances[rect_sort->indices[i]];
+    }
+    sorted_buffer->curr_len = rect_sort->curr_len;
+}
+
+/* RECT RENDERER **************************************************************/
+//Instances of one draw call, sampling a single texture array
+typedef struct {
+    size_t offset; //in bytes, inside the stream buffer
+    i32    count;
+    i32    array;
+} Rect_Batch;
+
+typedef struct {
+    Renderer      renderer; //vbo holds the static unit quad
+    Stream_Buffer stream;   //per-instance Rect_Instance data
+    Rect_Batch*   batches;  //uploaded this frame by rect_renderer_upload
+    i32           num_uploaded_batches;
+    i32           batch_capacity;
+    i32           num_batches; //draw calls issued this frame
+} Rect_Renderer;
+
+//Instance attributes are re-pointed for every draw as each frame's instances
+//live at a different offset inside the stream buffer.
+void rect_renderer_set_instance_attribs(const size_t base_offset) {
+    const GLsizei instance_size = sizeof(Rect_Instance);
+#define RECT_INSTANCE_ATTRIB(loc, count, type, normalized, member)             \
+    glVertexAttribPointer(                                                     \
+        loc, count, type, normalized, instance_size,                           \
+        (void*)(base_offset + offsetof(Rect_Instance, member))                 \
+    );
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES)
+    RECT_INSTANCE_ATTRIB(1, 2, GL_SHORT, GL_FALSE, pos)
+    RECT_INSTANCE_ATTRIB(2, 2, GL_SHORT, GL_FALSE, size)
+    //the pivot is already applied, location 3 stays at its constant 0
+    RECT_INSTANCE_ATTRIB(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, color)
+    RECT_INSTANCE_ATTRIB(5, 1, GL_UNSIGNED_SHORT, GL_TRUE, sort_order)
+    RECT_INSTANCE_ATTRIB(6, 4, GL_UNSIGNED_SHORT, GL_TRUE, tex_coords)
+    //texture_id and animation_flags
+    glVertexAttribIPointer(
+        7, 2, GL_UNSIGNED_BYTE, instance_size,
+        (void*)(base_offset + offsetof(Rect_Instance, texture_id))
+    );
+    RECT_INSTANCE_ATTRIB(8, 4, GL_UNSIGNED_BYTE, GL_TRUE, outline)
+    RECT_INSTANCE_ATTRIB(9, 2, GL_SHORT, GL_FALSE, slice)
+    RECT_INSTANCE_ATTRIB(10, 4, GL_SHORT, GL_FALSE, animation)
+    RECT_INSTANCE_ATTRIB(11, 3, GL_UNSIGNED_BYTE, GL_TRUE, pulse_color)
+    RECT_INSTANCE_ATTRIB(12, 1, GL_SHORT, GL_FALSE, animation[4])
+#else
+    RECT_INSTANCE_ATTRIB(1, 2, GL_FLOAT, GL_FALSE, pos)
+    RECT_INSTANCE_ATTRIB(2, 2, GL_FLOAT, GL_FALSE, size)
+    RECT_INSTANCE_ATTRIB(3, 2, GL_FLOAT, GL_FALSE, pivot)
+    RECT_INSTANCE_ATTRIB(4, 4, GL_FLOAT, GL_FALSE, color)
+    RECT_INSTANCE_ATTRIB(5, 1, GL_FLOAT, GL_FALSE, sort_order)
+    //tex_bottom_left and tex_top_right are adjacent, read them as one vec4
+    RECT_INSTANCE_ATTRIB(6, 4, GL_FLOAT, GL_FALSE, tex_bottom_left)
+    //texture_id and animation_flags
+    glVertexAttribIPointer(
+        7, 2, GL_INT, instance_size,
+        (void*)(base_offset + offsetof(Rect_Instance, texture_id))
+    );
+    RECT_INSTANCE_ATTRIB(8, 4, GL_FLOAT, GL_FALSE, outline)
+    RECT_INSTANCE_ATTRIB(9, 2, GL_FLOAT, GL_FALSE, slice)
+    RECT_INSTANCE_ATTRIB(10, 4, GL_FLOAT, GL_FALSE, animation)
+    RECT_INSTANCE_ATTRIB(11, 3, GL_FLOAT, GL_FALSE, pulse_color)
+    RECT_INSTANCE_ATTRIB(12, 1, GL_FLOAT, GL_FALSE, frequency)
+#endif
+#undef RECT_INSTANCE_ATTRIB
+}
+
+void rect_renderer_init(Rect_Renderer* rect_renderer) {
+    //Triangle strip: bottom left, bottom right, top left, top right
+    const float quad_corners[] = {
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        0.0f, 1.0f,
+        1.0f, 1.0f,
+    };
+
+    Renderer* renderer = &rect_renderer->renderer;
+    renderer_init(renderer);
+    renderer_bind(renderer);
+    glBufferData(
+        GL_ARRAY_BUFFER, sizeof(quad_corners), &quad_corners[0],
+        GL_STATIC_DRAW
+    );
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+
+    stream_buffer_init(
+        &rect_renderer->stream,
+        sizeof(Rect_Instance) * RECT_BATCH_CAPACITY,
+        stream_buffer_default_mode()
+    );
+    rect_renderer_set_instance_attribs(0);
+    for (u32 loc = 1; loc <= 12; loc++) {
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES)
+        if (loc == 3) {
+            glVertexAttrib4f(3, 0.f, 0.f, 0.f, 1.f); //pivot
+            continue;
+        }
+#endif
+        glEnableVertexAttribArray(loc);
+        glVertexAttribDivisor(loc, 1);
+    }
+}
+
+void rect_renderer_cleanup(Rect_Renderer* rect_renderer) {
+    CRLF_free(rect_renderer->batches);
+    rect_renderer->batches = NULL;
+    stream_buffer_cleanup(&rect_renderer->stream);
+    renderer_cleanup(&rect_renderer->renderer);
+}
+
+void rect_renderer_begin_frame(Rect_Renderer* rect_renderer) {
+    rect_renderer->num_batches          = 0;
+    rect_renderer->num_uploaded_batches = 0;
+    stream_buffer_begin_frame(&rect_renderer->stream);
+}
+
+void rect_renderer_end_frame(Rect_Renderer* rect_renderer) {
+    stream_buffer_end_frame(&rect_renderer->stream);
+}
+
+//Uploads all instances of the frame at once, ahead of their draws, so they
+//can be drawn several times (e.g. once per damaged rect). They are split into
+//runs sampling the same texture array, no run crosses split, each run in
+//chunks of RECT_BATCH_CAPACITY. Returns the first batch at or after split.
+i32 rect_renderer_upload(
+    Rect_Renderer*              rect_renderer,
+    const Rect_Instance_Buffer* instance_buffer,
+    const size_t                split,
+    const Texture_Array_Set*    texture_arrays
+) {
+    SDL_assert(split <= instance_buffer->curr_len);
+    const Rect_Instance* instances   = instance_buffer->instances;
+    const size_t         count       = instance_buffer->curr_len;
+    i32                  split_batch = 0;
+    rect_renderer->num_uploaded_batches = 0;
+    size_t run_first = 0;
+    while (run_first < count) {
+        if (run_first == split) {
+            split_batch = rect_renderer->num_uploaded_batches;
+        }
+        const size_t run_last = run_first < split ? split : count;
+        const i32    array    = texture_array_layout_find(
+            &texture_arrays->layout, instances[run_first].texture_id
+        );
+        size_t run_end = run_first + 1;
+        while (run_end < run_last &&
+               texture_array_layout_find(
+                   &texture_arrays->layout, instances[run_end].texture_id
+               ) == array) {
+            run_end++;
+        }
+        for (size_t batch_first = run_first; batch_first < run_end;
+             batch_first += RECT_BATCH_CAPACITY) {
+            if (rect_renderer->num_uploaded_batches ==
+                rect_renderer->batch_capacity) {
+                rect_renderer->batch_capacity = SDL_max(
+                    rect_renderer->batch_capacity * 2, 16
+                );
+                rect_renderer->batches = CRLF_realloc(
+                    rect_renderer->batches,
+                    sizeof(Rect_Batch) * rect_renderer->batch_capacity
+                );
+                SDL_assert(rect_renderer->batches != NULL);
+            }
+            rect_renderer->batches[rect_renderer->num_uploaded_batches++] =
+                (Rect_Batch){
+                    .count = (i32)SDL_min(
+                        RECT_BATCH_CAPACITY, run_end - batch_first
+                    ),
+                    .array = array,
+                };
+        }
+        run_first = run_end;
+    }
+    if (split == count) split_batch = rect_renderer->num_uploaded_batches;
+
+    const i32 num_batches = rect_renderer->num_uploaded_batches;
+    stream_buffer_reserve(
+        &rect_renderer->stream, sizeof(Rect_Instance) * count,
+        (size_t)num_batches
+    );
+    size_t first = 0;
+    for (i32 i = 0; i < num_batches; i++) {
+        Rect_Batch* batch = &rect_renderer->batches[i];
+        batch->offset = stream_buffer_write(
+            &rect_renderer->stream, &instances[first],
+            sizeof(Rect_Instance) * (size_t)batch->count
+        );
+        first += (size_t)batch->count;
+    }
+    return split_batch;
+}
+
+//This assumes shader and blend state are already bound.
+//Draws the uploaded batches [first, end), one draw call each.
+void draw_rects(
+    Rect_Renderer*           rect_renderer,
+    const i32                first,
+    const i32                end,
+    const Texture_Array_Set* texture_arrays
+) {
+    SDL_assert(end <= rect_renderer->num_uploaded_batches);
+    if (first == end) return;
+    renderer_bind(&rect_renderer->renderer);
+    gl_state_bind_array_buffer(rect_renderer->stream.vbo);
+    for (i32 i = first; i < end; i++) {
+        const Rect_Batch* batch = &rect_renderer->batches[i];
+        texture_array_set_bind(texture_arrays, batch->array);
+        rect_renderer_set_instance_attribs(batch->offset);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)batch->count);
+        rect_renderer->num_batches++;
+    }
+}
+
+/* RECT LAYER CACHE ***********************************************************/
+/*  Retained layers for static ui: a container with is_cached set still emits
+    its rects every frame (immediate mode stays the single source of truth),
+    but they are hashed and moved out of the rect buffer right away. As long
+    as the hash matches the layer's instances stay in their own gl buffer and
+    are drawn with a single draw call - no instance build, sort or upload.
+    Layers containing translucent rects are not cached, as they would have to
+    be sorted with the rest of the translucent rects. The instances of a layer
+    are grouped by texture array, one draw call per array.
+    The cache lives on the thread that builds the frame, the gl buffers are
+    owned by the Rect_Layer_Buffers of the thread that draws it. Only the
+    instances of rebuilt layers are handed over with the Rect_Layer_Frame.
+*/
+#define RECT_LAYER_CACHE_MAX_LAYERS 16
+//frames a layer may stay unused before its buffer gets released
+#define RECT_LAYER_CACHE_MAX_UNUSED_FRAMES 120
+
+SDL_COMPILE_TIME_ASSERT(
+    rect_layer_mask_size, RECT_LAYER_CACHE_MAX_LAYERS <= 32
+);
+
+typedef struct {
+    u32    id; //container id, 0 = free slot
+    u64    hash;
+    size_t count;
+    size_t array_counts[TEXTURE_ARRAY_COUNT];
+    vec2   bounds_min, bounds_max; //of all rects, see rect_buffer_bounds
+    bool   is_animated;            //has rects animated in the shader
+    bool   is_used;                //submitted this frame
+    i32    unused_frames;
+} Rect_Layer;
+
+//Everything the draw side needs to know about the layers of a frame
+typedef struct {
+    size_t               counts[RECT_LAYER_CACHE_MAX_LAYERS]; //0 = not drawn
+    size_t               array_counts[RECT_LAYER_CACHE_MAX_LAYERS]
+                                     [TEXTURE_ARRAY_COUNT];
+    size_t               upload_first[RECT_LAYER_CACHE_MAX_LAYERS];
+    u32                  upload_mask;  //layers rebuilt this frame
+    u32                  release_mask; //layers whose buffer can be freed
+    Rect_Instance_Buffer uploads;      //instances of the rebuilt layers
+} Rect_Layer_Frame;
+
+typedef struct {
+    Rect_Layer           layers[RECT_LAYER_CACHE_MAX_LAYERS];
+    Rect_Layer_Frame     frame;        //the frame currently being built
+    Rect_Instance_Buffer scratch;      //rebuilt instances before grouping
+    i32                  num_hits;     //layers reused this frame
+    i32                  num_rebuilds; //layers rebuilt this frame
+} Rect_Layer_Cache;
+
+//FNV-1a over the rects [first, first + count) of every field
+u64 rect_buffer_hash(
+    const Rect_Buffer* rect_buffer,
+    const size_t       first,
+    const size_t       count
+) {
+    u64 hash = 0xcbf29ce484222325ULL;
+#define RECT_BUFFER_FIELD(type, name)                                          \
+    {                                                                          \
+        const u8* bytes = (const u8*)&rect_buffer->name[first];                \
+        for (size_t i = 0; i < count * sizeof(type); i++) {                    \
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;                       \
+        }                                                                      \
+    }
+    RECT_BUFFER_FIELDS(RECT_BUFFER_FIELD)
+#undef RECT_BUFFER_FIELD
+    return hash;
+}
+
+void rect_layer_frame_init(Rect_Layer_Frame* frame) {
+    *frame = (Rect_Layer_Frame){0};
+    rect_instance_buffer_init(&frame->uploads, 64);
+}
+
+void rect_layer_frame_cleanup(Rect_Layer_Frame* frame) {
+    rect_instance_buffer_cleanup(&frame->uploads);
+}
+
+void rect_layer_cache_init(Rect_Layer_Cache* cache) {
+    *cache = (Rect_Layer_Cache){0};
+    rect_layer_frame_init(&cache->frame);
+    rect_instance_buffer_init(&cache->scratch, 64);
+}
+
+void rect_layer_cache_cleanup(Rect_Layer_Cache* cache) {
+    rect_layer_frame_cleanup(&cache->frame);
+    rect_instance_buffer_cleanup(&cache->scratch);
+}
+
+void rect_layer_cache_begin_frame(Rect_Layer_Cache* cache) {
+    cache->num_hits     = 0;
+    cache->num_rebuilds = 0;
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        cache->layers[i].is_used = false;
+        cache->frame.counts[i]   = 0;
+    }
+    cache->frame.upload_mask      = 0;
+    cache->frame.release_mask     = 0;
+    cache->frame.uploads.curr_len = 0;
+}
+
+Rect_Layer* rect_layer_cache_find(Rect_Layer_Cache* cache, const u32 id) {
+    Rect_Layer* free_layer = NULL;
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        Rect_Layer* layer = &cache->layers[i];
+        if (layer->id == id) return layer;
+        if (layer->id == 0 && free_layer == NULL) free_layer = layer;
+    }
+    if (free_layer != NULL) free_layer->id = id;
+    return free_layer;
+}
+
+//Takes the rects [first, curr_len) emitted by the container with the given id.
+//Returns false if they could not be cached - they stay in the rect buffer then.
+bool rect_layer_cache_submit(
+    Rect_Layer_Cache*           cache,
+    const u32                   id,
+    Rect_Buffer*                rect_buffer,
+    const size_t                first,
+    const Texture_Array_Layout* layout
+) {
+    SDL_assert(first <= rect_buffer->curr_len);
+    const size_t count = rect_buffer->curr_len - first;
+    if (id == 0 || count == 0) return false;
+    for (size_t i = first; i < rect_buffer->curr_len; i++) {
+        if (rect_buffer->transparency[i] > 0.f) return false;
+    }
+
+    Rect_Layer* layer = rect_layer_cache_find(cache, id);
+    if (layer == NULL) return false; //all layers are taken
+    SDL_assert(!layer->is_used); //container ids have to be unique
+
+    Rect_Layer_Frame* frame = &cache->frame;
+    const i32         slot  = (i32)(layer - cache->layers);
+    const u64         hash  = rect_buffer_hash(rect_buffer, first, count);
+    if (layer->count == count && layer->hash == hash) {
+        cache->num_hits++;
+    } else {
+        Rect_Instance_Buffer* scratch = &cache->scratch;
+        rect_instance_buffer_reserve(scratch, count);
+        rect_kernel_build_instances(
+            RECT_KERNEL_SIMD, rect_buffer, first, count, scratch->instances
+        );
+        //stable counting sort by texture array
+        size_t offsets[TEXTURE_ARRAY_COUNT] = {0};
+        for (i32 i = 0; i < TEXTURE_ARRAY_COUNT; i++) {
+            layer->array_counts[i] = 0;
+        }
+        rect_buffer_bounds(
+            rect_buffer, first, &layer->bounds_min, &layer->bounds_max
+        );
+        layer->is_animated = false;
+        for (size_t i = first; i < first + count; i++) {
+            layer->array_counts[texture_array_layout_find(
+                layout, rect_buffer->texture_id[i]
+            )]++;
+            vec2 min, max;
+            rect_buffer_bounds(rect_buffer, i, &min, &max);
+            layer->bounds_min.x = SDL_min(layer->bounds_min.x, min.x);
+            layer->bounds_min.y = SDL_min(layer->bounds_min.y, min.y);
+            layer->bounds_max.x = SDL_max(layer->bounds_max.x, max.x);
+            layer->bounds_max.y = SDL_max(layer->bounds_max.y, max.y);
+            if (rect_buffer->anim_flags[i] != UI_ANIMATION_NONE) {
+                layer->is_animated = true;
+            }
+        }
+        for (i32 i = 1; i < TEXTURE_ARRAY_COUNT; i++) {
+            offsets[i] = offsets[i - 1] + layer->array_counts[i - 1];
+        }
+        Rect_Instance_Buffer* uploads = &frame->uploads;
+        rect_instance_buffer_reserve(uploads, uploads->curr_len + count);
+        Rect_Instance* dst = &uploads->instances[uploads->curr_len];
+        for (size_t i = 0; i < count; i++) {
+            const i32 array = texture_array_layout_find(
+                layout, rect_buffer->texture_id[first + i]
+            );
+            dst[offsets[array]++] = scratch->instances[i];
+        }
+        frame->upload_first[slot] = uploads->curr_len;
+        frame->upload_mask |= 1u << slot;
+        uploads->curr_len += count;
+        layer->count = count;
+        layer->hash  = hash;
+        cache->num_rebuilds++;
+    }
+    frame->counts[slot]   = count;
+    SDL_memcpy(
+        frame->array_counts[slot], layer->array_counts,
+        sizeof(layer->array_counts)
+    );
+    layer->is_used        = true;
+    layer->unused_frames  = 0;
+    rect_buffer->curr_len = first;
+    return true;
+}
+
+//Releases the layers that went unused for too long and hands the frame over
+//to out. The frame previously in out is reused for the next frame.
+void rect_layer_cache_end_frame(
+    Rect_Layer_Cache* cache,
+    Rect_Layer_Frame* out
+) {
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        Rect_Layer* layer = &cache->layers[i];
+        if (layer->id == 0 || layer->is_used) continue;
+        layer->unused_frames++;
+        if (layer->unused_frames > RECT_LAYER_CACHE_MAX_UNUSED_FRAMES) {
+            cache->frame.release_mask |= 1u << i;
+            *layer = (Rect_Layer){0};
+        }
+    }
+    const Rect_Layer_Frame frame = *out;
+    *out                         = cache->frame;
+    cache->frame                 = frame;
+}
+
+//The gl side of the layer cache: one buffer per layer slot
+typedef struct {
+    u32 vbos[RECT_LAYER_CACHE_MAX_LAYERS];
+} Rect_Layer_Buffers;
+
+void rect_layer_buffers_cleanup(Rect_Layer_Buffers* buffers) {
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        if (buffers->vbos[i] == 0) continue;
+        gl_state_forget_buffer(buffers->vbos[i]);
+        glDeleteBuffers(1, &buffers->vbos[i]);
+        buffers->vbos[i] = 0;
+    }
+}
+
+//Uploads the rebuilt layers of the frame and frees the released ones. Once per
+//frame, even if nothing gets drawn - the cache only hands rebuilds over once.
+void rect_layer_buffers_upload(
+    Rect_Layer_Buffers*     buffers,
+    const Rect_Layer_Frame* frame
+) {
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        const u32 bit = 1u << i;
+        u32*      vbo = &buffers->vbos[i];
+        if ((frame->release_mask & bit) && *vbo != 0) {
+            gl_state_forget_buffer(*vbo);
+            glDeleteBuffers(1, vbo);
+            *vbo = 0;
+        }
+        if (!(frame->upload_mask & bit)) continue;
+        if (*vbo == 0) glGenBuffers(1, vbo);
+        gl_state_bind_array_buffer(*vbo);
+        glBufferData(
+            GL_ARRAY_BUFFER,
+            (GLsizeiptr)(sizeof(Rect_Instance) * frame->counts[i]),
+            &frame->uploads.instances[frame->upload_first[i]],
+            GL_STATIC_DRAW
+        );
+    }
+}
+
+//Draws all layers of the frame, after rect_layer_buffers_upload.
+//Assumes the same state as draw_rects.
+void rect_layer_buffers_draw(
+    Rect_Layer_Buffers*      buffers,
+    const Rect_Layer_Frame*  frame,
+    const Texture_Array_Set* texture_arrays,
+    Rect_Renderer*           rect_renderer
+) {
+    renderer_bind(&rect_renderer->renderer);
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        const size_t count = frame->counts[i];
+        if (count == 0) continue;
+        SDL_assert(buffers->vbos[i] != 0);
+        gl_state_bind_array_buffer(buffers->vbos[i]);
+        size_t array_first = 0;
+        for (i32 array = 0; array < TEXTURE_ARRAY_COUNT; array++) {
+            const size_t array_count = frame->array_counts[i][array];
+            if (array_count == 0) continue;
+            texture_array_set_bind(texture_arrays, array);
+            rect_renderer_set_instance_attribs(
+                array_first * sizeof(Rect_Instance)
+            );
+            glDrawArraysInstanced(
+                GL_TRIANGLE_STRIP, 0, 4, (GLsizei)array_count
+            );
+            rect_renderer->num_batches++;
+            array_first += array_count;
+        }
+    }
+}
+
+/* TILEMAP ********************************************************************/
+/*  A UI_TILEMAP element is drawn as a single quad. The tile types live in an
+    R8UI texture per tilemap id, the fragment shader fetches the tile type and
+    samples its atlas cell. The build side (Tilemap_Cache) assigns every
+    tilemap a texture slot and only copies its tiles into the Tilemap_Frame
+    when the version changed. The draw side (Tilemap_Renderer) then uploads
+    only the rows that actually differ.
+*/
+#define TILEMAP_MAX_TEXTURES 4
+#define TILEMAP_MAX_DRAWS 4
+
+//Everything a tilemap draw needs, captured in the rect pass
+typedef struct {
+    u32    id;
+    i32    slot; //texture slot of the Tilemap_Renderer
+    ivec2  size;
+    bool   has_texels; //tiles changed, texels_first is valid
+    size_t texels_first;
+    vec2   screen_min;
+    vec2   screen_size;
+    vec2   view_min;
+    vec2   view_size;
+    float  sort_order;
+    i32    texture_id;
+    i32    num_tile_types;
+    vec4   tex_coords[UI_TILEMAP_MAX_TILE_TYPES];
+    vec4   colors[UI_TILEMAP_MAX_TILE_TYPES];
+    vec3   pulse_colors[UI_TILEMAP_MAX_TILE_TYPES];
+    vec2   wobble[UI_TILEMAP_MAX_TILE_TYPES];
+} Tilemap_Draw;
+
+//The tilemaps of a frame, tile types are stored as u8 texels
+typedef struct {
+    Tilemap_Draw draws[TILEMAP_MAX_DRAWS];
+    i32          num_draws;
+    u8*          texels;
+    size_t       num_texels;
+    size_t       texels_capacity;
+} Tilemap_Frame;
+
+typedef struct {
+    u32   id; //tilemap id, 0 = free slot
+    u32   version;
+    ivec2 size;
+    bool  is_used; //submitted this frame
+} Tilemap_Slot;
+
+typedef struct {
+    Tilemap_Slot  slots[TILEMAP_MAX_TEXTURES];
+    Tilemap_Frame frame; //the frame currently being built
+} Tilemap_Cache;
+
+void tilemap_frame_cleanup(Tilemap_Frame* frame) {
+    CRLF_free(frame->texels);
+    *frame = (Tilemap_Frame){0};
+}
+
+void tilemap_cache_init(Tilemap_Cache* cache) {
+    *cache = (Tilemap_Cache){0};
+}
+
+void tilemap_cache_cleanup(Tilemap_Cache* cache) {
+    tilemap_frame_cleanup(&cache->frame);
+}
+
+void tilemap_cache_begin_frame(Tilemap_Cache* cache) {
+    cache->frame.num_draws  = 0;
+    cache->frame.num_texels = 0;
+    for (i32 i = 0; i < TILEMAP_MAX_TEXTURES; i++) {
+        cache->slots[i].is_used = false;
+    }
+}
+
+Tilemap_Slot* tilemap_cache_find_slot(Tilemap_Cache* cache, const u32 id) {
+    Tilemap_Slot* free_slot = NULL;
+    for (i32 i = 0; i < TILEMAP_MAX_TEXTURES; i++) {
+        Tilemap_Slot* slot = &cache->slots[i];
+        if (slot->id == id) return slot;
+        if (free_slot != NULL) continue;
+        //slots not drawn this frame may be taken over
+        if (slot->id == 0 || !slot->is_used) free_slot = slot;
+    }
+    if (free_slot != NULL) *free_slot = (Tilemap_Slot){0};
+    return free_slot;
+}
+
+//Converts the tiles to u8 and appends them to the texels of the frame
+size_t tilemap_frame_push_texels(
+    Tilemap_Frame* frame,
+    const i32*     tiles,
+    const size_t   count
+) {
+    if (frame->num_texels + count > frame->texels_capacity) {
+        frame->texels_capacity = SDL_max(
+            frame->texels_capacity * 2, frame->num_texels + count
+        );
+        frame->texels = CRLF_realloc(frame->texels, frame->texels_capacity);
+        SDL_assert(frame->texels != NULL);
+    }
+    const size_t first = frame->num_texels;
+    for (size_t i = 0; i < count; i++) {
+        frame->texels[first + i] = (u8)SDL_clamp(tiles[i], 0, 255);
+    }
+    frame->num_texels += count;
+    return first;
+}
+
+void tilemap_cache_submit(
+    Tilemap_Cache*           cache,
+    const UI_Tilemap_Config* config,
+    const Texture_Atlas*     atlas,
+    const vec2               screen_center,
+    const vec2               screen_size,
+    const float              sort_order
+) {
+    SDL_assert(config->id != 0);
+    SDL_assert(config->num_tile_types <= UI_TILEMAP_MAX_TILE_TYPES);
+    if (config->tiles == NULL) return;
+    Tilemap_Frame* frame = &cache->frame;
+    if (frame->num_draws == TILEMAP_MAX_DRAWS) {
+        log_warning("tilemap: more than %d tilemaps, skipping %u",
+                    TILEMAP_MAX_DRAWS, config->id);
+        return;
+    }
+    Tilemap_Slot* slot = tilemap_cache_find_slot(cache, config->id);
+    if (slot == NULL) {
+        log_warning("tilemap: no texture slot left for %u", config->id);
+        return;
+    }
+    const bool is_changed = slot->id != config->id ||
+        slot->version != config->version || slot->size.x != config->size.x ||
+        slot->size.y != config->size.y;
+    *slot = (Tilemap_Slot){
+        .id = config->id,
+        .version = config->version,
+        .size = config->size,
+        .is_used = true,
+    };
+
+    Tilemap_Draw* draw = &frame->draws[frame->num_draws];
+    *draw              = (Tilemap_Draw){
+        .id = config->id,
+        .slot = (i32)(slot - cache->slots),
+        .size = config->size,
+        .has_texels = is_changed,
+        .screen_min = vec2_sub_vec2(
+            screen_center, vec2_mul_float(screen_size, .5f)
+        ),
+        .screen_size = screen_size,
+        .view_min = config->view_min,
+        .view_size = config->view_size,
+        .sort_order = sort_order,
+        .texture_id = config->texture_id,
+        .num_tile_types = config->num_tile_types,
+    };
+    if (is_changed) {
+        draw->texels_first = tilemap_frame_push_texels(
+            frame, config->tiles,
+            (size_t)config->size.x * (size_t)config->size.y
+        );
+    }
+    for (i32 i = 0; i < config->num_tile_types; i++) {
+        const UI_Tilemap_Tile* tile = &config->tile_types[i];
+        const Tex_Quad         quad = tex_quad_from_cell(
+            tile->cell.row, tile->cell.column, atlas->rows, atlas->columns
+        );
+        draw->tex_coords[i] = (vec4){
+            quad.min.x, quad.min.y, quad.max.x, quad.max.y
+        };
+        draw->colors[i] = (vec4){
+            tile->color.x, tile->color.y, tile->color.z,
+            tile->is_animated ? 1.f : 0.f
+        };
+        draw->pulse_colors[i] = tile->pulse_color;
+        draw->wobble[i]       = (vec2){
+            tile->wobble_speed, tile->wobble_displace
+        };
+    }
+    frame->num_draws++;
+}
+
+//Hands the frame over to out, the frame previously in out gets reused
+void tilemap_cache_end_frame(Tilemap_Cache* cache, Tilemap_Frame* out) {
+    const Tilemap_Frame frame = *out;
+    *out                      = cache->frame;
+    cache->frame              = frame;
+}
+
+typedef struct {
+    u32        id; //tilemap id of the uploaded texels
+    GL_Texture texture;
+    u8*        texels; //copy of the uploaded tile types
+} Tilemap_Texture;
+
+typedef struct {
+    Renderer        renderer; //vbo holds the static unit quad
+    Shader_Program  shader;
+    Tilemap_Texture textures[TILEMAP_MAX_TEXTURES];
+    size_t          upload_bytes; //tile data uploaded last frame
+} Tilemap_Renderer;
+
+void tilemap_renderer_init(Tilemap_Renderer* tilemap_renderer) {
+    *tilemap_renderer = (Tilemap_Renderer){0};
+    //Triangle strip: bottom left, bottom right, top left, top right
+    const float quad_corners[] = {
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        0.0f, 1.0f,
+        1.0f, 1.0f,
+    };
+
+    Renderer* renderer = &tilemap_renderer->renderer;
+    renderer_init(renderer);
+    renderer_bind(renderer);
+    glBufferData(
+        GL_ARRAY_BUFFER, sizeof(quad_corners), &quad_corners[0],
+        GL_STATIC_DRAW
+    );
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), NULL);
+
+    tilemap_renderer->shader = compile_shader_program(
+        tilemap_shader_vert, tilemap_shader_frag
+    );
+}
+
+void tilemap_texture_free(Tilemap_Texture* texture) {
+    if (texture->texture.id != 0) gl_texture_delete(&texture->texture);
+    CRLF_free(texture->texels);
+    *texture = (Tilemap_Texture){0};
+}
+
+void tilemap_renderer_cleanup(Tilemap_Renderer* tilemap_renderer) {
+    for (i32 i = 0; i < TILEMAP_MAX_TEXTURES; i++) {
+        tilemap_texture_free(&tilemap_renderer->textures[i]);
+    }
+    delete_shader_program(&tilemap_renderer->shader);
+    renderer_cleanup(&tilemap_renderer->renderer);
+}
+
+//Uploads the rows of the draw's texels that differ from the last upload. A new
+//tilemap or size re-creates the texture.
+void tilemap_texture_update(
+    Tilemap_Texture*     texture,
+    const Tilemap_Draw*  draw,
+    const Tilemap_Frame* frame,
+    size_t*              upload_bytes
+) {
+    if (!draw->has_texels) return;
+    const i32  width  = draw->size.x;
+    const i32  height = draw->size.y;
+    const bool is_new = texture->texture.id == 0 || texture->id != draw->id ||
+        texture->texture.width != width || texture->texture.height != height;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (is_new) {
+        if (texture->texture.id != 0) gl_texture_delete(&texture->texture);
+        CRLF_free(texture->texels);
+        texture->id      = draw->id;
+        texture->texels  = CRLF_malloc((size_t)width * (size_t)height);
+        texture->texture = (GL_Texture){
+            .width = width,
+            .height = height,
+            .channels = 1,
+        };
+        glGenTextures(1, &texture->texture.id);
+        SDL_assert(texture->texture.id > 0);
+        gl_texture_bind(&texture->texture, 1);
+        //integer textures can't be filtered: nearest, clamped
+        texture_apply_config(GL_TEXTURE_2D, (Texture_Config){0});
+    }
+
+    const u8* texels    = &frame->texels[draw->texels_first];
+    i32       first_row = is_new ? 0 : height;
+    i32       last_row  = is_new ? height - 1 : -1;
+    for (i32 y = 0; y < height; y++) {
+        const size_t row = (size_t)y * (size_t)width;
+        if (SDL_memcmp(&texture->texels[row], &texels[row], width) == 0)
+            continue;
+        SDL_memcpy(&texture->texels[row], &texels[row], width);
+        first_row = SDL_min(first_row, y);
+        last_row  = SDL_max(last_row, y);
+    }
+
+    if (is_new) {
+        SDL_memcpy(texture->texels, texels, (size_t)width * (size_t)height);
+        glTexImage2D(
+            GL_TEXTURE_2D, 0, GL_R8UI, width, height, 0, GL_RED_INTEGER,
+            GL_UNSIGNED_BYTE, texture->texels
+        );
+        *upload_bytes += (size_t)width * (size_t)height;
+    } else if (first_row <= last_row) {
+        gl_texture_bind(&texture->texture, 1);
+        const i32 num_rows = last_row - first_row + 1;
+        glTexSubImage2D(
+            GL_TEXTURE_2D, 0, 0, first_row, width, num_rows, GL_RED_INTEGER,
+            GL_UNSIGNED_BYTE,
+            &texture->texels[(size_t)first_row * (size_t)width]
+        );
+        *upload_bytes += (size_t)width * (size_t)num_rows;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+//Updates the textures of the tilemaps of the frame. Once per frame, even if
+//nothing gets drawn - changed texels are only handed over once.
+void tilemap_renderer_upload(
+    Tilemap_Renderer*    tilemap_renderer,
+    const Tilemap_Frame* frame
+) {
+    tilemap_renderer->upload_bytes = 0;
+    for (i32 i = 0; i < frame->num_draws; i++) {
+        const Tilemap_Draw* draw = &frame->draws[i];
+        tilemap_texture_update(
+            &tilemap_renderer->textures[draw->slot], draw, frame,
+            &tilemap_renderer->upload_bytes
+        );
+    }
+}
+
+//Draws the tilemaps of the frame, after tilemap_renderer_upload. Depth tested
+//against the rects, binds the texture array of each tilemap's atlas to slot 0.
+void tilemap_renderer_draw(
+    Tilemap_Renderer*        tilemap_renderer,
+    const Tilemap_Frame*     frame,
+    const Texture_Array_Set* texture_arrays,
+    const mat4*              projection,
+    const float              time
+) {
+    if (frame->num_draws == 0) return;
+    Shader_Program* program = &tilemap_renderer->shader;
+    gl_state_use_program(program->id);
+    glUniformMatrix4fv(
+        shader_uniform_location(program, "projection"), 1, GL_FALSE,
+        (const GLfloat*)(&projection->matrix[0])
+    );
+    glUniform1i(shader_uniform_location(program, "tiles"), 1);
+    glUniform1i(shader_uniform_location(program, "textureArray"), 0);
+    glUniform1f(shader_uniform_location(program, "time"), time);
+    glUniform1f(shader_uniform_location(program, "alphaClipThreshold"), 0.5f);
+    renderer_bind(&tilemap_renderer->renderer);
+
+    for (i32 i = 0; i < frame->num_draws; i++) {
+        const Tilemap_Draw* draw    = &frame->draws[i];
+        Tilemap_Texture*    texture = &tilemap_renderer->textures[draw->slot];
+        SDL_assert(texture->id == draw->id);
+        gl_texture_bind(&texture->texture, 1);
+        const i32 array = texture_array_layout_find(
+            &texture_arrays->layout, draw->texture_id
+        );
+        texture_array_set_bind(texture_arrays, array);
+
+        glUniform4f(
+            shader_uniform_location(program, "screenRect"),
+            draw->screen_min.x, draw->screen_min.y,
+            draw->screen_size.x, draw->screen_size.y
+        );
+        glUniform4f(
+            shader_uniform_location(program, "viewRect"),
+            draw->view_min.x, draw->view_min.y,
+            draw->view_size.x, draw->view_size.y
+        );
+        glUniform1f(
+            shader_uniform_location(program, "sortOrder"), draw->sort_order
+        );
+        glUniform2i(
+            shader_uniform_location(program, "mapSize"), draw->size.x,
+            draw->size.y
+        );
+        glUniform1i(
+            shader_uniform_location(program, "textureLayer"),
+            draw->texture_id - texture_arrays->layout.first_texture_id[array]
+        );
+        glUniform1i(
+            shader_uniform_location(program, "numTileTypes"),
+            draw->num_tile_types
+        );
+        glUniform4fv(
+            shader_uniform_location(program, "tileTexCoords"),
+            draw->num_tile_types, (const GLfloat*)&draw->tex_coords[0]
+        );
+        glUniform4fv(
+            shader_uniform_location(program, "tileColors"),
+            draw->num_tile_types, (const GLfloat*)&draw->colors[0]
+        );
+        glUniform3fv(
+            shader_uniform_location(program, "tilePulseColors"),
+            draw->num_tile_types, (const GLfloat*)&draw->pulse_colors[0]
+        );
+        glUniform2fv(
+            shader_uniform_location(program, "tileWobble"),
+            draw->num_tile_types, (const GLfloat*)&draw->wobble[0]
+        );
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+}
+
+/* UI DAMAGE ******************************************************************/
+/*  Finds the regions of viewport_ui that changed since the previous frame, a
+    viewport_ui that persists between frames then only gets those redrawn
+    (see CRLF_USE_UI_DAMAGE). The frame buffer is split into tiles, every rect,
+    cached layer and tilemap mixes its hash into the tiles its bounds touch -
+    in the order they are submitted. A tile whose hash differs from the one of
+    the previous frame is damaged, that covers changed, moved, added and
+    removed elements alike. Elements animated in the shaders damage their
+    tiles every frame. The damaged tiles are merged into a few rects, each of
+    them is cleared and redrawn under its own scissor.
+*/
+#define UI_DAMAGE_TILE_SIZE 64
+#define UI_DAMAGE_MAX_RECTS 4
+//redrawing more of the frame buffer than this in pieces doesn't pay off
+#define UI_DAMAGE_MAX_RATIO .5f
+
+//In frame buffer pixels, max is exclusive
+typedef struct {
+    ivec2 min, max;
+} UI_Damage_Rect;
+
+//What the thread drawing the frame needs to know
+typedef struct {
+    bool           is_full; //redraw everything, e.g. after a resize
+    UI_Damage_Rect rects[UI_DAMAGE_MAX_RECTS];
+    i32            num_rects; //nothing changed if 0 without is_full
+    float          ratio;     //of the frame buffer that gets redrawn
+} UI_Damage;
+
+typedef struct {
+    u64*  hashes;      //per tile, of the previous frame
+    u64*  next_hashes; //per tile, of the frame being built
+    bool* is_dirty;    //per tile, damaged regardless of the hash
+    ivec2 num_tiles;
+    ivec2 frame_buffer_size;
+    u64   frame_hash; //of the state all tiles depend on
+    bool  has_frame;  //hashes are of the previous frame
+} UI_Damage_Tracker;
+
+//FNV-1a, continuing from hash
+u64 ui_damage_hash_bytes(u64 hash, const void* data, const size_t size) {
+    const u8* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+//Finalizer of splitmix64, the tile hashes depend on the order of the mixes
+u64 ui_damage_mix(u64 x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void ui_damage_tracker_cleanup(UI_Damage_Tracker* tracker) {
+    CRLF_free(tracker->hashes);
+    CRLF_free(tracker->next_hashes);
+    CRLF_free(tracker->is_dirty);
+    *tracker = (UI_Damage_Tracker){0};
+}
+
+size_t ui_damage_num_tiles(const UI_Damage_Tracker* tracker) {
+    return (size_t)tracker->num_tiles.x * (size_t)tracker->num_tiles.y;
+}
+
+//Everything is damaged when the frame buffer size or the frame hash (of what
+//all tiles depend on, e.g. the projection) changed
+void ui_damage_begin_frame(
+    UI_Damage_Tracker* tracker,
+    const ivec2        frame_buffer_size,
+    const u64          frame_hash
 ) {
-    return (Tex_Coords){
-        .bottom_left = vec2_mul_float(tex_coords.bottom_left, factor),
-        .bottom_right = vec2_mul_float(tex_coords.bottom_right, factor),
-        .top_left = vec2_mul_float(tex_coords.top_left, factor),
-        .top_right = vec2_mul_float(tex_coords.top_right, factor),
-    };
+    if (frame_buffer_size.x != tracker->frame_buffer_size.x ||
+        frame_buffer_size.y != tracker->frame_buffer_size.y) {
+        const i32 tile_size = UI_DAMAGE_TILE_SIZE;
+        tracker->frame_buffer_size = frame_buffer_size;
+        tracker->num_tiles         = (ivec2){
+            (frame_buffer_size.x + tile_size - 1) / tile_size,
+            (frame_buffer_size.y + tile_size - 1) / tile_size,
+        };
+        const size_t num_tiles = ui_damage_num_tiles(tracker);
+        tracker->hashes        = CRLF_realloc(
+            tracker->hashes, num_tiles * sizeof(u64)
+        );
+        tracker->next_hashes = CRLF_realloc(
+            tracker->next_hashes, num_tiles * sizeof(u64)
+        );
+        tracker->is_dirty = CRLF_realloc(
+            tracker->is_dirty, num_tiles * sizeof(bool)
+        );
+        SDL_assert(tracker->hashes != NULL);
+        SDL_assert(tracker->next_hashes != NULL);
+        SDL_assert(tracker->is_dirty != NULL);
+        tracker->has_frame = false;
+    }
+    if (frame_hash != tracker->frame_hash) tracker->has_frame = false;
+    tracker->frame_hash = frame_hash;
+    const size_t num_tiles = ui_damage_num_tiles(tracker);
+    SDL_memset(tracker->next_hashes, 0, num_tiles * sizeof(u64));
+    SDL_memset(tracker->is_dirty, 0, num_tiles * sizeof(bool));
 }
 
-Tex_Coords tex_coords_mul_vec2(
-    const Tex_Coords tex_coords,
-    const vec2       factor
+//Mixes hash into the tiles touched by the bounds, is_dirty damages them
+//regardless (e.g. for animations)
+void ui_damage_add(
+    UI_Damage_Tracker* tracker,
+    const vec2         min,
+    const vec2         max,
+    const u64          hash,
+    const bool         is_dirty
 ) {
-    return (Tex_Coords){
-        .bottom_left = vec2_mul_vec2(tex_coords.bottom_left, factor),
-        .bottom_right = vec2_mul_vec2(tex_coords.bottom_right, factor),
-        .top_left = vec2_mul_vec2(tex_coords.top_left, factor),
-        .top_right = vec2_mul_vec2(tex_coords.top_right, factor),
-    };
+    const vec2 size = ivec2_to_vec2(tracker->frame_buffer_size);
+    if (max.x <= 0.f || max.y <= 0.f || min.x >= size.x || min.y >= size.y) {
+        return;
+    }
+    const float tile_size = (float)UI_DAMAGE_TILE_SIZE;
+    const i32   x0        = (i32)(SDL_max(min.x, 0.f) / tile_size);
+    const i32   y0        = (i32)(SDL_max(min.y, 0.f) / tile_size);
+    const i32   x1        = (i32)(SDL_min(max.x, size.x - 1.f) / tile_size);
+    const i32   y1        = (i32)(SDL_min(max.y, size.y - 1.f) / tile_size);
+    for (i32 y = y0; y <= y1; y++) {
+        const size_t row = (size_t)y * (size_t)tracker->num_tiles.x;
+        for (i32 x = x0; x <= x1; x++) {
+            u64* tile_hash = &tracker->next_hashes[row + (size_t)x];
+            *tile_hash     = ui_damage_mix(*tile_hash ^ hash);
+            tracker->is_dirty[row + (size_t)x] |= is_dirty;
+        }
+    }
 }
 
-Tex_Coords tex_coords_add_vec2(
-    const Tex_Coords tex_coords,
-    const vec2       vec
+//The rects that are built and sorted every frame
+void ui_damage_add_rects(
+    UI_Damage_Tracker* tracker,
+    const Rect_Buffer* rect_buffer
 ) {
-    return (Tex_Coords){
-        .bottom_left = vec2_add_vec2(tex_coords.bottom_left, vec),
-        .bottom_right = vec2_add_vec2(tex_coords.bottom_right, vec),
-        .top_left = vec2_add_vec2(tex_coords.top_left, vec),
-        .top_right = vec2_add_vec2(tex_coords.top_right, vec),
-    };
+    for (size_t i = 0; i < rect_buffer->curr_len; i++) {
+        vec2 min, max;
+        rect_buffer_bounds(rect_buffer, i, &min, &max);
+        ui_damage_add(
+            tracker, min, max, rect_buffer_hash(rect_buffer, i, 1),
+            rect_buffer->anim_flags[i] != UI_ANIMATION_NONE
+        );
+    }
 }
 
-Tex_Coords tex_coords_sub_vec2(
-    const Tex_Coords tex_coords,
-    const vec2       vec
+void ui_damage_add_layers(
+    UI_Damage_Tracker*      tracker,
+    const Rect_Layer_Cache* cache
 ) {
-    return (Tex_Coords){
-        .bottom_left = vec2_sub_vec2(tex_coords.bottom_left, vec),
-        .bottom_right = vec2_sub_vec2(tex_coords.bottom_right, vec),
-        .top_left = vec2_sub_vec2(tex_coords.top_left, vec),
-        .top_right = vec2_sub_vec2(tex_coords.top_right, vec),
-    };
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        const Rect_Layer* layer = &cache->layers[i];
+        if (!layer->is_used) continue;
+        ui_damage_add(
+            tracker, layer->bounds_min, layer->bounds_max,
+            layer->hash ^ layer->id, layer->is_animated
+        );
+    }
 }
 
-Tex_Coords tex_coords_map_to_quad(
-    const Tex_Coords tex_coords,
-    const Tex_Quad*  quad
+void ui_damage_add_tilemaps(
+    UI_Damage_Tracker*   tracker,
+    const Tilemap_Frame* frame
 ) {
-    const vec2 scale = vec2_sub_vec2(quad->max, quad->min);
-    return tex_coords_add_vec2(
-        tex_coords_mul_vec2(tex_coords, scale), quad->min
-    );
+    for (i32 i = 0; i < frame->num_draws; i++) {
+        const Tilemap_Draw* draw  = &frame->draws[i];
+        const i32           types = draw->num_tile_types;
+        u64                 hash  = 0xcbf29ce484222325ULL;
+        hash = ui_damage_hash_bytes(hash, &draw->id, sizeof(draw->id));
+        hash = ui_damage_hash_bytes(hash, &draw->size, sizeof(draw->size));
+        hash = ui_damage_hash_bytes(
+            hash, &draw->view_min, sizeof(draw->view_min)
+        );
+        hash = ui_damage_hash_bytes(
+            hash, &draw->view_size, sizeof(draw->view_size)
+        );
+        hash = ui_damage_hash_bytes(
+            hash, &draw->sort_order, sizeof(draw->sort_order)
+        );
+        hash = ui_damage_hash_bytes(
+            hash, &draw->texture_id, sizeof(draw->texture_id)
+        );
+        hash = ui_damage_hash_bytes(
+            hash, draw->tex_coords, sizeof(draw->tex_coords[0]) * types
+        );
+        hash = ui_damage_hash_bytes(
+            hash, draw->colors, sizeof(draw->colors[0]) * types
+        );
+        hash = ui_damage_hash_bytes(
+            hash, draw->pulse_colors, sizeof(draw->pulse_colors[0]) * types
+        );
+        hash = ui_damage_hash_bytes(
+            hash, draw->wobble, sizeof(draw->wobble[0]) * types
+        );
+        //changed tiles, or tile types animated in tilemap_shader_frag
+        bool is_dirty = draw->has_texels;
+        for (i32 type = 0; type < types; type++) {
+            if (draw->colors[type].w > 0.f) is_dirty = true;
+        }
+        const vec2 min = vec2_sub_float(draw->screen_min, 1.f);
+        const vec2 max = vec2_add_float(
+            vec2_add_vec2(draw->screen_min, draw->screen_size), 1.f
+        );
+        ui_damage_add(tracker, min, max, hash, is_dirty);
+    }
 }
 
-/* RECT RENDERING *************************************************************/
-/*
-    Instead of the previous 'single-buffer-partial-update-only-on-change'
-    caching approach we're aiming for an immediate mode approach this time.
- */
-typedef struct {
-    vec2  pos;
-    vec2  size;
-    vec3  color;
-    float sort_order;
-    //the vertices of the rect will be aligned relative to the pivot
-    //value range 0-1, where 0 = left/bottom, 1 = right/top, {0.5,0.5} = center
-    vec2       pivot;
-    i32        texture_id;
-    Tex_Coords tex_coords;
-} Rect;
-
-typedef struct {
-    Rect   rects[RECT_BUFFER_CAPACITY];
-    size_t curr_len;
-} Rect_Buffer;
-
-void add_rect_to_buffer(Rect_Buffer* rect_buffer, const Rect rect) {
-    SDL_assert(rect_buffer->curr_len + 1 < RECT_BUFFER_CAPACITY);
-    rect_buffer->rects[rect_buffer->curr_len] = rect;
-    rect_buffer->curr_len += 1;
+bool ui_damage_rects_touch(const UI_Damage_Rect a, const UI_Damage_Rect b) {
+    return a.min.x <= b.max.x && b.min.x <= a.max.x &&
+        a.min.y <= b.max.y && b.min.y <= a.max.y;
 }
 
-void add_rect_to_buffer_quadmap(
-    Rect_Buffer*    rect_buffer,
-    Rect            rect,
-    const Tex_Quad* quad
+UI_Damage_Rect ui_damage_rect_union(
+    const UI_Damage_Rect a,
+    const UI_Damage_Rect b
 ) {
-    SDL_assert(quad != NULL);
-    rect.tex_coords = tex_coords_map_to_quad(rect.tex_coords, quad);
-    add_rect_to_buffer(rect_buffer, rect);
+    return (UI_Damage_Rect){
+        .min = {SDL_min(a.min.x, b.min.x), SDL_min(a.min.y, b.min.y)},
+        .max = {SDL_max(a.max.x, b.max.x), SDL_max(a.max.y, b.max.y)},
+    };
 }
 
-void reset_rect_buffer(Rect_Buffer* rect_buffer) {
-    rect_buffer->curr_len = 0;
+i64 ui_damage_rect_area(const UI_Damage_Rect rect) {
+    return (i64)(rect.max.x - rect.min.x) * (i64)(rect.max.y - rect.min.y);
 }
 
-typedef struct {
-    vec2  pos;
-    vec3  color;
-    vec2  tex_coord;
-    float sort_order; //Value Range SORT_ORDER_MIN - SORT_ORDER_MAX
-    i32   texture_id;
-} Rect_Vertex;
-
-typedef struct {
-    Rect_Vertex vertices[RECT_VERTEX_BUFFER_CAPACITY];
-    size_t      curr_len;
-} Rect_Vertex_Buffer;
-
-void build_rect_vertex_buffer(
-    const Rect_Buffer*  rect_buffer,
-    Rect_Vertex_Buffer* vertex_buffer
-) {
-    size_t vertex_index     = 0;
-    vertex_buffer->curr_len = 0;
-    if (rect_buffer->curr_len == 0) return;
-    for (size_t rect_index = 0; rect_index < rect_buffer->curr_len; rect_index
-         ++) {
-        Rect        rect   = rect_buffer->rects[rect_index];
-        Rect_Vertex vertex = (Rect_Vertex){
-            .color = rect.color,
-            .sort_order = rect.sort_order,
-            .texture_id = rect.texture_id,
-        };
-        const vec2 pivot_offset = vec2_mul_vec2(rect.pivot, rect.size);
-
-#define MAKE_CORNER_VERTEX(corner, sub_x, sub_y)                               \
-        vertex.pos = vec2_sub_vec2(                                            \
-            vec2_add_vec2(                                                     \
-                rect.pos, (vec2){sub_x * rect.size.x, sub_y * rect.size.y}     \
-            ), pivot_offset);                                                  \
-        vertex.tex_coord = rect.tex_coords.corner;                             \
-        const Rect_Vertex corner = vertex;
-        MAKE_CORNER_VERTEX(bottom_left, 0, 0)
-        MAKE_CORNER_VERTEX(bottom_right, 1, 0)
-        MAKE_CORNER_VERTEX(top_left, 0, 1)
-        MAKE_CORNER_VERTEX(top_right, 1, 1)
-#undef MAKE_CORNER_VERTEX
-        vertex_buffer->vertices[vertex_index + 0] = bottom_left;
-        vertex_buffer->vertices[vertex_index + 1] = bottom_right;
-        vertex_buffer->vertices[vertex_index + 2] = top_right;
-        vertex_buffer->vertices[vertex_index + 3] = top_right;
-        vertex_buffer->vertices[vertex_index + 4] = top_left;
-        vertex_buffer->vertices[vertex_index + 5] = bottom_left;
-        vertex_index += 6;
-    }
-    SDL_assert(vertex_index <= RECT_VERTEX_BUFFER_CAPACITY);
-    vertex_buffer->curr_len = vertex_index;
-}
-
-//This assumes shader and texture(s) are already bound.
-void draw_rects(
-    const Rect_Vertex_Buffer* vertex_buffer,
-    const Renderer*           renderer
-) {
-    if (vertex_buffer->curr_len == 0) return;
-    renderer_bind(renderer);
-    glBufferSubData(
-        GL_ARRAY_BUFFER,
-        0,
-        (GLsizeiptr)(sizeof(Rect_Vertex) * vertex_buffer->curr_len),
-        &vertex_buffer->vertices[0]
-    );
-    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertex_buffer->curr_len);
+//Merges rect into the first rect it touches or appends it. Without space left
+//it goes into the rect whose area grows the least.
+void ui_damage_push(UI_Damage* damage, const UI_Damage_Rect rect) {
+    i32 best        = -1;
+    i64 best_growth = 0;
+    for (i32 i = 0; i < damage->num_rects; i++) {
+        const UI_Damage_Rect merged = ui_damage_rect_union(
+            damage->rects[i], rect
+        );
+        if (ui_damage_rects_touch(damage->rects[i], rect)) {
+            damage->rects[i] = merged;
+            return;
+        }
+        const i64 growth = ui_damage_rect_area(merged) -
+            ui_damage_rect_area(damage->rects[i]);
+        if (best < 0 || growth < best_growth) {
+            best        = i;
+            best_growth = growth;
+        }
+    }
+    if (damage->num_rects < UI_DAMAGE_MAX_RECTS) {
+        damage->rects[damage->num_rects++] = rect;
+        return;
+    }
+    damage->rects[best] = ui_damage_rect_union(damage->rects[best], rect);
+}
+
+//Compares the frame with the previous one, the frame becomes the previous one
+void ui_damage_end_frame(UI_Damage_Tracker* tracker, UI_Damage* damage) {
+    *damage = (UI_Damage){.is_full = !tracker->has_frame};
+    if (!damage->is_full) {
+        const i32   tile_size = UI_DAMAGE_TILE_SIZE;
+        const ivec2 size      = tracker->frame_buffer_size;
+        for (i32 y = 0; y < tracker->num_tiles.y; y++) {
+            for (i32 x = 0; x < tracker->num_tiles.x; x++) {
+                const size_t tile = (size_t)y * (size_t)tracker->num_tiles.x +
+                    (size_t)x;
+                if (!tracker->is_dirty[tile] &&
+                    tracker->next_hashes[tile] == tracker->hashes[tile]) {
+                    continue;
+                }
+                ui_damage_push(
+                    damage, (UI_Damage_Rect){
+                        .min = {x * tile_size, y * tile_size},
+                        .max = {
+                            SDL_min((x + 1) * tile_size, size.x),
+                            SDL_min((y + 1) * tile_size, size.y),
+                        },
+                    }
+                );
+            }
+        }
+        //rects that grew into each other
+        bool has_merged = true;
+        while (has_merged) {
+            has_merged = false;
+            for (i32 i = 0; i < damage->num_rects; i++) {
+                for (i32 j = i + 1; j < damage->num_rects; j++) {
+                    UI_Damage_Rect* a = &damage->rects[i];
+                    UI_Damage_Rect* b = &damage->rects[j];
+                    if (!ui_damage_rects_touch(*a, *b)) continue;
+                    *a = ui_damage_rect_union(*a, *b);
+                    *b = damage->rects[--damage->num_rects];
+                    has_merged = true;
+                    j--; //b is another rect now
+                }
+            }
+        }
+        i64 area = 0;
+        for (i32 i = 0; i < damage->num_rects; i++) {
+            area += ui_damage_rect_area(damage->rects[i]);
+        }
+        damage->ratio = (float)area / ((float)size.x * (float)size.y);
+        damage->is_full = damage->ratio > UI_DAMAGE_MAX_RATIO;
+    }
+    if (damage->is_full) {
+        damage->num_rects = 0;
+        damage->ratio     = 1.f;
+    }
+
+    u64* hashes          = tracker->hashes;
+    tracker->hashes      = tracker->next_hashes;
+    tracker->next_hashes = hashes;
+    tracker->has_frame   = true;
 }
 
 /* TEXT RENDERING *************************************************************/
@@ -1232,27 +5500,32 @@ float get_text_width(const char* text, const Font* font, const float scale) {
     return width * scale;
 }
 
-void render_text(
+//outline is the width as a fraction of FONT_SDF_PADDING, sdf fonts only
+void render_text_glyphs(
     const String text,
     const Font*  font,
     const vec2   pos,
     const vec3   color,
     const float  scale,
     const float  sort_order,
-    Rect_Buffer* rect_buffer
+    Rect_Buffer* rect_buffer,
+    const float  outline,
+    const vec3   outline_color
 ) {
-    float      x              = 0, y = 0;
-    size_t     glyph_iterator = 0;
-    const vec2 adjusted_pos   = pos;
+    float      x            = 0, y = 0;
+    const vec2 adjusted_pos = pos;
     //TODO: precalculate the text bounds and add vh centering functionality!
 
     SDL_assert(font->texture_type == FONT_TEXTURE_TYPE_ARRAY);
+    rect_buffer_reserve(rect_buffer, rect_buffer->curr_len + text.length);
 
     Rect rect = (Rect){
         .color = color,
         .pivot = {0.0f, 0.0f},
         .sort_order = sort_order,
         .texture_id = font->texture_union.texture_id,
+        .outline = outline,
+        .outline_color = outline_color,
     };
 
     for (size_t i = 0; i < text.length; i++) {
@@ -1299,19 +5572,28 @@ void render_text(
         rect.tex_coords.top_left     = (vec2){quad.s0, 1.0f - quad.t0};
         rect.tex_coords.top_right    = (vec2){quad.s1, 1.0f - quad.t0};
 
-        SDL_assert(
-            rect_buffer->curr_len + glyph_iterator <
-            RECT_BUFFER_CAPACITY
-        );
-        rect_buffer->rects[rect_buffer->curr_len + glyph_iterator] = rect;
-        glyph_iterator += 1;
+        add_rect_to_buffer(rect_buffer, rect);
     }
+}
 
-    rect_buffer->curr_len += glyph_iterator;
+void render_text(
+    const String text,
+    const Font*  font,
+    const vec2   pos,
+    const vec3   color,
+    const float  scale,
+    const float  sort_order,
+    Rect_Buffer* rect_buffer
+) {
+    render_text_glyphs(
+        text, font, pos, color, scale, sort_order, rect_buffer, 0.f, color
+    );
 }
 
-//NOTE: This is highly ineffcient - it duplicates the glyphs 4 times, introducing
-//overdraw and vertex redundancy. A shader based solution would be better.
+//outline_offset is in screen pixels. Sdf fonts draw the outline in the same
+//glyph rects (up to FONT_SDF_PADDING texels wide), bitmap fonts fall back to
+//duplicating the glyphs 4 times - with the overdraw and vertex redundancy
+//that comes with it.
 void render_text_outlined(
     const String text,
     const Font*  font,
@@ -1323,6 +5605,18 @@ void render_text_outlined(
     const float  outline_offset,
     const vec3   outline_color
 ) {
+    if (font->is_sdf) {
+        //one glyph texel covers scale screen pixels
+        const float outline = SDL_clamp(
+            outline_offset / (scale * FONT_SDF_PADDING), 0.f, 1.f
+        );
+        render_text_glyphs(
+            text, font, pos, color, scale, sort_order, rect_buffer, outline,
+            outline_color
+        );
+        return;
+    }
+
     render_text(text, font, pos, color, scale, sort_order, rect_buffer);
     sort_order -= 0.1f;
 
@@ -1353,6 +5647,8 @@ typedef struct {
     i32*     id_ptr;
 } Nine_Slice;
 
+//A single rect, rect_shader_frag keeps the border at border_size pixels and
+//stretches the center
 void render_nine_slice(
     Rect_Buffer*      rect_buffer,
     const vec2        pos, // centered (equivalent to pivot = 0.5, 0.5)
@@ -1362,125 +5658,28 @@ void render_nine_slice(
     const Nine_Slice* nine_slice,
     bool              render_center
 ) {
-    const vec2 half_size   = vec2_mul_float(size, .5f);
-    const vec2 border_size = (vec2){
-        nine_slice->border_size,
-        nine_slice->border_size
-    };
-    const float bs_normalized = nine_slice->border_size / nine_slice->
-        total_size;
-
-    Rect rect = (Rect){
-        .color = color,
-        .size = border_size,
-        .sort_order = sort_order,
-        .texture_id = nine_slice->texture_id,
-    };
     //TODO: assert for size < border_size
-
-    //bottom left
-    rect.pivot      = (vec2){0.f, 0.f};
-    rect.pos        = vec2_sub_vec2(pos, half_size);
-    rect.tex_coords = tex_coords_mul_float(
-        default_tex_coords(),
-        bs_normalized
-    );
-    add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-
-    //bottom right
-    rect.pos        = vec2_add_vec2(rect.pos, (vec2){size.x, 0});
-    rect.pivot      = (vec2){1.f, 0.f};
-    rect.tex_coords = tex_coords_add_vec2(
-        rect.tex_coords,
-        (vec2){1.f - bs_normalized, 0.f}
-    );
-    add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-
-    //top right
-    rect.pos        = vec2_add_vec2(rect.pos, (vec2){0, size.y});
-    rect.pivot      = (vec2){1.f, 1.f};
-    rect.tex_coords = tex_coords_add_vec2(
-        rect.tex_coords,
-        (vec2){0.f, 1.f - bs_normalized}
-    );
-    add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-
-    //top left
-    rect.pos        = vec2_sub_vec2(rect.pos, (vec2){size.x, 0.f});
-    rect.pivot      = (vec2){0.f, 1.f};
-    rect.tex_coords = tex_coords_sub_vec2(
-        rect.tex_coords,
-        (vec2){1.f - bs_normalized, 0.f}
-    );
-    add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-
-    //bottom
-    rect.pos   = vec2_sub_vec2(pos, (vec2){0, half_size.y});
-    rect.pivot = (vec2){.5f, 0.f};
-    rect.size  = (vec2){
-        size.x - nine_slice->border_size * 2.f,
-        nine_slice->border_size,
-    };
-    rect.tex_coords = (Tex_Coords){
-        .bottom_left = (vec2){bs_normalized, 0.f},
-        .bottom_right = (vec2){1.f - bs_normalized, 0.f},
-        .top_left = (vec2){bs_normalized, bs_normalized},
-        .top_right = (vec2){1.f - bs_normalized, bs_normalized},
-    };
-    add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-
-    //top
-    rect.pos        = vec2_add_vec2(pos, (vec2){0, half_size.y});
-    rect.pivot      = (vec2){.5f, 1.f};
-    rect.tex_coords = tex_coords_add_vec2(
-        rect.tex_coords, (vec2){
-            0.f, 1.f - bs_normalized,
-        }
-    );
-    add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-
-    //left
-    rect.pos   = vec2_sub_vec2(pos, (vec2){half_size.x, 0.f});
-    rect.pivot = (vec2){0.f, 0.5f};
-    rect.size  = (vec2){
-        nine_slice->border_size,
-        size.y - nine_slice->border_size * 2.f,
-    };
-    rect.tex_coords = (Tex_Coords){
-        .bottom_left = (vec2){0.f, bs_normalized},
-        .bottom_right = (vec2){bs_normalized, bs_normalized},
-        .top_left = (vec2){0.f, 1.f - bs_normalized},
-        .top_right = (vec2){bs_normalized, 1.f - bs_normalized},
-    };
-    add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-
-    //right
-    rect.pos        = vec2_add_vec2(pos, (vec2){half_size.x, 0.f});
-    rect.pivot      = (vec2){1.f, 0.5f};
-    rect.tex_coords = tex_coords_add_vec2(
-        rect.tex_coords, (vec2){
-            1.f - bs_normalized, 0.f
-        }
-    );
-    add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-
-    //center
-    if (render_center) {
-        rect.pos        = pos;
-        rect.size       = vec2_sub_float(size, nine_slice->border_size * 2.f);
-        rect.pivot      = (vec2){.5f, .5f};
-        rect.tex_coords = (Tex_Coords){
-            .bottom_left = {bs_normalized, bs_normalized},
-            .bottom_right = {1.f - bs_normalized, bs_normalized},
-            .top_left = {bs_normalized, 1.f - bs_normalized},
-            .top_right = {1.f - bs_normalized, 1.f - bs_normalized},
-        };
-        add_rect_to_buffer_quadmap(rect_buffer, rect, &nine_slice->quad);
-    }
+    const float border = nine_slice->border_size;
+    add_rect_to_buffer_quadmap(
+        rect_buffer, (Rect){
+            .pos = pos,
+            .size = size,
+            .pivot = {.5f, .5f},
+            .color = color,
+            .sort_order = sort_order,
+            .texture_id = nine_slice->texture_id,
+            .tex_coords = default_tex_coords(),
+            .slice = {
+                render_center ? border : -border,
+                border / nine_slice->total_size,
+            },
+        }, &nine_slice->quad
+    );
 }
 
 /* TEXTURE RESOURCE ***********************************************************/
-/*For simplicity, we pack ALL things texture into a single gl texture array.
+/*For simplicity, we pack ALL things texture into a few gl texture arrays, one
+per layer size (see TEXTURE ARRAY SET).
 To handle the different types of textures like atlantes, fonts and normal images
 we use the opaque concept of Texture_Resources.
 */
@@ -1546,10 +5745,11 @@ Texture_Resource texture_resource_atlas(
 
 /* RESOURCES ******************************************************************/
 typedef struct {
-    Texture_Resource* textures;
-    i32               num_textures;
-    Nine_Slice*       nine_slices;
-    i32               num_nine_slices;
+    Texture_Resource*    textures;
+    i32                  num_textures;
+    Texture_Array_Layout texture_layout;
+    Nine_Slice*          nine_slices;
+    i32                  num_nine_slices;
 } Resources;
 
 void resources_cleanup(const Resources* resources) {
@@ -1569,6 +5769,19 @@ void resources_cleanup(const Resources* resources) {
     CRLF_free(resources->nine_slices);
 }
 
+//One bit per texture id that holds a distance field font
+u32 resources_sdf_layer_mask(const Resources* resources) {
+    SDL_assert(resources->num_textures <= 32);
+    u32 mask = 0;
+    for (int i = 0; i < resources->num_textures; i++) {
+        if (resources->textures[i].type == TEXTURE_TYPE_FONT &&
+            resources->textures[i].data.font.is_sdf) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
 /* MOUSE **********************************************************************/
 typedef struct {
     float pos_x, pos_y;
@@ -1682,6 +5895,8 @@ u32 ui_element_get_id(const UI_Element* element) {
         return element->config.text.id;
     case UI_ELEMENT_TYPE_IMAGE:
         return element->config.image.id;
+    case UI_ELEMENT_TYPE_TILEMAP:
+        return element->config.tilemap.id;
     }
 }
 
@@ -1777,6 +5992,12 @@ void ui_context_print(const size_t index, const i32 depth) {
     case UI_ELEMENT_TYPE_IMAGE:
         printf("IMAGE: %d\n", elem->config.image.texture.id);
         break;
+    case UI_ELEMENT_TYPE_TILEMAP:
+        printf(
+            "TILEMAP: %d x %d\n", elem->config.tilemap.size.x,
+            elem->config.tilemap.size.y
+        );
+        break;
     default: SDL_assert(0);
     }
 }
@@ -1889,6 +6110,9 @@ void ui_context_pos_size_pass(
     /* IMAGE ******************************************************************/
     case UI_ELEMENT_TYPE_IMAGE:
         break;
+    /* TILEMAP ****************************************************************/
+    case UI_ELEMENT_TYPE_TILEMAP:
+        break;
     }
 }
 
@@ -1934,67 +6158,316 @@ void ui_context_input_pass_recursion(
             };
             ui_context_input_pass_element_hover_check(box, element);
         }
-
+
+        for (size_t i = 0; i < element->child_count; i++) {
+            ui_context_input_pass_recursion(element->first_child_index + i);
+        }
+        break;
+
+    /* TEXT *******************************************************************/
+    case UI_ELEMENT_TYPE_TEXT:
+        //no interactions with text atm
+        break;
+    /* IMAGE ******************************************************************/
+    case UI_ELEMENT_TYPE_IMAGE:
+        if (element->config.image.blocks_cursor) {
+            const vec2 min = VEC2(
+                element->_screen_pos.x - element->_screen_size.x * element->
+                config.image.pivot.x,
+                element->_screen_pos.y - element->_screen_size.y * element->
+                config.image.pivot.y
+            );
+            const UI_Box box = (UI_Box){
+                .min = min,
+                .max = VEC2(
+                    min.x + element->_screen_size.x,
+                    min.y + element->_screen_size.y
+                )
+            };
+            ui_context_input_pass_element_hover_check(box, element);
+        }
+        break;
+    /* TILEMAP ****************************************************************/
+    case UI_ELEMENT_TYPE_TILEMAP:
+        //no interactions with tilemaps atm
+        break;
+    }
+}
+
+//Identifies interactions (hovered element, scroll etc)
+void ui_context_input_pass() {
+    const bool was_start_touch = ui_ctx->input.is_start_touch;
+    const u32  temp_down_id    = ui_ctx->input.down_id;
+    ui_ctx->input              = (UI_Context_Input){0};
+    ui_ctx->input.down_id      = temp_down_id;
+
+    ui_context_input_pass_recursion(0);
+
+    ui_ctx->input.hover_id = 0;
+    if (ui_ctx->input.is_hovering) {
+        ui_ctx->input.hover_id = ui_element_get_id_by_index(
+            ui_ctx->input.hover_element_index
+        );
+        if (was_start_touch) {
+            ui_ctx->input.down_id = ui_ctx->input.hover_id;
+            SDL_Log("TOUCH ID: %u", ui_ctx->input.down_id);
+        }
+    }
+}
+
+/* UI OCCLUSION ***************************************************************/
+/*  Opaque containers hide whatever lies completely behind them. Before the rect
+    pass, ui_occlusion_build collects the visible containers with an opaque
+    center as occluders - inset by the slice border, as the corners may be cut
+    out. The rect pass then skips elements and whole subtrees whose bounds are
+    covered by a single occluder with a higher sort order.
+    Text has no exact bounds before its glyphs are laid out, so subtrees with
+    text are never skipped as a whole - their rects are tested one by one once
+    emitted. The depth test already rejects the covered fragments, the savings
+    are the instance build, sort, upload and vertex work.
+*/
+#define UI_MAX_OCCLUDERS 32
+
+typedef struct {
+    UI_Box box;
+    float  sort_order;
+} UI_Occluder;
+
+typedef struct {
+    size_t num_rects;    //rects not emitted or removed again
+    size_t num_subtrees; //elements skipped together with their children
+    double num_pixels;   //area of the skipped rects, overlaps count twice
+} UI_Occlusion_Stats;
+
+typedef struct {
+    UI_Occluder        occluders[UI_MAX_OCCLUDERS];
+    i32                num_occluders;
+    //per element, covering the element and all of its descendants
+    UI_Box             subtree_bounds[UI_MAX_ELEMENTS];
+    float              subtree_sort_order[UI_MAX_ELEMENTS]; //the highest one
+    size_t             subtree_rects[UI_MAX_ELEMENTS];
+    double             subtree_pixels[UI_MAX_ELEMENTS];
+    bool               is_subtree_bounded[UI_MAX_ELEMENTS]; //false with text
+    UI_Occlusion_Stats stats;
+} UI_Occlusion;
+
+UI_Box ui_box_centered(const vec2 center, const vec2 size) {
+    const vec2 half = {SDL_fabsf(size.x) * .5f, SDL_fabsf(size.y) * .5f};
+    return (UI_Box){
+        .min = {center.x - half.x, center.y - half.y},
+        .max = {center.x + half.x, center.y + half.y},
+    };
+}
+
+UI_Box ui_box_union(const UI_Box a, const UI_Box b) {
+    return (UI_Box){
+        .min = {SDL_min(a.min.x, b.min.x), SDL_min(a.min.y, b.min.y)},
+        .max = {SDL_max(a.max.x, b.max.x), SDL_max(a.max.y, b.max.y)},
+    };
+}
+
+float ui_box_area(const UI_Box box) {
+    return (box.max.x - box.min.x) * (box.max.y - box.min.y);
+}
+
+//Parents come first, so once the occluders are used up the big panels are in
+void ui_occlusion_add_occluder(
+    UI_Occlusion* occlusion,
+    const UI_Box  box,
+    const float   sort_order
+) {
+    if (box.min.x >= box.max.x || box.min.y >= box.max.y) return;
+    if (occlusion->num_occluders == UI_MAX_OCCLUDERS) return;
+    occlusion->occluders[occlusion->num_occluders++] = (UI_Occluder){
+        .box = box,
+        .sort_order = sort_order,
+    };
+}
+
+bool ui_occlusion_is_hidden(
+    const UI_Occlusion* occlusion,
+    const UI_Box        box,
+    const float         sort_order
+) {
+    for (i32 i = 0; i < occlusion->num_occluders; i++) {
+        const UI_Occluder* occluder = &occlusion->occluders[i];
+        if (occluder->sort_order > sort_order &&
+            box.min.x >= occluder->box.min.x &&
+            box.min.y >= occluder->box.min.y &&
+            box.max.x <= occluder->box.max.x &&
+            box.max.y <= occluder->box.max.y) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Mirrors the sort orders and rects of ui_context_rect_render_pass
+void ui_occlusion_build_recursion(
+    UI_Occlusion*    occlusion,
+    const Resources* resources,
+    const size_t     index,
+    const float      sort_order_override
+) {
+    if (index >= ui_ctx->elem_count) return;
+    const UI_Element* element    = &ui_ctx->elements[index];
+    const float       sort_order = CRLF_SORT_ORDER_CLAMPED(
+        sort_order_override != 0 ? sort_order_override + (float)element->depth :
+        (float)element->depth
+    );
+    UI_Box bounds = ui_box_centered(
+        element->_screen_pos, element->_screen_size
+    );
+    float  max_sort_order = sort_order;
+    size_t num_rects      = 0;
+    double num_pixels     = 0.0;
+    bool   is_bounded     = true;
+    switch (element->type) {
+    default: SDL_assert(0);
+        break;
+    case UI_ELEMENT_TYPE_CONTAINER: {
+        const UI_Container_Config* container = &element->config.container;
+        max_sort_order = CRLF_SORT_ORDER_CLAMPED(
+            sort_order + container->sort_order_override
+        );
+        if (!container->is_hidden) {
+            num_rects  = 1;
+            num_pixels = ui_box_area(bounds);
+            if (!container->is_slice_center_hidden) {
+                const float border = resources->nine_slices[
+                    container->nine_slice_id].border_size;
+                ui_occlusion_add_occluder(
+                    occlusion, (UI_Box){
+                        .min = {bounds.min.x + border, bounds.min.y + border},
+                        .max = {bounds.max.x - border, bounds.max.y - border},
+                    }, max_sort_order
+                );
+            }
+        }
         for (size_t i = 0; i < element->child_count; i++) {
-            ui_context_input_pass_recursion(element->first_child_index + i);
+            const size_t child = element->first_child_index + i;
+            ui_occlusion_build_recursion(
+                occlusion, resources, child,
+                sort_order_override + container->sort_order_override
+            );
+            if (child >= ui_ctx->elem_count) continue;
+            bounds = ui_box_union(bounds, occlusion->subtree_bounds[child]);
+            max_sort_order = SDL_max(
+                max_sort_order, occlusion->subtree_sort_order[child]
+            );
+            num_rects += occlusion->subtree_rects[child];
+            num_pixels += occlusion->subtree_pixels[child];
+            is_bounded = is_bounded && occlusion->is_subtree_bounded[child];
         }
         break;
-
-    /* TEXT *******************************************************************/
+    }
     case UI_ELEMENT_TYPE_TEXT:
-        //no interactions with text atm
+        is_bounded = false;
         break;
-    /* IMAGE ******************************************************************/
-    case UI_ELEMENT_TYPE_IMAGE:
-        if (element->config.image.blocks_cursor) {
-            const vec2 min = VEC2(
-                element->_screen_pos.x - element->_screen_size.x * element->
-                config.image.pivot.x,
-                element->_screen_pos.y - element->_screen_size.y * element->
-                config.image.pivot.y
+    case UI_ELEMENT_TYPE_IMAGE: {
+        const UI_Image_Config* image = &element->config.image;
+        const vec2 center = {
+            element->_screen_pos.x +
+            (.5f - image->pivot.x) * element->_screen_size.x,
+            element->_screen_pos.y +
+            (.5f - image->pivot.y) * element->_screen_size.y,
+        };
+        bounds = ui_box_centered(center, element->_screen_size);
+        if (image->animation.flags & UI_ANIMATION_WOBBLE) {
+            const vec2 amplitude = vec2_mul_float(
+                image->animation.amplitude, ui_ctx->square.scale_fac
             );
-            const UI_Box box = (UI_Box){
-                .min = min,
-                .max = VEC2(
-                    min.x + element->_screen_size.x,
-                    min.y + element->_screen_size.y
-                )
-            };
-            ui_context_input_pass_element_hover_check(box, element);
+            bounds.min.x -= SDL_fabsf(amplitude.x);
+            bounds.min.y -= SDL_fabsf(amplitude.y);
+            bounds.max.x += SDL_fabsf(amplitude.x);
+            bounds.max.y += SDL_fabsf(amplitude.y);
         }
+        num_rects  = 1;
+        num_pixels = ui_box_area(bounds);
+        break;
+    }
+    case UI_ELEMENT_TYPE_TILEMAP:
+        //counted as a rect, the tilemap quad is drawn by the tilemap renderer
+        num_rects  = 1;
+        num_pixels = ui_box_area(bounds);
         break;
     }
+    occlusion->subtree_bounds[index]     = bounds;
+    occlusion->subtree_sort_order[index] = max_sort_order;
+    occlusion->subtree_rects[index]      = num_rects;
+    occlusion->subtree_pixels[index]     = num_pixels;
+    occlusion->is_subtree_bounded[index] = is_bounded;
 }
 
-//Identifies interactions (hovered element, scroll etc)
-void ui_context_input_pass() {
-    const bool was_start_touch = ui_ctx->input.is_start_touch;
-    const u32  temp_down_id    = ui_ctx->input.down_id;
-    ui_ctx->input              = (UI_Context_Input){0};
-    ui_ctx->input.down_id      = temp_down_id;
+//Collects the occluders and subtree bounds of the laid out ui tree
+void ui_occlusion_build(UI_Occlusion* occlusion, const Resources* resources) {
+    occlusion->num_occluders = 0;
+    occlusion->stats         = (UI_Occlusion_Stats){0};
+    ui_occlusion_build_recursion(occlusion, resources, 0, 0);
+}
 
-    ui_context_input_pass_recursion(0);
+//Skips the element with its subtree if it is completely covered
+bool ui_occlusion_skip_subtree(UI_Occlusion* occlusion, const size_t index) {
+    if (!occlusion->is_subtree_bounded[index]) return false;
+    if (!ui_occlusion_is_hidden(
+        occlusion, occlusion->subtree_bounds[index],
+        occlusion->subtree_sort_order[index]
+    ))
+        return false;
+    occlusion->stats.num_rects += occlusion->subtree_rects[index];
+    occlusion->stats.num_subtrees++;
+    occlusion->stats.num_pixels += occlusion->subtree_pixels[index];
+    return true;
+}
 
-    ui_ctx->input.hover_id = 0;
-    if (ui_ctx->input.is_hovering) {
-        ui_ctx->input.hover_id = ui_element_get_id_by_index(
-            ui_ctx->input.hover_element_index
-        );
-        if (was_start_touch) {
-            ui_ctx->input.down_id = ui_ctx->input.hover_id;
-            SDL_Log("TOUCH ID: %u", ui_ctx->input.down_id);
+//Removes the covered rects of [first, curr_len), keeping the order of the rest
+void ui_occlusion_cull_rects(
+    UI_Occlusion* occlusion,
+    Rect_Buffer*  rect_buffer,
+    const size_t  first
+) {
+    SDL_assert(first <= rect_buffer->curr_len);
+    if (occlusion->num_occluders == 0) return;
+    Rect_Buffer* rb       = rect_buffer;
+    size_t       num_kept = first;
+    for (size_t i = first; i < rb->curr_len; i++) {
+        const vec2 size   = {rb->size_x[i], rb->size_y[i]};
+        const vec2 center = {
+            rb->pos_x[i] + (.5f - rb->pivot_x[i]) * size.x,
+            rb->pos_y[i] + (.5f - rb->pivot_y[i]) * size.y,
+        };
+        const UI_Box box = ui_box_centered(center, size);
+        //wobbling rects are only ever skipped with their element
+        const bool is_hidden = (rb->anim_flags[i] & UI_ANIMATION_WOBBLE) == 0 &&
+            ui_occlusion_is_hidden(occlusion, box, rb->sort_order[i]);
+        if (is_hidden) {
+            occlusion->stats.num_rects++;
+            occlusion->stats.num_pixels += ui_box_area(box);
+            continue;
         }
+
+        if (num_kept != i) {
+#define RECT_BUFFER_FIELD(type, name) rb->name[num_kept] = rb->name[i];
+            RECT_BUFFER_FIELDS(RECT_BUFFER_FIELD)
+#undef RECT_BUFFER_FIELD
+        }
+        num_kept++;
     }
+    rb->curr_len = num_kept;
 }
 
 //Adds the UI layout to the rect buffer
 void ui_context_rect_render_pass(
-    Rect_Buffer* rect_buffer,
-    Resources*   resources,
-    const size_t index,
-    const float  sort_order_override
+    Rect_Buffer*      rect_buffer,
+    Rect_Layer_Cache* layer_cache,
+    Tilemap_Cache*    tilemap_cache,
+    UI_Occlusion*     occlusion,
+    Resources*        resources,
+    const size_t      index,
+    const float       sort_order_override
 ) {
     if (index >= ui_ctx->elem_count) return;
+    if (ui_occlusion_skip_subtree(occlusion, index)) return;
     UI_Element* element    = &ui_ctx->elements[index];
     const float sort_order = CRLF_SORT_ORDER_CLAMPED(
         sort_order_override != 0 ? sort_order_override + (float)element->depth :
@@ -2004,7 +6477,8 @@ void ui_context_rect_render_pass(
     default: SDL_assert(0);
         break;
     /* CONTAINER **************************************************************/
-    case UI_ELEMENT_TYPE_CONTAINER:
+    case UI_ELEMENT_TYPE_CONTAINER: {
+        const size_t first_rect = rect_buffer->curr_len;
         if (!element->config.container.is_hidden) {
             render_nine_slice(
                 rect_buffer,
@@ -2018,19 +6492,29 @@ void ui_context_rect_render_pass(
                                                  nine_slice_id],
                 !element->config.container.is_slice_center_hidden
             );
+            ui_occlusion_cull_rects(occlusion, rect_buffer, first_rect);
         }
         for (size_t i = 0; i < element->child_count; i++) {
             ui_context_rect_render_pass(
-                rect_buffer, resources, element->first_child_index + i,
+                rect_buffer, layer_cache, tilemap_cache, occlusion, resources,
+                element->first_child_index + i,
                 sort_order_override + element->config.container.
                                                sort_order_override
             );
         }
+        if (element->config.container.is_cached) {
+            rect_layer_cache_submit(
+                layer_cache, element->config.container.id, rect_buffer,
+                first_rect, &resources->texture_layout
+            );
+        }
         break;
+    }
 
     /* TEXT *******************************************************************/
     case UI_ELEMENT_TYPE_TEXT: {
-        const UI_Text_Dimension* txt = &element->config.text._dimension;
+        const UI_Text_Dimension* txt        = &element->config.text._dimension;
+        const size_t             first_rect = rect_buffer->curr_len;
 #if defined(UI_DEBUG_TEXT_BOTTOM_LEFT)
         render_nine_slice(
             rect_buffer, pos_converted,VEC2_ZERO, element->config.text.color,
@@ -2089,6 +6573,7 @@ void ui_context_rect_render_pass(
                 sort_order + .1f, rect_buffer
             );
         }
+        ui_occlusion_cull_rects(occlusion, rect_buffer, first_rect);
         break;
     }
     /* IMAGE ******************************************************************/
@@ -2121,6 +6606,11 @@ void ui_context_rect_render_pass(
             break;
         }
 
+        UI_Animation animation = element->config.image.animation;
+        animation.amplitude    = vec2_mul_float(
+            animation.amplitude, ui_ctx->square.scale_fac
+        );
+
         add_rect_to_buffer(
             rect_buffer, (Rect){
                 .pos = element->_screen_pos,
@@ -2130,10 +6620,22 @@ void ui_context_rect_render_pass(
                 .sort_order = sort_order,
                 .texture_id = element->config.image.texture.id,
                 .tex_coords = tex_coords,
+                .transparency = element->config.image.transparency,
+                .animation = animation,
             }
         );
         break;
     }
+    /* TILEMAP ****************************************************************/
+    case UI_ELEMENT_TYPE_TILEMAP: {
+        const UI_Tilemap_Config* tilemap = &element->config.tilemap;
+        tilemap_cache_submit(
+            tilemap_cache, tilemap,
+            &resources->textures[tilemap->texture_id].data.atlas,
+            element->_screen_pos, element->_screen_size, sort_order
+        );
+        break;
+    }
     }
 }
 
@@ -2364,7 +6866,895 @@ void log_error(const char* fmt, ...) {
     va_end(args);
 }
 
+/* FRAME PACKET ***************************************************************/
+/*  Everything app_submit_frame needs to draw a frame, filled by
+    app_build_frame. With CRLF_USE_RENDER_THREAD the packets rotate between the
+    main thread, which builds the next frame, and the render thread, which owns
+    the gl context and draws the previous one. A packet is only written again
+    once the render thread handed it back, so neither side has to lock.
+*/
+#if defined(CRLF_USE_RENDER_THREAD)
+#define FRAME_PACKET_COUNT 2
+#else
+#define FRAME_PACKET_COUNT 1
+#endif
+
+typedef struct {
+    Rect_Instance_Buffer instances; //sorted, opaque ones first
+    size_t               num_opaque;
+    Rect_Layer_Frame     layers;
+    Tilemap_Frame        tilemaps;
+    ivec2                window_size;
+    float                ui_render_scale;
+#if defined(CRLF_USE_GAMEVIEWPORT)
+    float                game_render_scale;
+#endif
+    mat4                 projection;
+    u32                  sdf_layers;
+    float                time;
+    bool                 quit; //stops the render thread
+    Rect_Cull_Stats      cull_stats;
+    UI_Occlusion_Stats   occlusion_stats;
+#if defined(CRLF_USE_UI_DAMAGE)
+    UI_Damage ui_damage;
+#endif
+    i32                  num_layer_hits;
+    i32                  num_layer_rebuilds;
+#if defined(CRLF_USE_FRAME_CAPTURE)
+    Frame_Capture_Request capture_request;
+#endif
+#if defined(__DEBUG__)
+    bool   cycle_stream_mode; //switch to the next rect upload strategy
+    double avg_build_ms;
+    bool   is_resolution_automatic;
+    float  resolution_frame_ms; //smoothed, as seen by the resolution scaler
+#endif
+} Frame_Packet;
+
+void frame_packet_init(Frame_Packet* packet) {
+    *packet = (Frame_Packet){0};
+    rect_instance_buffer_init(
+        &packet->instances, RECT_BUFFER_INITIAL_CAPACITY
+    );
+    rect_layer_frame_init(&packet->layers);
+}
+
+void frame_packet_cleanup(Frame_Packet* packet) {
+    rect_instance_buffer_cleanup(&packet->instances);
+    rect_layer_frame_cleanup(&packet->layers);
+    tilemap_frame_cleanup(&packet->tilemaps);
+}
+
+#if defined(CRLF_USE_RENDER_THREAD)
+typedef struct {
+    SDL_Thread*    thread;
+    SDL_Semaphore* free;  //packets the main thread may build
+    SDL_Semaphore* ready; //packets the render thread may draw
+    i32            write_index;
+    i32            read_index;
+} Render_Thread;
+#endif
+
+/* SOFTWARE RENDERER **********************************************************/
+/*  Headless cpu rasterizer for benchmarks and golden images on machines
+    without gpu or display (see --headless in SDL_AppInit). It draws the same
+    frame packets as app_submit_frame and follows the gl path: nearest
+    sampling, alpha clip, depth by sort order, sdf text and blended translucent
+    rects. Tilemaps are drawn without their animation.
+    The target is split into tiles that get rasterized in parallel, every tile
+    only walks the rects binned to it. Depth tests and texel lookups of a span
+    are done CRLF_SIMD_LANES pixels at a time, fully occluded groups are
+    skipped - the opaque rects arrive front to back, so most of them are.
+*/
+#define SOFT_TILE_SIZE 64
+#define SOFT_MAX_WORKERS 7
+//below any sort order, so the first rect always passes the depth test
+#define SOFT_DEPTH_CLEAR (CRLF_SORT_ORDER_MIN - 1.f)
+
+//Textures keep their own size, the soft renderer has no use for the arrays
+typedef struct {
+    i32 width, height;
+    u8* texels; //rgba, rgb linearized like sampling the srgb gl texture does
+} Soft_Texture;
+
+typedef struct {
+    Soft_Texture* textures; //indexed by texture id
+    i32           num_textures;
+} Soft_Texture_Set;
+
+Soft_Texture_Set soft_texture_set_generate(
+    Raw_Texture** textures,
+    const i32     num_textures,
+    const bool    gamma_correction
+) {
+    u8 to_linear[256];
+    for (i32 i = 0; i < 256; i++) {
+        const float c = (float)i / 255.f;
+        const float linear = !gamma_correction ? c :
+            c <= 0.04045f ? c / 12.92f : SDL_powf((c + 0.055f) / 1.055f, 2.4f);
+        to_linear[i] = (u8)SDL_floorf(linear * 255.f + .5f);
+    }
+
+    Soft_Texture_Set set = {
+        .textures = CRLF_malloc(sizeof(Soft_Texture) * (size_t)num_textures),
+        .num_textures = num_textures,
+    };
+    SDL_assert(set.textures != NULL);
+    for (i32 i = 0; i < num_textures; i++) {
+        SDL_assert(textures[i]->channels == 4);
+        const size_t size = (size_t)textures[i]->width *
+            (size_t)textures[i]->height * 4;
+        Soft_Texture* texture = &set.textures[i];
+        *texture = (Soft_Texture){
+            .width = textures[i]->width,
+            .height = textures[i]->height,
+            .texels = CRLF_malloc(size),
+        };
+        SDL_assert(texture->texels != NULL);
+        const u8* src = textures[i]->data;
+        for (size_t j = 0; j < size; j += 4) {
+            texture->texels[j + 0] = to_linear[src[j + 0]];
+            texture->texels[j + 1] = to_linear[src[j + 1]];
+            texture->texels[j + 2] = to_linear[src[j + 2]];
+            texture->texels[j + 3] = src[j + 3];
+        }
+    }
+    return set;
+}
+
+void soft_texture_set_free(Soft_Texture_Set* set) {
+    for (i32 i = 0; i < set->num_textures; i++) {
+        CRLF_free(set->textures[i].texels);
+    }
+    CRLF_free(set->textures);
+    *set = (Soft_Texture_Set){0};
+}
+
+typedef enum {
+    SOFT_RECT_OPAQUE,
+    SOFT_RECT_TRANSLUCENT,
+    SOFT_RECT_TILEMAP,
+} Soft_Rect_Type;
+
+//A rect instance (or tilemap) decoded for rasterization
+typedef struct {
+    Soft_Rect_Type type;
+    i32            x0, y0, x1, y1; //covered pixels [x0, x1) x [y0, y1)
+    vec2           min;
+    vec2           size;
+    vec4           tex_coords; //bottom_left.xy, top_right.xy
+    vec4           color;
+    vec4           outline; //rgb, width
+    vec2           slice;   //see Rect
+    float          sort_order;
+    i32            layer; //texture id, draw index for SOFT_RECT_TILEMAP
+} Soft_Rect;
+
+//Pixels whose center lies inside the rect, like the gl rasterization rules
+void soft_rect_set_bounds(Soft_Rect* rect, const i32 width, const i32 height) {
+    rect->x0 = SDL_clamp((i32)SDL_ceilf(rect->min.x - .5f), 0, width);
+    rect->y0 = SDL_clamp((i32)SDL_ceilf(rect->min.y - .5f), 0, height);
+    rect->x1 = SDL_clamp(
+        (i32)SDL_ceilf(rect->min.x + rect->size.x - .5f), 0, width
+    );
+    rect->y1 = SDL_clamp(
+        (i32)SDL_ceilf(rect->min.y + rect->size.y - .5f), 0, height
+    );
+}
+
+//Decodes an instance, animations are applied like in rect_shader_vert
+Soft_Rect soft_rect_from_instance(
+    const Rect_Instance* instance,
+    const Soft_Rect_Type type,
+    const float          time
+) {
+#if defined(CRLF_USE_PACKED_RECT_INSTANCES)
+    const float unorm8  = 1.f / 255.f;
+    const float unorm16 = 1.f / 65535.f;
+    Soft_Rect   rect    = {
+        .type = type,
+        .min = {(float)instance->pos[0], (float)instance->pos[1]},
+        .size = {(float)instance->size[0], (float)instance->size[1]},
+        .tex_coords = {
+            (float)instance->tex_coords[0] * unorm16,
+            (float)instance->tex_coords[1] * unorm16,
+            (float)instance->tex_coords[2] * unorm16,
+            (float)instance->tex_coords[3] * unorm16,
+        },
+        .color = {
+            (float)instance->color[0] * unorm8,
+            (float)instance->color[1] * unorm8,
+            (float)instance->color[2] * unorm8,
+            (float)instance->color[3] * unorm8,
+        },
+        .outline = {
+            (float)instance->outline[0] * unorm8,
+            (float)instance->outline[1] * unorm8,
+            (float)instance->outline[2] * unorm8,
+            (float)instance->outline[3] * unorm8,
+        },
+        .slice = {
+            (float)instance->slice[0], (float)instance->slice[1] / 32767.f
+        },
+        .sort_order = CRLF_SORT_ORDER_MIN + (float)instance->sort_order *
+        unorm16 * (CRLF_SORT_ORDER_MAX - CRLF_SORT_ORDER_MIN),
+        .layer = instance->texture_id,
+    };
+    const u32  flags     = instance->animation_flags;
+    const vec4 animation = {
+        (float)instance->animation[0] / 16.f,
+        (float)instance->animation[1] / 16.f,
+        (float)instance->animation[2] / 16.f,
+        (float)instance->animation[3] / 16.f,
+    };
+    const float frequency   = (float)instance->animation[4] / 256.f;
+    const vec3  pulse_color = {
+        (float)instance->pulse_color[0] * unorm8,
+        (float)instance->pulse_color[1] * unorm8,
+        (float)instance->pulse_color[2] * unorm8,
+    };
+#else
+    Soft_Rect rect = {
+        .type = type,
+        .min = {
+            instance->pos.x - instance->pivot.x * instance->size.x,
+            instance->pos.y - instance->pivot.y * instance->size.y,
+        },
+        .size = instance->size,
+        .tex_coords = {
+            instance->tex_bottom_left.x, instance->tex_bottom_left.y,
+            instance->tex_top_right.x, instance->tex_top_right.y,
+        },
+        .color = instance->color,
+        .outline = instance->outline,
+        .slice = instance->slice,
+        .sort_order = instance->sort_order,
+        .layer = instance->texture_id,
+    };
+    const u32   flags       = (u32)instance->animation_flags;
+    const vec4  animation   = instance->animation;
+    const float frequency   = instance->frequency;
+    const vec3  pulse_color = instance->pulse_color;
+#endif
+    if (flags & UI_ANIMATION_WOBBLE) {
+        rect.min.x += SDL_sinf((time + animation.x) * frequency) * animation.z;
+        rect.min.y += SDL_sinf((time + animation.y) * frequency * .75f) *
+            animation.w;
+    }
+    if (flags & UI_ANIMATION_PULSE) {
+        const float t = (SDL_sinf(time + animation.x) + 1.f) * .5f;
+        rect.color.x += (pulse_color.x - rect.color.x) * t;
+        rect.color.y += (pulse_color.y - rect.color.y) * t;
+        rect.color.z += (pulse_color.z - rect.color.z) * t;
+    }
+    return rect;
+}
+
+typedef struct {
+    u32   id; //tilemap id of the texels
+    ivec2 size;
+    u8*   texels;
+} Soft_Tilemap;
+
+typedef struct Soft_Renderer Soft_Renderer;
+
+typedef struct {
+    Soft_Renderer* renderer;
+    SDL_Thread*    thread;
+    SDL_Semaphore* start;
+} Soft_Worker;
+
+struct Soft_Renderer {
+    i32                  width, height;
+    u8*                  color; //rgba, bottom row first like gl
+    float*               depth; //sort order of the closest rect
+    Soft_Texture_Set     textures;
+    Rect_Instance_Buffer layers[RECT_LAYER_CACHE_MAX_LAYERS];
+    Soft_Tilemap         tilemaps[TILEMAP_MAX_TEXTURES];
+
+    //the current frame, rects in draw order and binned per tile
+    const Frame_Packet* packet;
+    Soft_Rect*          rects;
+    size_t              num_rects, rects_capacity;
+    u32*                bins; //rect indices, tile after tile
+    size_t              bins_capacity;
+    u32*                bin_first; //per tile, plus one past the last
+    i32                 num_tiles_x, num_tiles_y;
+    SDL_AtomicInt       next_tile;
+
+    Soft_Worker    workers[SOFT_MAX_WORKERS];
+    i32            num_workers;
+    SDL_Semaphore* done;
+    SDL_AtomicInt  quit;
+};
+
+void soft_renderer_draw_tilemap(
+    const Soft_Renderer* renderer,
+    const Soft_Rect*     rect,
+    const i32            x0,
+    const i32            y0,
+    const i32            x1,
+    const i32            y1
+) {
+    const Tilemap_Draw* draw = &renderer->packet->tilemaps.draws[rect->layer];
+    const Soft_Tilemap* map  = &renderer->tilemaps[draw->slot];
+    const Soft_Texture* texture =
+        &renderer->textures.textures[draw->texture_id];
+    const vec2 map_per_pixel = {
+        draw->view_size.x / draw->screen_size.x,
+        draw->view_size.y / draw->screen_size.y,
+    };
+
+    for (i32 y = y0; y < y1; y++) {
+        const float map_y = draw->view_min.y +
+            ((float)y + .5f - draw->screen_min.y) * map_per_pixel.y;
+        const i32 tile_y = (i32)SDL_floorf(map_y);
+        if (tile_y < 0 || tile_y >= map->size.y) continue;
+        float* depth_row = &renderer->depth[(size_t)y * renderer->width];
+        u8*    color_row = &renderer->color[(size_t)y * renderer->width * 4];
+        for (i32 x = x0; x < x1; x++) {
+            if (rect->sort_order <= depth_row[x]) continue;
+            const float map_x = draw->view_min.x +
+                ((float)x + .5f - draw->screen_min.x) * map_per_pixel.x;
+            const i32 tile_x = (i32)SDL_floorf(map_x);
+            if (tile_x < 0 || tile_x >= map->size.x) continue;
+            const i32 type = map->texels[
+                (size_t)tile_y * (size_t)map->size.x + tile_x];
+            if (type >= draw->num_tile_types) continue;
+
+            const vec4  cell = draw->tex_coords[type];
+            const float u    = cell.x +
+                (map_x - (float)tile_x) * (cell.z - cell.x);
+            const float v = cell.y +
+                (map_y - (float)tile_y) * (cell.w - cell.y);
+            const i32   tx   = SDL_clamp(
+                (i32)SDL_floorf(u * (float)texture->width), 0,
+                texture->width - 1
+            );
+            const i32 ty = SDL_clamp(
+                (i32)SDL_floorf((1.f - v) * (float)texture->height), 0,
+                texture->height - 1
+            );
+            const u8* texel =
+                &texture->texels[((size_t)ty * texture->width + tx) * 4];
+            if (texel[3] < 128) continue;
+            const vec4 color = draw->colors[type];
+            u8*        dst   = &color_row[(size_t)x * 4];
+            dst[0]       = (u8)((float)texel[0] * color.x + .5f);
+            dst[1]       = (u8)((float)texel[1] * color.y + .5f);
+            dst[2]       = (u8)((float)texel[2] * color.z + .5f);
+            dst[3]       = 255;
+            depth_row[x] = rect->sort_order;
+        }
+    }
+}
+
+//Bilinear distance in texels, positive inside - see sampleDistance
+float soft_sample_distance(
+    const Soft_Texture* texture,
+    const float         u,
+    const float         v
+) {
+    const float px = u * (float)texture->width - .5f;
+    const float py = v * (float)texture->height - .5f;
+    const float fx = px - SDL_floorf(px);
+    const float fy = py - SDL_floorf(py);
+    const i32   x0 = SDL_clamp((i32)SDL_floorf(px), 0, texture->width - 1);
+    const i32   y0 = SDL_clamp((i32)SDL_floorf(py), 0, texture->height - 1);
+    const i32   x1 = SDL_min(x0 + 1, texture->width - 1);
+    const i32   y1 = SDL_min(y0 + 1, texture->height - 1);
+#define SOFT_ALPHA(x, y)                                                       \
+    (float)texture->texels[((size_t)(y) * texture->width + (x)) * 4 + 3]
+    const float a0 = SOFT_ALPHA(x0, y0) +
+        (SOFT_ALPHA(x1, y0) - SOFT_ALPHA(x0, y0)) * fx;
+    const float a1 = SOFT_ALPHA(x0, y1) +
+        (SOFT_ALPHA(x1, y1) - SOFT_ALPHA(x0, y1)) * fx;
+#undef SOFT_ALPHA
+    const float a = a0 + (a1 - a0) * fy;
+    return (a - (float)FONT_SDF_ON_EDGE) / (float)FONT_SDF_ON_EDGE *
+        FONT_SDF_PADDING;
+}
+
+//0-1 along one axis of a nine slice, see sliceAxis in rect_shader_frag
+float soft_slice_axis(
+    const float pos,
+    const float size,
+    const float border,
+    const float fraction
+) {
+    if (pos < border) return pos / border * fraction;
+    if (pos > size - border) return 1.f - (size - pos) / border * fraction;
+    return fraction + (pos - border) / SDL_max(size - 2.f * border, 0.0001f) *
+        (1.f - 2.f * fraction);
+}
+
+//Writes one shaded pixel: depth tested and written for opaque rects, blended
+//without depth write for translucent ones
+static inline void soft_write_pixel(
+    const Soft_Rect* rect,
+    u8*              dst,
+    float*           depth,
+    float            r,
+    float            g,
+    float            b
+) {
+    //clamped like the gl path does when writing to the unorm target, the
+    //float conversions below are undefined for out of range values
+    r             = SDL_clamp(r, 0.f, 1.f);
+    g             = SDL_clamp(g, 0.f, 1.f);
+    b             = SDL_clamp(b, 0.f, 1.f);
+    const float a = SDL_clamp(rect->color.w, 0.f, 1.f);
+    if (rect->type == SOFT_RECT_TRANSLUCENT) {
+        const float inv = 1.f - a;
+        dst[0] = (u8)(r * 255.f * a + (float)dst[0] * inv + .5f);
+        dst[1] = (u8)(g * 255.f * a + (float)dst[1] * inv + .5f);
+        dst[2] = (u8)(b * 255.f * a + (float)dst[2] * inv + .5f);
+        dst[3] = (u8)(a * 255.f + (float)dst[3] * inv + .5f);
+        return;
+    }
+    dst[0] = (u8)(r * 255.f + .5f);
+    dst[1] = (u8)(g * 255.f + .5f);
+    dst[2] = (u8)(b * 255.f + .5f);
+    dst[3] = (u8)(a * 255.f + .5f);
+    *depth = rect->sort_order;
+}
+
+void soft_renderer_draw_rect(
+    const Soft_Renderer* renderer,
+    const Soft_Rect*     rect,
+    const i32            x0,
+    const i32            y0,
+    const i32            x1,
+    const i32            y1
+) {
+    const Soft_Texture* texture = &renderer->textures.textures[rect->layer];
+    const bool is_sdf = (renderer->packet->sdf_layers >> rect->layer) & 1u;
+    const bool  is_slice     = rect->slice.x != 0.f;
+    const float slice_border = SDL_fabsf(rect->slice.x);
+    //texel columns advance linearly, they get computed a group at a time
+    const bool  is_linear_u  = !is_sdf && !is_slice;
+    const float du = (rect->tex_coords.z - rect->tex_coords.x) / rect->size.x;
+    const float dv = (rect->tex_coords.w - rect->tex_coords.y) / rect->size.y;
+    //u at the center of pixel x0 and its step per pixel, in texels
+    const float u0 = (rect->tex_coords.x +
+        ((float)x0 + .5f - rect->min.x) * du) * (float)texture->width;
+    const float du_texels = du * (float)texture->width;
+    //screen pixels per texel - stands in for fwidth of the distance
+    const float sdf_pixel = SDL_max(
+        SDL_max(SDL_fabsf(du_texels), SDL_fabsf(dv * (float)texture->height)),
+        0.0001f
+    );
+#if defined(CRLF_SIMD_LANES)
+    static const float lane_offsets[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    const Simd_F32     lanes           = simd_load_f32(lane_offsets);
+    const Simd_F32     sort_order      = simd_set1_f32(rect->sort_order);
+#endif
+
+    for (i32 y = y0; y < y1; y++) {
+        const float local_y = (float)y + .5f - rect->min.y;
+        float       slice_v = local_y / rect->size.y;
+        if (is_slice) {
+            slice_v = soft_slice_axis(
+                local_y, rect->size.y, slice_border, rect->slice.y
+            );
+        }
+        const bool is_center_row = local_y >= slice_border &&
+            local_y <= rect->size.y - slice_border;
+        //the textures are uploaded upside down, see rect_shader_frag
+        const float v = 1.f - (rect->tex_coords.y +
+            slice_v * (rect->tex_coords.w - rect->tex_coords.y));
+        i32 ty = (i32)SDL_floorf(v * (float)texture->height) % texture->height;
+        if (ty < 0) ty += texture->height;
+        const u8* texel_row =
+            &texture->texels[(size_t)ty * texture->width * 4];
+        float*    depth_row = &renderer->depth[(size_t)y * renderer->width];
+        u8*       color_row = &renderer->color[(size_t)y * renderer->width * 4];
+
+        for (i32 x = x0; x < x1;) {
+            //depth test and texel column of a group of pixels
+            i32 group = 1;
+            i32 mask  = rect->sort_order > depth_row[x] ? 1 : 0;
+            i32 texel_x[8];
+#if defined(CRLF_SIMD_LANES)
+            if (x + CRLF_SIMD_LANES <= x1) {
+                group = CRLF_SIMD_LANES;
+                mask  = simd_cmpgt_mask_f32(
+                    sort_order, simd_load_f32(&depth_row[x])
+                );
+                if (mask != 0 && is_linear_u) {
+                    const Simd_F32 rel = simd_add_f32(
+                        simd_set1_f32((float)(x - x0)), lanes
+                    );
+                    simd_store_i32(texel_x, simd_floor_f32(simd_add_f32(
+                        simd_set1_f32(u0),
+                        simd_mul_f32(rel, simd_set1_f32(du_texels))
+                    )));
+                }
+            } else
+#endif
+            if (mask != 0 && is_linear_u) {
+                texel_x[0] = (i32)SDL_floorf(u0 + (float)(x - x0) * du_texels);
+            }
+
+            for (i32 lane = 0; lane < group && mask != 0; lane++) {
+                if (!((mask >> lane) & 1)) continue;
+                const i32 px  = x + lane;
+                u8*       dst = &color_row[(size_t)px * 4];
+                if (is_sdf) {
+                    const float u = rect->tex_coords.x +
+                        ((float)px + .5f - rect->min.x) * du;
+                    const float dist = soft_sample_distance(
+                        texture, u, v
+                    );
+                    const float coverage = SDL_clamp(
+                        (dist + rect->outline.w * FONT_SDF_PADDING) /
+                        sdf_pixel + .5f, 0.f, 1.f
+                    );
+                    if (coverage < .5f) continue;
+                    const float fill = SDL_clamp(
+                        dist / sdf_pixel + .5f, 0.f, 1.f
+                    );
+                    soft_write_pixel(
+                        rect, dst, &depth_row[px],
+                        rect->outline.x + (rect->color.x - rect->outline.x) *
+                        fill,
+                        rect->outline.y + (rect->color.y - rect->outline.y) *
+                        fill,
+                        rect->outline.z + (rect->color.z - rect->outline.z) *
+                        fill
+                    );
+                    continue;
+                }
+                i32 tx = texel_x[lane];
+                if (is_slice) {
+                    const float local_x = (float)px + .5f - rect->min.x;
+                    const bool  is_center = is_center_row &&
+                        local_x >= slice_border &&
+                        local_x <= rect->size.x - slice_border;
+                    if (rect->slice.x < 0.f && is_center) continue; //hollow
+                    const float slice_u = soft_slice_axis(
+                        local_x, rect->size.x, slice_border, rect->slice.y
+                    );
+                    tx = (i32)SDL_floorf((rect->tex_coords.x + slice_u *
+                        (rect->tex_coords.z - rect->tex_coords.x)) *
+                        (float)texture->width);
+                }
+                tx %= texture->width;
+                if (tx < 0) tx += texture->width;
+                const u8* texel = &texel_row[(size_t)tx * 4];
+                if (texel[3] < 128) continue; //alpha clip at .5
+                soft_write_pixel(
+                    rect, dst, &depth_row[px],
+                    (float)texel[0] / 255.f * rect->color.x,
+                    (float)texel[1] / 255.f * rect->color.y,
+                    (float)texel[2] / 255.f * rect->color.z
+                );
+            }
+            x += group;
+        }
+    }
+}
+
+void soft_renderer_draw_tile(const Soft_Renderer* renderer, const i32 tile) {
+    const i32 x0 = (tile % renderer->num_tiles_x) * SOFT_TILE_SIZE;
+    const i32 y0 = (tile / renderer->num_tiles_x) * SOFT_TILE_SIZE;
+    const i32 x1 = SDL_min(x0 + SOFT_TILE_SIZE, renderer->width);
+    const i32 y1 = SDL_min(y0 + SOFT_TILE_SIZE, renderer->height);
+
+    //clear color of viewport_ui
+    for (i32 y = y0; y < y1; y++) {
+        const size_t row = (size_t)y * renderer->width;
+        for (i32 x = x0; x < x1; x++) {
+            renderer->depth[row + x] = SOFT_DEPTH_CLEAR;
+            u8* dst = &renderer->color[(row + x) * 4];
+            dst[0]  = 0;
+            dst[1]  = 0;
+            dst[2]  = 0;
+            dst[3]  = 255;
+        }
+    }
+
+    for (u32 i = renderer->bin_first[tile]; i < renderer->bin_first[tile + 1];
+         i++) {
+        const Soft_Rect* rect = &renderer->rects[renderer->bins[i]];
+        const i32 rx0 = SDL_max(rect->x0, x0);
+        const i32 ry0 = SDL_max(rect->y0, y0);
+        const i32 rx1 = SDL_min(rect->x1, x1);
+        const i32 ry1 = SDL_min(rect->y1, y1);
+        if (rect->type == SOFT_RECT_TILEMAP) {
+            soft_renderer_draw_tilemap(renderer, rect, rx0, ry0, rx1, ry1);
+        } else {
+            soft_renderer_draw_rect(renderer, rect, rx0, ry0, rx1, ry1);
+        }
+    }
+}
+
+//Tiles are handed out one at a time, so uneven tiles balance themselves
+void soft_renderer_draw_tiles(Soft_Renderer* renderer) {
+    const i32 num_tiles = renderer->num_tiles_x * renderer->num_tiles_y;
+    for (;;) {
+        const i32 tile = SDL_AddAtomicInt(&renderer->next_tile, 1);
+        if (tile >= num_tiles) return;
+        soft_renderer_draw_tile(renderer, tile);
+    }
+}
+
+int soft_worker_run(void* data) {
+    Soft_Worker*   worker   = data;
+    Soft_Renderer* renderer = worker->renderer;
+    for (;;) {
+        SDL_WaitSemaphore(worker->start);
+        if (SDL_GetAtomicInt(&renderer->quit)) return 0;
+        soft_renderer_draw_tiles(renderer);
+        SDL_SignalSemaphore(renderer->done);
+    }
+}
+
+//Takes ownership of the textures, the raw textures stay with the caller
+void soft_renderer_init(
+    Soft_Renderer*         renderer,
+    const Soft_Texture_Set textures
+) {
+    *renderer = (Soft_Renderer){
+        .textures = textures,
+        .num_workers = SDL_clamp(
+            SDL_GetNumLogicalCPUCores() - 1, 0, SOFT_MAX_WORKERS
+        ),
+        .done = SDL_CreateSemaphore(0),
+    };
+    SDL_assert(renderer->done != NULL);
+    SDL_SetAtomicInt(&renderer->quit, 0);
+
+    for (i32 i = 0; i < renderer->num_workers; i++) {
+        Soft_Worker* worker = &renderer->workers[i];
+        worker->renderer = renderer;
+        worker->start    = SDL_CreateSemaphore(0);
+        SDL_assert(worker->start != NULL);
+        worker->thread = SDL_CreateThread(
+            soft_worker_run, "soft_raster", worker
+        );
+        if (worker->thread == NULL) {
+            log_warning(
+                "Failed to create raster thread: %s", SDL_GetError()
+            );
+            SDL_DestroySemaphore(worker->start);
+            renderer->num_workers = i;
+            break;
+        }
+    }
+    log_msg("software renderer threads: %d", renderer->num_workers + 1);
+}
+
+void soft_renderer_cleanup(Soft_Renderer* renderer) {
+    SDL_SetAtomicInt(&renderer->quit, 1);
+    for (i32 i = 0; i < renderer->num_workers; i++) {
+        SDL_SignalSemaphore(renderer->workers[i].start);
+    }
+    for (i32 i = 0; i < renderer->num_workers; i++) {
+        SDL_WaitThread(renderer->workers[i].thread, NULL);
+        SDL_DestroySemaphore(renderer->workers[i].start);
+    }
+    SDL_DestroySemaphore(renderer->done);
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        if (renderer->layers[i].instances != NULL)
+            rect_instance_buffer_cleanup(&renderer->layers[i]);
+    }
+    for (i32 i = 0; i < TILEMAP_MAX_TEXTURES; i++) {
+        CRLF_free(renderer->tilemaps[i].texels);
+    }
+    soft_texture_set_free(&renderer->textures);
+    CRLF_free(renderer->color);
+    CRLF_free(renderer->depth);
+    CRLF_free(renderer->rects);
+    CRLF_free(renderer->bins);
+    CRLF_free(renderer->bin_first);
+    *renderer = (Soft_Renderer){0};
+}
+
+void soft_renderer_resize(
+    Soft_Renderer* renderer,
+    const i32      width,
+    const i32      height
+) {
+    if (renderer->width == width && renderer->height == height) return;
+    const size_t num_pixels = (size_t)width * (size_t)height;
+    renderer->width       = width;
+    renderer->height      = height;
+    renderer->num_tiles_x = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    renderer->num_tiles_y = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+    renderer->color = CRLF_realloc(renderer->color, num_pixels * 4);
+    renderer->depth = CRLF_realloc(renderer->depth, num_pixels * sizeof(float));
+    renderer->bin_first = CRLF_realloc(
+        renderer->bin_first, (size_t)(renderer->num_tiles_x *
+            renderer->num_tiles_y + 1) * sizeof(u32)
+    );
+    SDL_assert(renderer->color != NULL && renderer->depth != NULL);
+    SDL_assert(renderer->bin_first != NULL);
+}
+
+void soft_renderer_push_rect(Soft_Renderer* renderer, Soft_Rect rect) {
+    soft_rect_set_bounds(&rect, renderer->width, renderer->height);
+    if (rect.x0 >= rect.x1 || rect.y0 >= rect.y1) return;
+    if (renderer->num_rects == renderer->rects_capacity) {
+        renderer->rects_capacity = SDL_max(renderer->rects_capacity * 2, 1024);
+        renderer->rects          = CRLF_realloc(
+            renderer->rects, renderer->rects_capacity * sizeof(Soft_Rect)
+        );
+        SDL_assert(renderer->rects != NULL);
+    }
+    renderer->rects[renderer->num_rects++] = rect;
+}
+
+void soft_renderer_push_instances(
+    Soft_Renderer*       renderer,
+    const Rect_Instance* instances,
+    const size_t         count,
+    const Soft_Rect_Type type
+) {
+    for (size_t i = 0; i < count; i++) {
+        soft_renderer_push_rect(
+            renderer, soft_rect_from_instance(
+                &instances[i], type, renderer->packet->time
+            )
+        );
+    }
+}
+
+//Keeps copies of the cached layers and tilemaps, like their gl buffers
+void soft_renderer_update_caches(
+    Soft_Renderer*      renderer,
+    const Frame_Packet* packet
+) {
+    const Rect_Layer_Frame* layers = &packet->layers;
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        const u32             bit   = 1u << i;
+        Rect_Instance_Buffer* layer = &renderer->layers[i];
+        if ((layers->release_mask & bit) && layer->instances != NULL) {
+            rect_instance_buffer_cleanup(layer);
+            *layer = (Rect_Instance_Buffer){0};
+        }
+        if (!(layers->upload_mask & bit)) continue;
+        if (layer->instances == NULL) rect_instance_buffer_init(layer, 64);
+        rect_instance_buffer_reserve(layer, layers->counts[i]);
+        SDL_memcpy(
+            layer->instances,
+            &layers->uploads.instances[layers->upload_first[i]],
+            layers->counts[i] * sizeof(Rect_Instance)
+        );
+        layer->curr_len = layers->counts[i];
+    }
+
+    const Tilemap_Frame* tilemaps = &packet->tilemaps;
+    for (i32 i = 0; i < tilemaps->num_draws; i++) {
+        const Tilemap_Draw* draw = &tilemaps->draws[i];
+        if (!draw->has_texels) continue;
+        Soft_Tilemap* map        = &renderer->tilemaps[draw->slot];
+        const size_t  num_texels = (size_t)draw->size.x * (size_t)draw->size.y;
+        map->id     = draw->id;
+        map->size   = draw->size;
+        map->texels = CRLF_realloc(map->texels, num_texels);
+        SDL_assert(map->texels != NULL);
+        SDL_memcpy(
+            map->texels, &tilemaps->texels[draw->texels_first], num_texels
+        );
+    }
+}
+
+//Sorts the rect indices into the tiles they overlap, keeping the draw order
+void soft_renderer_bin_rects(Soft_Renderer* renderer) {
+    const i32 num_tiles = renderer->num_tiles_x * renderer->num_tiles_y;
+    SDL_memset(renderer->bin_first, 0, (size_t)(num_tiles + 1) * sizeof(u32));
+    size_t num_entries = 0;
+    for (size_t i = 0; i < renderer->num_rects; i++) {
+        const Soft_Rect* rect = &renderer->rects[i];
+        for (i32 ty = rect->y0 / SOFT_TILE_SIZE;
+             ty <= (rect->y1 - 1) / SOFT_TILE_SIZE; ty++) {
+            for (i32 tx = rect->x0 / SOFT_TILE_SIZE;
+                 tx <= (rect->x1 - 1) / SOFT_TILE_SIZE; tx++) {
+                renderer->bin_first[ty * renderer->num_tiles_x + tx + 1]++;
+                num_entries++;
+            }
+        }
+    }
+    for (i32 tile = 0; tile < num_tiles; tile++) {
+        renderer->bin_first[tile + 1] += renderer->bin_first[tile];
+    }
+    if (num_entries > renderer->bins_capacity) {
+        renderer->bins_capacity = num_entries;
+        renderer->bins          = CRLF_realloc(
+            renderer->bins, num_entries * sizeof(u32)
+        );
+        SDL_assert(renderer->bins != NULL);
+    }
+
+    //bin_first[tile + 1] doubles as the write cursor of the tile, it ends up
+    //at the start of the next tile
+    for (i32 tile = num_tiles; tile > 0; tile--) {
+        renderer->bin_first[tile] = renderer->bin_first[tile - 1];
+    }
+    for (size_t i = 0; i < renderer->num_rects; i++) {
+        const Soft_Rect* rect = &renderer->rects[i];
+        for (i32 ty = rect->y0 / SOFT_TILE_SIZE;
+             ty <= (rect->y1 - 1) / SOFT_TILE_SIZE; ty++) {
+            for (i32 tx = rect->x0 / SOFT_TILE_SIZE;
+                 tx <= (rect->x1 - 1) / SOFT_TILE_SIZE; tx++) {
+                const i32 tile = ty * renderer->num_tiles_x + tx;
+                renderer->bins[renderer->bin_first[tile + 1]++] = (u32)i;
+            }
+        }
+    }
+}
+
+//Rasterizes the packet into the color buffer, in the order of the gl path
+void soft_renderer_submit(Soft_Renderer* renderer, const Frame_Packet* packet) {
+    const ivec2 size = viewport_frame_buffer_size(
+        packet->window_size, packet->ui_render_scale
+    );
+    soft_renderer_resize(renderer, size.x, size.y);
+    soft_renderer_update_caches(renderer, packet);
+
+    renderer->packet    = packet;
+    renderer->num_rects = 0;
+    const Rect_Instance_Buffer* instances = &packet->instances;
+    soft_renderer_push_instances(
+        renderer, instances->instances, packet->num_opaque, SOFT_RECT_OPAQUE
+    );
+    for (i32 i = 0; i < RECT_LAYER_CACHE_MAX_LAYERS; i++) {
+        if (packet->layers.counts[i] == 0) continue;
+        soft_renderer_push_instances(
+            renderer, renderer->layers[i].instances, packet->layers.counts[i],
+            SOFT_RECT_OPAQUE
+        );
+    }
+    for (i32 i = 0; i < packet->tilemaps.num_draws; i++) {
+        const Tilemap_Draw* draw = &packet->tilemaps.draws[i];
+        soft_renderer_push_rect(renderer, (Soft_Rect){
+            .type = SOFT_RECT_TILEMAP,
+            .min = draw->screen_min,
+            .size = draw->screen_size,
+            .sort_order = draw->sort_order,
+            .layer = i,
+        });
+    }
+    soft_renderer_push_instances(
+        renderer, &instances->instances[packet->num_opaque],
+        instances->curr_len - packet->num_opaque, SOFT_RECT_TRANSLUCENT
+    );
+    soft_renderer_bin_rects(renderer);
+
+    SDL_SetAtomicInt(&renderer->next_tile, 0);
+    for (i32 i = 0; i < renderer->num_workers; i++) {
+        SDL_SignalSemaphore(renderer->workers[i].start);
+    }
+    soft_renderer_draw_tiles(renderer);
+    for (i32 i = 0; i < renderer->num_workers; i++) {
+        SDL_WaitSemaphore(renderer->done);
+    }
+    renderer->packet = NULL;
+}
+
+//Writes the color buffer with the gamma of viewport_shader_frag applied
+bool soft_renderer_save_bmp(const Soft_Renderer* renderer, const char* path) {
+    return save_bmp_linear_rgba(
+        renderer->color, renderer->width, renderer->height, path
+    );
+}
+
 /* APP ************************************************************************/
+//--headless [frames] [output.bmp]: draws with the software renderer instead of
+//gl, ticks once per frame so the output is the same on every run
+#define HEADLESS_DEFAULT_FRAMES 300
+#define HEADLESS_DEFAULT_OUTPUT "headless.bmp"
+
+typedef struct {
+    bool          is_enabled;
+    i32           num_frames;
+    i32           frame;
+    const char*   output_path;
+    u64           draw_ticks; //performance counter ticks spent in app_draw
+    Soft_Renderer soft_renderer;
+} Headless;
+
 typedef struct {
     Window window;
     Game   game;
@@ -2372,26 +7762,63 @@ typedef struct {
     u64    last_tick;
     Path   asset_path;
 
-    Renderer           rect_renderer;
-    Shader_Program     rect_shader;
-    Rect_Buffer        rect_buffer;
-    Rect_Vertex_Buffer rect_vertex_buffer;
+    Rect_Renderer        rect_renderer;
+    Shader_Program       rect_shader;
+    Rect_Buffer          rect_buffer;
+    Rect_Instance_Buffer rect_instance_buffer;
+    Rect_Sort            rect_sort;
+    Rect_Layer_Cache     rect_layer_cache;
+    Rect_Layer_Buffers   rect_layer_buffers;
+    Tilemap_Cache        tilemap_cache;
+    UI_Occlusion         ui_occlusion;
+#if defined(CRLF_USE_UI_DAMAGE)
+    UI_Damage_Tracker ui_damage_tracker;
+#endif
+    Tilemap_Renderer     tilemap_renderer;
+    Frame_Packet         frame_packets[FRAME_PACKET_COUNT];
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+    Rect_Build_Pool rect_build_pool;
+#endif
+#if defined(CRLF_USE_RENDER_THREAD)
+    Render_Thread render_thread;
+#endif
 
 #if defined(CRLF_USE_GAMEVIEWPORT)
     Viewport viewport_game;
 #endif
-    Viewport       viewport_ui;
-    Renderer       viewport_renderer;
-    Shader_Program viewport_shader;
+    Viewport           viewport_ui;
+    Renderer           viewport_renderer;
+    Shader_Program     viewport_shader;
+    Render_Graph       render_graph;
+    Render_Target_Pool render_target_pool;
+#if defined(CRLF_USE_SRGB_BACK_BUFFER)
+    bool has_srgb_back_buffer; //queried by app_init
+#endif
+#if defined(CRLF_USE_UI_DAMAGE)
+    Render_Target* ui_target;          //viewport_ui, kept between frames
+    bool           is_ui_target_valid; //holds the previous frame
+#endif
+#if defined(CRLF_USE_FRAME_CAPTURE)
+    Frame_Capture         frame_capture;   //belongs to the thread drawing
+    Frame_Capture_Request capture_request; //for the next frame packet
+#endif
+    //picks the render scales of the next frames, the viewports follow when
+    //drawing them
+    Resolution_Scaler resolution_scaler;
 
-    GL_Texture_Array  texture_array;
+    Texture_Array_Set texture_arrays;
+    Headless          headless;
     bool              has_focus;
     Game_Resource_IDs res_id;
     Resources         resources;
     i32               num_tex_res;
     CRLF_API          api;
 #if defined(__DEBUG__)
-    Hot_Reload hot_reload;
+    Hot_Reload   hot_reload;
+    Frame_Timing build_timing;
+    Frame_Timing draw_timing;
+    double       avg_build_ms;
+    bool         cycle_stream_mode;
 #endif
 } App;
 
@@ -2407,11 +7834,13 @@ void init_app_ptr(App* app) {
         .viewport_game = default_viewport_game(),
 #endif
         .viewport_ui = default_viewport_ui(),
+        .resolution_scaler = resolution_scaler_create(true),
         .has_focus = false,
         .api = (CRLF_API){
             .log_msg = log_msg,
             .log_error = log_error,
             .log_warning = log_warning,
+            .get_gpu_timings = gpu_timer_get_timings,
         },
 #if defined(__DEBUG__)
         .hot_reload = {0},
@@ -2420,6 +7849,14 @@ void init_app_ptr(App* app) {
 }
 
 static bool app_init(App* app) {
+    const bool is_headless = app->headless.is_enabled;
+    if (!is_headless) {
+        gl_state_invalidate();
+        gpu_timer_init();
+    }
+    //without timer queries there is no frame time to scale by, and the
+    //headless benchmark (which skips the timer) draws every frame at one scale
+    app->resolution_scaler.is_automatic = gpu_timer.is_available;
     const char* base_path = SDL_GetBasePath();
     asset_path_init(base_path, &app->asset_path);
     ui_context_init();
@@ -2453,9 +7890,10 @@ static bool app_init(App* app) {
         num_textures * sizeof(Raw_Texture*)
     );
 
+    i32* array_indices = CRLF_malloc(num_textures * sizeof(i32));
+    bool is_valid      = true;
     for (int i = 0; i < num_textures; i++) {
         Texture_Resource* tex_res = &texture_resources[i];
-        *tex_res->res_id          = i;
         switch (texture_resources[i].type) {
         case TEXTURE_TYPE_DEFAULT:
         case TEXTURE_TYPE_ATLAS:
@@ -2464,26 +7902,81 @@ static bool app_init(App* app) {
             );
             break;
         case TEXTURE_TYPE_FONT:
+            //the texture id gets patched once the ids are handed out
             raw_textures[i] = font_load_for_array(
                 temp_path_append(app->asset_path.str, tex_res->file_name),
                 &tex_res->data.font, tex_res->data.font.size, i
             );
             break;
         }
+        array_indices[i] = raw_textures[i] == NULL ? -1 :
+            texture_array_size_index(
+                raw_textures[i]->width, raw_textures[i]->height
+            );
+        if (array_indices[i] < 0) {
+            log_error("%s fits no texture array size", tex_res->file_name);
+            is_valid = false;
+        }
+    }
+    if (!is_valid) {
+        for (int i = 0; i < num_textures; i++) {
+            if (raw_textures[i] != NULL) raw_texture_free(raw_textures[i]);
+        }
+        CRLF_free(raw_textures);
+        CRLF_free(array_indices);
+        return false;
     }
 
-    app->texture_array = gl_texture_array_generate(
-        &raw_textures[0], num_textures,
-        128, 128, 4, default_texture_config_gammacorrect(), true
+    //hand out the ids array by array, see TEXTURE ARRAY SET
+    Texture_Resource* resources = CRLF_malloc(
+        num_textures * sizeof(Texture_Resource)
     );
-
-    //NOTE: contents of raw_texture are freed via gl_texture_array_generate!
+    Raw_Texture** sorted_raw_textures = CRLF_malloc(
+        num_textures * sizeof(Raw_Texture*)
+    );
+    Texture_Array_Layout layout  = {0};
+    i32                  next_id = 0;
+    for (i32 array = 0; array < TEXTURE_ARRAY_COUNT; array++) {
+        layout.first_texture_id[array] = next_id;
+        for (int i = 0; i < num_textures; i++) {
+            if (array_indices[i] != array) continue;
+            resources[next_id]           = texture_resources[i];
+            sorted_raw_textures[next_id] = raw_textures[i];
+            next_id++;
+        }
+        layout.num_layers[array] = next_id - layout.first_texture_id[array];
+    }
+    for (int i = 0; i < num_textures; i++) {
+        *resources[i].res_id = i;
+        if (resources[i].type == TEXTURE_TYPE_FONT) {
+            resources[i].data.font.texture_union.texture_id = i;
+        }
+    }
     CRLF_free(raw_textures);
+    CRLF_free(array_indices);
+
+    if (is_headless) {
+        soft_renderer_init(
+            &app->headless.soft_renderer, soft_texture_set_generate(
+                sorted_raw_textures, num_textures,
+                default_texture_config_gammacorrect().gamma_correction
+            )
+        );
+        for (int i = 0; i < num_textures; i++) {
+            raw_texture_free(sorted_raw_textures[i]);
+        }
+    } else {
+        app->texture_arrays = texture_array_set_generate(
+            sorted_raw_textures, &layout, default_texture_config_gammacorrect()
+        );
+    }
 
-    app->resources.num_textures = num_textures;
-    const size_t tex_res_size   = num_textures * sizeof(Texture_Resource);
-    app->resources.textures     = CRLF_malloc(tex_res_size);
-    SDL_memcpy(app->resources.textures, &texture_resources[0], tex_res_size);
+    //NOTE: contents of raw_texture are freed via texture_array_set_generate!
+    CRLF_free(sorted_raw_textures);
+
+    app->resources.textures       = resources;
+    app->resources.num_textures   = num_textures;
+    app->resources.texture_layout = layout;
 
     /* NINE SLICE *************************************************************/
     const Nine_Slice nine_slices[] = {
@@ -2513,25 +8006,38 @@ static bool app_init(App* app) {
     SDL_memcpy(app->resources.nine_slices, &nine_slices[0], nine_slices_size);
 
     /* SHADER******************************************************************/
-    app->rect_shader = compile_shader_program(
-        rect_shader_vert, rect_shader_frag
-    );
-    app->viewport_shader = compile_shader_program(
-        viewport_shader_vert, viewport_shader_frag
-    );
+    if (!is_headless) {
+        app->rect_shader = compile_shader_program(
+            rect_shader_vert, rect_shader_frag
+        );
+        app->viewport_shader = compile_shader_program(
+            viewport_shader_vert, viewport_shader_frag
+        );
 
-    viewport_renderer_init(&app->viewport_renderer);
+        viewport_renderer_init(&app->viewport_renderer);
+#if defined(CRLF_USE_SRGB_BACK_BUFFER)
+        app->has_srgb_back_buffer = back_buffer_supports_srgb();
+        if (!app->has_srgb_back_buffer) {
+            log_msg("no srgb back buffer, the ui is always blit with gamma");
+        }
+#endif
 
 #if defined(CRLF_USE_GAMEVIEWPORT)
-    viewport_generate(
-        &app->viewport_game,
-        (ivec2){app->window.width, app->window.height}
-    );
+        viewport_resize(
+            &app->viewport_game,
+            (ivec2){app->window.width, app->window.height}
+        );
 #endif
-    viewport_generate(
-        &app->viewport_ui,
-        (ivec2){app->window.width, app->window.height}
-    );
+        viewport_resize(
+            &app->viewport_ui,
+            (ivec2){app->window.width, app->window.height}
+        );
+#if defined(CRLF_USE_FRAME_CAPTURE)
+        //frames can still be drawn without it
+        if (!frame_capture_init(&app->frame_capture))
+            log_warning("frame capture unavailable");
+#endif
+    }
 
     // Hello Triangle Example:
     // renderer_init(&app->test_renderer);
@@ -2555,38 +8061,23 @@ static bool app_init(App* app) {
     //     (void*)(3 * sizeof(float))
     // );
 
-    renderer_init(&app->rect_renderer);
-    renderer_bind(&app->rect_renderer);
-    const GLsizei rect_vertex_size = sizeof(Rect_Vertex);
-    glBufferData(
-        GL_ARRAY_BUFFER, rect_vertex_size * RECT_VERTEX_BUFFER_CAPACITY,
-        NULL, GL_STATIC_DRAW
-    );
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(
-        0, 2, GL_FLOAT, GL_FALSE, rect_vertex_size,
-        (void*)offsetof(Rect_Vertex, pos)
-    );
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(
-        1, 3, GL_FLOAT, GL_FALSE, rect_vertex_size,
-        (void*)offsetof(Rect_Vertex, color)
-    );
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(
-        2, 2, GL_FLOAT, GL_FALSE, rect_vertex_size,
-        (void*)offsetof(Rect_Vertex, tex_coord)
-    );
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(
-        3, 1, GL_FLOAT, GL_FALSE, rect_vertex_size,
-        (void*)offsetof(Rect_Vertex, sort_order)
-    );
-    glEnableVertexAttribArray(4);
-    glVertexAttribIPointer(
-        4, 1, GL_INT, rect_vertex_size,
-        (void*)offsetof(Rect_Vertex, texture_id)
+    if (!is_headless) {
+        rect_renderer_init(&app->rect_renderer);
+        tilemap_renderer_init(&app->tilemap_renderer);
+    }
+    rect_buffer_init(&app->rect_buffer, RECT_BUFFER_INITIAL_CAPACITY);
+    rect_instance_buffer_init(
+        &app->rect_instance_buffer, RECT_BUFFER_INITIAL_CAPACITY
     );
+    rect_sort_init(&app->rect_sort, RECT_BUFFER_INITIAL_CAPACITY);
+    rect_layer_cache_init(&app->rect_layer_cache);
+    tilemap_cache_init(&app->tilemap_cache);
+    for (i32 i = 0; i < FRAME_PACKET_COUNT; i++) {
+        frame_packet_init(&app->frame_packets[i]);
+    }
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+    rect_build_pool_init(&app->rect_build_pool);
+#endif
 
     // SDL_Log("Game: %d", test_game());
 
@@ -2602,24 +8093,29 @@ static void app_tick(App* app) {
     ui_ctx->time += DELTA_TIME;
 }
 
-static void app_draw(App* app) {
-    /* GAME RENDER PASS *******************************************************/
-#if defined(CRLF_USE_GAMEVIEWPORT)
-    viewport_bind(&app->viewport_game);
-    //E.g. Hello Triangle
-    // glUseProgram(app->test_shader.id);
-    // renderer_bind(&app->test_renderer);
-    // glDrawArrays(GL_TRIANGLES, 0, 3);
+//Runs the ui and fills the packet, does not touch gl
+static void app_build_frame(App* app, Frame_Packet* packet) {
+#if defined(__DEBUG__)
+    frame_timing_begin(&app->build_timing);
 #endif
 
     /* UI *********************************************************************/
+    //the layout below maps the ui square and the cursor into the frame buffer,
+    //which keeps them right at any scale
+    resolution_scaler_update(&app->resolution_scaler);
+    const float ui_render_scale = resolution_scale(
+        &app->resolution_scaler, app->viewport_ui.render_scale_max
+    );
+    const ivec2 window_size       = {app->window.width, app->window.height};
+    const ivec2 frame_buffer_size = viewport_frame_buffer_size(
+        window_size, ui_render_scale
+    );
     const float window_width = (float)app->window.width;
     const float window_height = (float)app->window.height;
-    const float viewport_width = (float)app->viewport_ui.frame_buffer_size.x;
-    const float viewport_height = (float)app->viewport_ui.frame_buffer_size.y;
+    const float viewport_width = (float)frame_buffer_size.x;
+    const float viewport_height = (float)frame_buffer_size.y;
     const int   framebuffer_size_min = SDL_min(
-        app->viewport_ui.frame_buffer_size.x,
-        app->viewport_ui.frame_buffer_size.y
+        frame_buffer_size.x, frame_buffer_size.y
     );
     const float square_size = (float)(framebuffer_size_min - (
         framebuffer_size_min % 2));
@@ -2645,21 +8141,27 @@ static void app_draw(App* app) {
         };
 
 #if defined(CRLF_USE_SQUARE_SCISSOR)
-    glEnable(GL_SCISSOR_TEST);
     const int   viewport_min    = SDL_min(viewport_width, viewport_height);
     const ivec2 viewport_center = (ivec2){
         (int)(viewport_width * 0.5f), (int)(viewport_height * 0.5f)
     };
-    glScissor(
+    const ivec2 scissor_min = (ivec2){
         viewport_center.x - viewport_min / 2,
-        viewport_center.y - viewport_min / 2, viewport_min, viewport_min
-    );
+        viewport_center.y - viewport_min / 2,
+    };
+    //rects outside of the scissor don't get built or drawn at all
+    const vec2 clip_min = ivec2_to_vec2(scissor_min);
+    const vec2 clip_max = (vec2){
+        clip_min.x + (float)viewport_min, clip_min.y + (float)viewport_min
+    };
+#else
+    const vec2 clip_min = VEC2_ZERO;
+    const vec2 clip_max = (vec2){viewport_width, viewport_height};
 #endif
 
-    viewport_bind(&app->viewport_ui);
     reset_rect_buffer(&app->rect_buffer);
 
-    ui_ctx->viewport_size = ivec2_to_vec2(app->viewport_ui.frame_buffer_size);
+    ui_ctx->viewport_size = ivec2_to_vec2(frame_buffer_size);
 
     //TODO: split into game_draw and game_draw_ui (if we will have 3d after the jam)
 #if defined(__DEBUG__)
@@ -2670,77 +8172,630 @@ static void app_draw(App* app) {
 
     ui_tree_reindex_depth_first_to_breadth_first();
     ui_context_pos_size_pass(&app->resources, 0, NULL);
+    //The rect pass does not depend on the input pass (the game reads the
+    //hover state during game_draw), so the instances get built while the
+    //input pass and the sort run.
+    rect_layer_cache_begin_frame(&app->rect_layer_cache);
+    tilemap_cache_begin_frame(&app->tilemap_cache);
+    ui_occlusion_build(&app->ui_occlusion, &app->resources);
+    ui_context_rect_render_pass(
+        &app->rect_buffer, &app->rect_layer_cache, &app->tilemap_cache,
+        &app->ui_occlusion, &app->resources, 0, 0
+    );
+    packet->occlusion_stats = app->ui_occlusion.stats;
+    packet->cull_stats = rect_buffer_cull(
+        &app->rect_buffer, 0, clip_min, clip_max
+    );
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+    rect_build_pool_begin(
+        &app->rect_build_pool, &app->rect_buffer, &app->rect_instance_buffer
+    );
+#endif
     ui_context_input_pass();
-    ui_context_rect_render_pass(&app->rect_buffer, &app->resources, 0, 0);
+    rect_sort_build(
+        &app->rect_sort, &app->rect_buffer, &app->resources.texture_layout
+    );
+#if defined(CRLF_USE_UI_DAMAGE)
+    //the font layers are the only state besides the frame buffer size that
+    //all of the ui depends on
+    const u32 sdf_layers = resources_sdf_layer_mask(&app->resources);
+    ui_damage_begin_frame(
+        &app->ui_damage_tracker, frame_buffer_size,
+        ui_damage_hash_bytes(
+            0xcbf29ce484222325ULL, &sdf_layers, sizeof(sdf_layers)
+        )
+    );
+    ui_damage_add_rects(&app->ui_damage_tracker, &app->rect_buffer);
+    ui_damage_add_layers(&app->ui_damage_tracker, &app->rect_layer_cache);
+    ui_damage_add_tilemaps(&app->ui_damage_tracker, &app->tilemap_cache.frame);
+    ui_damage_end_frame(&app->ui_damage_tracker, &packet->ui_damage);
+#endif
     ui_context_clear();
 
-#if defined(CRLF_USE_SQUARE_SCISSOR)
-    glDisable(GL_SCISSOR_TEST);
+    /* UI BOILERPLATE **********************************************************/
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+    rect_build_pool_join(&app->rect_build_pool);
+#else
+    build_rect_instance_buffer(&app->rect_buffer, &app->rect_instance_buffer);
 #endif
+    rect_sort_apply(
+        &app->rect_sort, &app->rect_instance_buffer, &packet->instances
+    );
+    packet->num_opaque = app->rect_sort.num_opaque;
+    rect_layer_cache_end_frame(&app->rect_layer_cache, &packet->layers);
+    tilemap_cache_end_frame(&app->tilemap_cache, &packet->tilemaps);
 
-    /* UI BOILERPLATE **********************************************************/
-    build_rect_vertex_buffer(&app->rect_buffer, &app->rect_vertex_buffer);
-    glUseProgram(app->rect_shader.id);
-    const mat4 ortho_mat = mat4_ortho(
+    packet->window_size     = window_size;
+    packet->ui_render_scale = ui_render_scale;
+#if defined(CRLF_USE_GAMEVIEWPORT)
+    packet->game_render_scale = resolution_scale(
+        &app->resolution_scaler, app->viewport_game.render_scale_max
+    );
+#endif
+    packet->projection = mat4_ortho(
         0.f, viewport_width, 0.f, viewport_height, CRLF_SORT_ORDER_MIN,
         CRLF_SORT_ORDER_MAX
     );
-    const i32 projection_loc = glGetUniformLocation(
-        app->rect_shader.id, "projection"
+    packet->sdf_layers         = resources_sdf_layer_mask(&app->resources);
+    packet->time               = ui_ctx->time;
+    packet->num_layer_hits     = app->rect_layer_cache.num_hits;
+    packet->num_layer_rebuilds = app->rect_layer_cache.num_rebuilds;
+
+#if defined(CRLF_USE_FRAME_CAPTURE)
+    packet->capture_request = app->capture_request;
+    app->capture_request    = FRAME_CAPTURE_REQUEST_NONE;
+#endif
+#if defined(__DEBUG__)
+    packet->cycle_stream_mode = app->cycle_stream_mode;
+    app->cycle_stream_mode    = false;
+    frame_timing_end(&app->build_timing, &app->avg_build_ms);
+    packet->avg_build_ms = app->avg_build_ms;
+    packet->is_resolution_automatic = app->resolution_scaler.is_automatic;
+    packet->resolution_frame_ms     = app->resolution_scaler.frame_ms;
+#endif
+}
+
+//Follows the window size and the render scales, the frame buffers themselves
+//come from the render target pool
+static void app_update_viewports(App* app, const Frame_Packet* packet) {
+    const ivec2 size = packet->window_size;
+#if defined(CRLF_USE_GAMEVIEWPORT)
+    app->viewport_game.render_scale = packet->game_render_scale;
+    viewport_resize(&app->viewport_game, size);
+#endif
+    app->viewport_ui.render_scale = packet->ui_render_scale;
+    viewport_resize(&app->viewport_ui, size);
+}
+
+#if defined(CRLF_USE_UI_DAMAGE)
+static void app_release_ui_target(App* app) {
+    if (app->ui_target == NULL) return;
+    render_target_pool_release(app->ui_target);
+    app->ui_target          = NULL;
+    app->is_ui_target_valid = false;
+}
+
+//The persistent viewport_ui, stays acquired from the pool across frames. A
+//new size class or format replaces it, its contents are lost then.
+static Render_Target* app_acquire_ui_target(App* app) {
+    const Viewport*            viewport   = &app->viewport_ui;
+    const Render_Target_Format format     = viewport_format(viewport);
+    const ivec2                size_class = render_target_size_class(
+        viewport->frame_buffer_size
     );
+    const Render_Target* target = app->ui_target;
+    if (target != NULL && (target->size.x != size_class.x ||
+                           target->size.y != size_class.y ||
+                           !render_target_format_equals(
+                               target->format, format
+                           ))) {
+        app_release_ui_target(app);
+    }
+    if (app->ui_target == NULL) {
+        app->ui_target = render_target_pool_acquire(
+            &app->render_target_pool, viewport->frame_buffer_size, format
+        );
+    }
+    return app->ui_target;
+}
+#endif
+
+//user_data of the render passes of app_submit_frame
+typedef struct {
+    App*                app;
+    const Frame_Packet* packet;
+} App_Pass_Context;
+
+/* GAME RENDER PASS ***********************************************************/
+#if defined(CRLF_USE_GAMEVIEWPORT)
+static void app_pass_game(
+    void*                 user_data,
+    Render_Target* const* inputs,
+    Render_Target*        output
+) {
+    const App_Pass_Context* ctx = user_data;
+    App*                    app = ctx->app;
+    (void)inputs;
+    gpu_timer_begin(CRLF_GPU_PASS_GAME);
+    app->viewport_game.target = output;
+    viewport_bind(&app->viewport_game);
+    //E.g. Hello Triangle
+    // glUseProgram(app->test_shader.id);
+    // renderer_bind(&app->test_renderer);
+    // glDrawArrays(GL_TRIANGLES, 0, 3);
+    gpu_timer_end();
+}
+#endif
+
+/* UI RENDER PASS *************************************************************/
+//Draws the rects, cached layers and tilemaps into the bound viewport, after
+//they got uploaded by app_pass_ui
+static void app_draw_ui(
+    App*                app,
+    const Frame_Packet* packet,
+    const i32           first_translucent_batch
+) {
+    Shader_Program* rect_shader = &app->rect_shader;
+    gl_state_use_program(rect_shader->id);
     glUniformMatrix4fv(
-        projection_loc, 1, GL_FALSE,
-        (const GLfloat*)(&ortho_mat.matrix[0])
+        shader_uniform_location(rect_shader, "projection"), 1, GL_FALSE,
+        (const GLfloat*)(&packet->projection.matrix[0])
+    );
+    const Texture_Array_Set* texture_arrays = &app->texture_arrays;
+    glUniform1i(shader_uniform_location(rect_shader, "textureArray"), 0);
+    glUniform4iv(
+        shader_uniform_location(rect_shader, "textureArrayFirstIds"), 1,
+        &texture_arrays->layout.first_texture_id[0]
+    );
+    glUniform1f(
+        shader_uniform_location(rect_shader, "alphaClipThreshold"), .5f
     );
-    const i32 texture_array_loc = glGetUniformLocation(
-        app->rect_shader.id, "textureArray"
+    glUniform2f(
+        shader_uniform_location(rect_shader, "sortOrderRange"),
+        CRLF_SORT_ORDER_MIN, CRLF_SORT_ORDER_MAX
     );
-    glUniform1i(texture_array_loc, 0);
-    gl_texture_array_bind(&app->texture_array, 0);
-    const i32 loc_alpha_clip_threshold = glGetUniformLocation(
-        app->rect_shader.id, "alphaClipThreshold"
+    glUniform1ui(
+        shader_uniform_location(rect_shader, "sdfLayers"), packet->sdf_layers
+    );
+    glUniform1f(
+        shader_uniform_location(rect_shader, "sdfPadding"), FONT_SDF_PADDING
+    );
+    glUniform1f(shader_uniform_location(rect_shader, "time"), packet->time);
+    Rect_Renderer* rect_renderer = &app->rect_renderer;
+    draw_rects(rect_renderer, 0, first_translucent_batch, texture_arrays);
+    rect_layer_buffers_draw(
+        &app->rect_layer_buffers, &packet->layers, texture_arrays,
+        rect_renderer
+    );
+    //drawn after the opaque rects so covered pixels fail the depth test early
+    tilemap_renderer_draw(
+        &app->tilemap_renderer, &packet->tilemaps, texture_arrays,
+        &packet->projection, packet->time
+    );
+    gl_state_use_program(rect_shader->id);
+    //translucent rects are depth tested but don't occlude each other
+    gl_state_set_capability(GL_BLEND, true);
+    gl_state_blend_func_separate(
+        GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+    );
+    gl_state_depth_mask(false);
+    draw_rects(
+        rect_renderer, first_translucent_batch,
+        rect_renderer->num_uploaded_batches, texture_arrays
+    );
+    gl_state_depth_mask(true);
+    gl_state_set_capability(GL_BLEND, false);
+}
+
+static void app_pass_ui(
+    void*                 user_data,
+    Render_Target* const* inputs,
+    Render_Target*        output
+) {
+    const App_Pass_Context* ctx    = user_data;
+    App*                    app    = ctx->app;
+    const Frame_Packet*     packet = ctx->packet;
+    (void)inputs;
+    gpu_timer_begin(CRLF_GPU_PASS_UI);
+    //NULL when drawing straight into the back buffer, which has to be cleared
+    //as a whole like app_pass_composite does
+    app->viewport_ui.target = output;
+    const bool to_back_buffer = output == NULL;
+#if defined(CRLF_USE_SRGB_BACK_BUFFER)
+    gl_state_set_capability(GL_FRAMEBUFFER_SRGB, to_back_buffer);
+#else
+    SDL_assert(!to_back_buffer);
+#endif
+    //uploaded once, no matter how often they get drawn below
+    const i32 first_translucent_batch = rect_renderer_upload(
+        &app->rect_renderer, &packet->instances, packet->num_opaque,
+        &app->texture_arrays
     );
-    glUniform1f(loc_alpha_clip_threshold, 0.5f);
-    draw_rects(&app->rect_vertex_buffer, &app->rect_renderer);
+    rect_layer_buffers_upload(&app->rect_layer_buffers, &packet->layers);
+    tilemap_renderer_upload(&app->tilemap_renderer, &packet->tilemaps);
+
+#if defined(CRLF_USE_UI_DAMAGE)
+    //viewport_ui still holds the previous frame, only the damaged rects get
+    //cleared (viewport_bind clears within the scissor) and redrawn
+    const UI_Damage* damage     = &packet->ui_damage;
+    const bool       is_partial = !to_back_buffer &&
+        app->is_ui_target_valid && !damage->is_full;
+    app->is_ui_target_valid = !to_back_buffer;
+    if (is_partial) {
+        gl_state_set_capability(GL_SCISSOR_TEST, true);
+        for (i32 i = 0; i < damage->num_rects; i++) {
+            const UI_Damage_Rect* rect = &damage->rects[i];
+            gl_state_scissor(
+                rect->min.x, rect->min.y, rect->max.x - rect->min.x,
+                rect->max.y - rect->min.y
+            );
+            viewport_bind(&app->viewport_ui);
+            app_draw_ui(app, packet, first_translucent_batch);
+        }
+        gl_state_set_capability(GL_SCISSOR_TEST, false);
+        gpu_timer_end();
+        return;
+    }
+#endif
+    //a pooled target holds whatever its last user drew, so it gets cleared as
+    //a whole. The square is only culled against in app_build_frame.
+    viewport_bind(&app->viewport_ui);
+    app_draw_ui(app, packet, first_translucent_batch);
+#if defined(CRLF_USE_SRGB_BACK_BUFFER)
+    gl_state_set_capability(GL_FRAMEBUFFER_SRGB, false);
+#endif
+    gpu_timer_end();
+}
 
-    /* SCREEN *****************************************************************/
-    viewport_unbind(app->window.width, app->window.height);
+/* COMPOSITE PASS *************************************************************/
+//Draws the viewports to the window, inputs are in the order of the viewports
+static void app_pass_composite(
+    void*                 user_data,
+    Render_Target* const* inputs,
+    Render_Target*        output
+) {
+    const App_Pass_Context* ctx    = user_data;
+    App*                    app    = ctx->app;
+    const Frame_Packet*     packet = ctx->packet;
+    SDL_assert(output == NULL);
+    viewport_unbind(packet->window_size.x, packet->window_size.y);
     glClear(GL_COLOR_BUFFER_BIT);
 
 #if defined(CRLF_USE_GAMEVIEWPORT)
+    SDL_assert(app->viewport_game.target == *inputs++);
+    gpu_timer_begin(CRLF_GPU_PASS_BLIT_GAME);
     viewport_render_to_window(
         &app->viewport_game, &app->viewport_renderer,
         &app->viewport_shader
     );
+    gpu_timer_end();
 #endif
 
+    SDL_assert(app->viewport_ui.target == *inputs);
+    gpu_timer_begin(CRLF_GPU_PASS_BLIT_UI);
     viewport_render_to_window(
         &app->viewport_ui, &app->viewport_renderer,
         &app->viewport_shader
     );
+    gpu_timer_end();
+}
+
+#if defined(CRLF_USE_FRAME_CAPTURE)
+/* CAPTURE PASS ***************************************************************/
+//Reads the viewports back, inputs are the same as for the composite pass
+static void app_pass_capture(
+    void*                 user_data,
+    Render_Target* const* inputs,
+    Render_Target*        output
+) {
+    const App_Pass_Context* ctx     = user_data;
+    App*                    app     = ctx->app;
+    Frame_Capture*          capture = &app->frame_capture;
+    SDL_assert(output == NULL);
+#if defined(CRLF_USE_GAMEVIEWPORT)
+    frame_capture_read_target(
+        capture, *inputs++, app->viewport_game.frame_buffer_size, "game"
+    );
+#endif
+    frame_capture_read_target(
+        capture, *inputs, app->viewport_ui.frame_buffer_size, "ui"
+    );
+    frame_capture_end_frame(capture);
+}
+#endif
+
+//The ui skips viewport_ui and the gamma blit when it is the only viewport, is
+//drawn at the window's size and nothing reads it back. The hardware srgb
+//encoding replaces the pow() of viewport_shader_frag.
+static bool app_ui_to_back_buffer(App* app, const Frame_Packet* packet) {
+#if defined(CRLF_USE_SRGB_BACK_BUFFER) && !defined(CRLF_USE_GAMEVIEWPORT)
+    if (!app->has_srgb_back_buffer) return false;
+    if (packet->ui_render_scale != 1.f) return false;
+#if defined(CRLF_USE_UI_DAMAGE)
+    //a partial redraw needs the previous frame in viewport_ui
+    if (!packet->ui_damage.is_full) return false;
+#endif
+#if defined(CRLF_USE_FRAME_CAPTURE)
+    if (frame_capture_is_active(&app->frame_capture)) return false;
+#endif
+    return true;
+#else
+    (void)app;
+    (void)packet;
+    return false;
+#endif
+}
+
+//Issues all gl calls of a packet, runs on the thread owning the gl context
+static void app_submit_frame(App* app, const Frame_Packet* packet) {
+#if defined(__DEBUG__)
+    if (packet->cycle_stream_mode) {
+        Stream_Buffer* stream = &app->rect_renderer.stream;
+        stream_buffer_set_mode(
+            stream, (stream->mode + 1) % STREAM_BUFFER_MODE_COUNT
+        );
+        app->draw_timing = (Frame_Timing){0};
+        log_msg("rect upload: %s", stream_buffer_mode_name(stream->mode));
+    }
+    frame_timing_begin(&app->draw_timing);
+#endif
+    gl_state_begin_frame();
+    gpu_timer_begin_frame();
+    app_update_viewports(app, packet);
+    rect_renderer_begin_frame(&app->rect_renderer);
+#if defined(CRLF_USE_FRAME_CAPTURE)
+    frame_capture_request(&app->frame_capture, packet->capture_request);
+    frame_capture_update(&app->frame_capture);
+#endif
+
+    const bool ui_to_back_buffer = app_ui_to_back_buffer(app, packet);
+
+    App_Pass_Context ctx   = {.app = app, .packet = packet};
+    Render_Graph*    graph = &app->render_graph;
+    Render_Pass composite  = {
+        .execute = app_pass_composite,
+        .user_data = &ctx,
+        .output = RENDER_GRAPH_WINDOW,
+    };
+    render_graph_reset(graph);
+#if defined(CRLF_USE_GAMEVIEWPORT)
+    const i32 game_color = render_graph_add_attachment(
+        graph, app->viewport_game.frame_buffer_size,
+        viewport_format(&app->viewport_game)
+    );
+    render_graph_add_pass(
+        graph, (Render_Pass){
+            .execute = app_pass_game,
+            .user_data = &ctx,
+            .output = game_color,
+        }
+    );
+    composite.inputs[composite.num_inputs++] = game_color;
+#endif
+    if (ui_to_back_buffer) {
+#if defined(CRLF_USE_UI_DAMAGE)
+        app_release_ui_target(app);
+#endif
+        render_graph_add_pass(
+            graph, (Render_Pass){
+                .execute = app_pass_ui,
+                .user_data = &ctx,
+                .output = RENDER_GRAPH_WINDOW,
+            }
+        );
+    } else {
+#if defined(CRLF_USE_UI_DAMAGE)
+        const i32 ui_color = render_graph_import_attachment(
+            graph, app_acquire_ui_target(app)
+        );
+#else
+        const i32 ui_color = render_graph_add_attachment(
+            graph, app->viewport_ui.frame_buffer_size,
+            viewport_format(&app->viewport_ui)
+        );
+#endif
+        render_graph_add_pass(
+            graph, (Render_Pass){
+                .execute = app_pass_ui,
+                .user_data = &ctx,
+                .output = ui_color,
+            }
+        );
+        composite.inputs[composite.num_inputs++] = ui_color;
+        render_graph_add_pass(graph, composite);
+#if defined(CRLF_USE_FRAME_CAPTURE)
+        if (frame_capture_is_active(&app->frame_capture)) {
+            Render_Pass capture = composite;
+            capture.execute     = app_pass_capture;
+            render_graph_add_pass(graph, capture);
+        }
+#endif
+    }
+    render_graph_execute(graph, &app->render_target_pool);
+#if defined(CRLF_USE_GAMEVIEWPORT)
+    app->viewport_game.target = NULL;
+#endif
+    app->viewport_ui.target = NULL;
+    rect_renderer_end_frame(&app->rect_renderer);
+
+#if defined(__DEBUG__)
+    //Excludes the swap as that would measure vsync rather than our cpu time
+    double avg_draw_ms;
+    if (frame_timing_end(&app->draw_timing, &avg_draw_ms)) {
+        float ui_redrawn = 1.f; //of the last frame only
+#if defined(CRLF_USE_UI_DAMAGE)
+        ui_redrawn = packet->ui_damage.ratio;
+#endif
+        log_msg(
+            "build cpu avg: %.3f ms, submit cpu avg: %.3f ms "
+            "(rect upload: %s, %zu bytes, ui target: %s, ui redrawn: %.0f%%, "
+            "render scale: %.3f (%s, gpu ~%.2f ms), "
+            "fence stalls: %d, "
+            "rects: %zu, culled: %zu, translucent: %zu, batches: %d, "
+            "occluded: %zu rects / %zu subtrees / ~%.0f px, "
+            "cached layers: %d reused / %d rebuilt, "
+            "tilemaps: %d, %zu bytes, "
+            "render targets: %.1f MiB, %d allocations, "
+            "gl calls: %d issued / %d elided)",
+            packet->avg_build_ms,
+            avg_draw_ms,
+            stream_buffer_mode_name(app->rect_renderer.stream.mode),
+            app->rect_renderer.stream.upload_bytes,
+            ui_to_back_buffer ? "back buffer" : "viewport",
+            ui_redrawn * 100.f,
+            packet->ui_render_scale,
+            packet->is_resolution_automatic ? "auto" : "fixed",
+            packet->resolution_frame_ms,
+            app->rect_renderer.stream.num_fence_stalls,
+            packet->cull_stats.num_kept,
+            packet->cull_stats.num_culled,
+            packet->instances.curr_len - packet->num_opaque,
+            app->rect_renderer.num_batches,
+            packet->occlusion_stats.num_rects,
+            packet->occlusion_stats.num_subtrees,
+            packet->occlusion_stats.num_pixels,
+            packet->num_layer_hits,
+            packet->num_layer_rebuilds,
+            packet->tilemaps.num_draws,
+            app->tilemap_renderer.upload_bytes,
+            (double)app->render_target_pool.memory_size / (1024.0 * 1024.0),
+            app->render_target_pool.num_allocations,
+            gl_state.num_issued,
+            gl_state.num_elided
+        );
+        app->rect_renderer.stream.num_fence_stalls = 0;
+    }
+#endif
 
     SDL_GL_SwapWindow(app->window.sdl);
 }
 
+#if defined(CRLF_USE_RENDER_THREAD)
+int render_thread_run(void* data) {
+    App*           app           = data;
+    Render_Thread* render_thread = &app->render_thread;
+    SDL_GL_MakeCurrent(app->window.sdl, app->window.gl_context);
+    for (;;) {
+        SDL_WaitSemaphore(render_thread->ready);
+        const Frame_Packet* packet =
+            &app->frame_packets[render_thread->read_index];
+        if (packet->quit) break;
+        app_submit_frame(app, packet);
+        render_thread->read_index =
+            (render_thread->read_index + 1) % FRAME_PACKET_COUNT;
+        SDL_SignalSemaphore(render_thread->free);
+    }
+    SDL_GL_MakeCurrent(app->window.sdl, NULL);
+    return 0;
+}
+
+//Hands the gl context over to the render thread, gl must not be used on the
+//main thread until render_thread_stop
+static bool render_thread_start(App* app) {
+    Render_Thread* render_thread = &app->render_thread;
+    *render_thread               = (Render_Thread){
+        .free = SDL_CreateSemaphore(FRAME_PACKET_COUNT),
+        .ready = SDL_CreateSemaphore(0),
+    };
+    SDL_assert(render_thread->free != NULL && render_thread->ready != NULL);
+
+    SDL_GL_MakeCurrent(app->window.sdl, NULL);
+    render_thread->thread = SDL_CreateThread(render_thread_run, "render", app);
+    if (render_thread->thread == NULL) {
+        log_error("Failed to create render thread: %s", SDL_GetError());
+        SDL_GL_MakeCurrent(app->window.sdl, app->window.gl_context);
+        return false;
+    }
+    return true;
+}
+
+//Lets the render thread draw the packets in flight and takes the gl context
+//back to the main thread
+static void render_thread_stop(App* app) {
+    Render_Thread* render_thread = &app->render_thread;
+    if (render_thread->thread != NULL) {
+        SDL_WaitSemaphore(render_thread->free);
+        app->frame_packets[render_thread->write_index].quit = true;
+        SDL_SignalSemaphore(render_thread->ready);
+        SDL_WaitThread(render_thread->thread, NULL);
+        SDL_GL_MakeCurrent(app->window.sdl, app->window.gl_context);
+    }
+    if (render_thread->free != NULL) SDL_DestroySemaphore(render_thread->free);
+    if (render_thread->ready != NULL)
+        SDL_DestroySemaphore(render_thread->ready);
+    *render_thread = (Render_Thread){0};
+}
+#endif
+
+static void app_draw(App* app) {
+    if (app->headless.is_enabled) {
+        const u64 start = SDL_GetPerformanceCounter();
+        app_build_frame(app, &app->frame_packets[0]);
+        soft_renderer_submit(
+            &app->headless.soft_renderer, &app->frame_packets[0]
+        );
+        app->headless.draw_ticks += SDL_GetPerformanceCounter() - start;
+        return;
+    }
+#if defined(CRLF_USE_RENDER_THREAD)
+    //blocks while the render thread is FRAME_PACKET_COUNT frames behind
+    Render_Thread* render_thread = &app->render_thread;
+    SDL_WaitSemaphore(render_thread->free);
+    app_build_frame(app, &app->frame_packets[render_thread->write_index]);
+    render_thread->write_index =
+        (render_thread->write_index + 1) % FRAME_PACKET_COUNT;
+    SDL_SignalSemaphore(render_thread->ready);
+#else
+    app_build_frame(app, &app->frame_packets[0]);
+    app_submit_frame(app, &app->frame_packets[0]);
+#endif
+}
+
 static void app_cleanup(App* app) {
+#if defined(CRLF_USE_RENDER_THREAD)
+    render_thread_stop(app);
+#endif
+    const bool is_headless = app->headless.is_enabled;
     resources_cleanup(&app->resources);
-    texture_array_free(&app->texture_array);
-
-    delete_shader_program(&app->rect_shader);
-    delete_shader_program(&app->viewport_shader);
+    if (is_headless) {
+        soft_renderer_cleanup(&app->headless.soft_renderer);
+    } else {
+        texture_array_set_cleanup(&app->texture_arrays);
+        delete_shader_program(&app->rect_shader);
+        delete_shader_program(&app->viewport_shader);
+    }
 
 #if defined(__DEBUG__)
     hot_reload_cleanup(&app->hot_reload);
 #endif
 
     ui_context_cleanup();
-#if defined(CRLF_USE_GAMEVIEWPORT)
-    viewport_cleanup(&app->viewport_game);
+    if (!is_headless) {
+        render_target_pool_cleanup(&app->render_target_pool);
+#if defined(CRLF_USE_FRAME_CAPTURE)
+        frame_capture_cleanup(&app->frame_capture);
+#endif
+        rect_renderer_cleanup(&app->rect_renderer);
+        rect_layer_buffers_cleanup(&app->rect_layer_buffers);
+        tilemap_renderer_cleanup(&app->tilemap_renderer);
+        renderer_cleanup(&app->viewport_renderer);
+        gpu_timer_cleanup();
+        SDL_GL_DestroyContext(app->window.gl_context);
+    }
+    rect_buffer_cleanup(&app->rect_buffer);
+    rect_instance_buffer_cleanup(&app->rect_instance_buffer);
+    rect_sort_cleanup(&app->rect_sort);
+    rect_layer_cache_cleanup(&app->rect_layer_cache);
+    tilemap_cache_cleanup(&app->tilemap_cache);
+#if defined(CRLF_USE_UI_DAMAGE)
+    ui_damage_tracker_cleanup(&app->ui_damage_tracker);
+#endif
+    for (i32 i = 0; i < FRAME_PACKET_COUNT; i++) {
+        frame_packet_cleanup(&app->frame_packets[i]);
+    }
+#if defined(CRLF_USE_RECT_BUILD_THREADS)
+    rect_build_pool_cleanup(&app->rect_build_pool);
 #endif
-    viewport_cleanup(&app->viewport_ui);
-    renderer_cleanup(&app->rect_renderer);
-    renderer_cleanup(&app->viewport_renderer);
-    SDL_GL_DestroyContext(app->window.gl_context);
     if (app->window.sdl)
         SDL_DestroyWindow(app->window.sdl);
     CRLF_free(app);
@@ -2800,22 +8855,42 @@ static void app_event_key_down(App* app, const SDL_KeyboardEvent event) {
 
 #if defined(__DEBUG__)
     switch (event.key) {
+    case SDLK_F1:
+        //cycle the rect upload strategy to benchmark them via draw_timing,
+        //applied by app_submit_frame as the stream belongs to the gl thread
+        app->cycle_stream_mode = true;
+        return;
+    case SDLK_F2:
+        benchmark_rect_kernels();
+        return;
+#if defined(CRLF_USE_FRAME_CAPTURE)
+    case SDLK_F6:
+        app->capture_request = FRAME_CAPTURE_REQUEST_SCREENSHOT;
+        return;
+    case SDLK_F4:
+        app->capture_request = FRAME_CAPTURE_REQUEST_TOGGLE_SEQUENCE;
+        return;
+#endif
     case SDLK_SPACE:
         SDL_GetWindowFullscreenMode(app->window.sdl);
         SDL_SetWindowFullscreen(app->window.sdl, !app->window.fullscreen);
         return;
-    case SDLK_MINUS:
-        if (app->viewport_ui.frame_buffer_divisor == 1) return;
-        app->viewport_ui.frame_buffer_divisor -= 1;
-        viewport_generate(
-            &app->viewport_ui, (ivec2){app->window.width, app->window.height}
+    case SDLK_F5:
+        app->resolution_scaler.is_automatic =
+            !app->resolution_scaler.is_automatic && gpu_timer.is_available;
+        log_msg(
+            "dynamic resolution: %s",
+            app->resolution_scaler.is_automatic ? "on" : "off"
         );
         return;
+    //picking the scale by hand turns the dynamic resolution off
+    case SDLK_MINUS:
+        app->resolution_scaler.is_automatic = false;
+        resolution_scaler_step(&app->resolution_scaler, 1);
+        return;
     case SDLK_EQUALS:
-        app->viewport_ui.frame_buffer_divisor += 1;
-        viewport_generate(
-            &app->viewport_ui, (ivec2){app->window.width, app->window.height}
-        );
+        app->resolution_scaler.is_automatic = false;
+        resolution_scaler_step(&app->resolution_scaler, -1);
         return;
     default:
 #endif
@@ -2862,7 +8937,18 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
         return SDL_APP_FAILURE;
     }
 
-    if (!SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO)) {
+    Headless headless = {0};
+    if (argc > 1 && SDL_strcmp(argv[1], "--headless") == 0) {
+        headless = (Headless){
+            .is_enabled = true,
+            .num_frames = argc > 2 ?
+                SDL_atoi(argv[2]) : HEADLESS_DEFAULT_FRAMES,
+            .output_path = argc > 3 ? argv[3] : HEADLESS_DEFAULT_OUTPUT,
+        };
+        headless.num_frames = SDL_max(headless.num_frames, 1);
+    }
+
+    if (!SDL_Init(headless.is_enabled ? 0 : SDL_INIT_AUDIO | SDL_INIT_VIDEO)) {
         SDL_LogError(0, "Failed to initialize SDL: %s", SDL_GetError());
         return SDL_APP_FAILURE;
     }
@@ -2876,6 +8962,19 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
     init_app_ptr(app);
     *appstate = app;
 
+    //no window, gl context or render thread - see soft_renderer_submit
+    if (headless.is_enabled) {
+        app->headless  = headless;
+        app->has_focus = true;
+        if (!app_init(app))
+            return SDL_APP_FAILURE;
+        log_msg(
+            "headless: %d frames at %dx%d to %s", headless.num_frames,
+            app->window.width, app->window.height, headless.output_path
+        );
+        return SDL_APP_CONTINUE;
+    }
+
 #if !defined(SDL_PLATFORM_EMSCRIPTEN)
     //Part of the UI simplification fallback approach @ day 4 (end-jam)
     //make 1:1 aspect ratio fit the display for desktop
@@ -2888,6 +8987,12 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
     app->window.height = smaller_display_size;
 #endif
 
+#if defined(CRLF_USE_SRGB_BACK_BUFFER)
+    //the pixel format of the window is picked on creation
+    SDL_GL_SetAttribute(SDL_GL_FRAMEBUFFER_SRGB_CAPABLE, 1);
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+#endif
+
     SDL_Window* window = SDL_CreateWindow(
         APP_TITLE,
         app->window.width, app->window.height,
@@ -2931,6 +9036,11 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
     if (!app_init(app))
         return SDL_APP_FAILURE;
 
+#if defined(CRLF_USE_RENDER_THREAD)
+    if (!render_thread_start(app))
+        return SDL_APP_FAILURE;
+#endif
+
     app->last_tick = SDL_GetTicks();
 
     return SDL_APP_CONTINUE;
@@ -2959,8 +9069,33 @@ SDL_AppResult SDL_AppInit(void** appstate, int argc, char** argv) {
  * You do not check the event queue in this function (SDL_AppEvent exists
  * for that).
  */
+//Draws the frames as fast as possible, then reports and saves the last one
+static SDL_AppResult app_iterate_headless(App* app) {
+    Headless* headless = &app->headless;
+    app_tick(app);
+    app_draw(app);
+    if (++headless->frame < headless->num_frames) return SDL_APP_CONTINUE;
+
+    const Soft_Renderer* renderer = &headless->soft_renderer;
+    const double seconds = (double)headless->draw_ticks /
+        (double)SDL_GetPerformanceFrequency();
+    const double num_pixels = (double)renderer->width *
+        (double)renderer->height * (double)headless->num_frames;
+    log_msg(
+        "headless: %.3f ms/frame, %.1f fps, %.1f Mpixel/s "
+        "(%dx%d, %zu rects, %d raster threads)",
+        seconds * 1000.0 / (double)headless->num_frames,
+        (double)headless->num_frames / seconds, num_pixels / seconds / 1.0e6,
+        renderer->width, renderer->height, renderer->num_rects,
+        renderer->num_workers + 1
+    );
+    return soft_renderer_save_bmp(renderer, headless->output_path) ?
+               SDL_APP_SUCCESS : SDL_APP_FAILURE;
+}
+
 SDL_AppResult SDL_AppIterate(void* appstate) {
     App* app = appstate;
+    if (app->headless.is_enabled) return app_iterate_headless(app);
     if (!app->has_focus) return SDL_APP_CONTINUE;
 
     const u64 now = SDL_GetTicks();
@@ -2993,18 +9128,9 @@ SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
             "Window Resized: callback data: %dx%d",
             event->window.data1, event->window.data2
         );
+        //the viewports get re-created with the next frame drawn
         app->window.width  = event->window.data1;
         app->window.height = event->window.data2;
-#if defined(CRLF_USE_GAMEVIEWPORT)
-        viewport_generate(
-            &app->viewport_game,
-            (ivec2){app->window.width, app->window.height}
-        );
-#endif
-        viewport_generate(
-            &app->viewport_ui,
-            (ivec2){app->window.width, app->window.height}
-        );
         break;
 
     case SDL_EVENT_KEY_DOWN:
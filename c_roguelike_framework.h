@@ -113,6 +113,13 @@ static vec2 vec2_add_vec2(const vec2 a, const vec2 b) {
     };
 }
 
+static vec2 vec2_add_float(const vec2 a, const float b) {
+    return (vec2){
+        a.x + b,
+        a.y + b,
+    };
+}
+
 static vec2 vec2_sub_vec2(const vec2 a, const vec2 b) {
     return (vec2){
         a.x - b.x,
@@ -297,6 +304,8 @@ extern UI_Context*        ui_ctx;
 
 #define UI_IMAGE(...) ui_image_element((UI_Image_Config)__VA_ARGS__ )
 
+#define UI_TILEMAP(...) ui_tilemap_element((UI_Tilemap_Config)__VA_ARGS__ )
+
 #define UI_ANCHOR_CENTER (vec2){ .x = 0.5f, .y = 0.5f }
 
 typedef enum {
@@ -304,6 +313,7 @@ typedef enum {
     UI_ELEMENT_TYPE_CONTAINER,
     UI_ELEMENT_TYPE_TEXT,
     UI_ELEMENT_TYPE_IMAGE,
+    UI_ELEMENT_TYPE_TILEMAP,
 } UI_Element_Type;
 
 typedef enum {
@@ -339,6 +349,9 @@ typedef struct {
     bool              is_hidden;
     bool              is_slice_center_hidden;
     float             sort_order_override;
+    //retains the generated rects of this subtree in their own gpu buffer,
+    //they are only rebuilt if they change. Requires a unique id.
+    bool is_cached;
 } UI_Container_Config;
 
 typedef struct {
@@ -358,7 +371,7 @@ typedef struct {
     UI_Alignment      align;
     vec3              color;
     vec3              outline_color;
-    float             outline;
+    float             outline; //width, capped by the font's sdf padding
     bool              bg_slice;
     i32               bg_slice_id;
     //Calculated during the size_pos pass
@@ -432,6 +445,24 @@ typedef struct {
     UI_Image_Tex_Coords coords;
 } UI_Image_Texture;
 
+typedef enum {
+    UI_ANIMATION_NONE   = 0,
+    UI_ANIMATION_PULSE  = 1 << 0, //color swings to pulse_color and back
+    UI_ANIMATION_WOBBLE = 1 << 1, //position swings by up to amplitude
+} UI_Animation_Flags;
+
+//Evaluated on the gpu against the frame time - animated images cost nothing on
+//the cpu and can sit in cached containers. Mirrors the animated tilemap tiles.
+typedef struct {
+    u32 flags; //UI_Animation_Flags
+    //seconds added to the time, x drives the pulse and the x wobble, y the y
+    //wobble. E.g. the grid position keeps neighbours out of sync.
+    vec2  phase;
+    float frequency; //wobble in radians per second, the pulse runs at 1
+    vec2  amplitude; //wobble, y runs at 3/4 of the frequency
+    vec3  pulse_color;
+} UI_Animation;
+
 typedef struct {
     u32               id;
     UI_Image_Texture  texture;
@@ -439,8 +470,40 @@ typedef struct {
     vec3              color;
     vec2              pivot;
     bool              blocks_cursor;
+    float             transparency; //0 = opaque
+    UI_Animation      animation;
 } UI_Image_Config;
 
+#define UI_TILEMAP_MAX_TILE_TYPES 16
+
+//Appearance of one tile type, evaluated per pixel in the tilemap shader
+typedef struct {
+    Texture_Atlas_Cell cell;
+    vec3               color;
+    //animated tiles pulse between color and pulse_color and wobble inside
+    //their cell, both phases are offset by the tile position
+    bool  is_animated;
+    vec3  pulse_color;
+    float wobble_speed;
+    float wobble_displace;
+} UI_Tilemap_Tile;
+
+//A grid of tiles drawn as a single quad, the cost only depends on its screen
+//size. tiles and tile_types have to stay valid until the frame is drawn.
+typedef struct {
+    u32               id; //required, identifies the tile texture on the gpu
+    UI_Element_Layout layout;
+    const i32*        tiles; //size.x * size.y tile types, rows from the bottom
+    ivec2             size;
+    //bump when tiles changed - only then they get uploaded again
+    u32  version;
+    vec2 view_min;  //bottom left of the visible region in tiles
+    vec2 view_size; //in tiles, tiles outside of the grid stay empty
+    i32  texture_id;
+    const UI_Tilemap_Tile* tile_types; //indexed by the values in tiles
+    i32                    num_tile_types;
+} UI_Tilemap_Config;
+
 typedef struct {
     size_t            index;
     size_t            depth;
@@ -451,6 +514,7 @@ typedef struct {
         UI_Container_Config container;
         UI_Text_Config      text;
         UI_Image_Config     image;
+        UI_Tilemap_Config   tilemap;
     } config;
 
     size_t first_child_index;
@@ -566,6 +630,16 @@ static void ui_image_element(
     ui_element_end();
 }
 
+static void ui_tilemap_element(
+    const UI_Tilemap_Config config
+) {
+    ui_element_start();
+    ui_ctx->temp_elem.type           = UI_ELEMENT_TYPE_TILEMAP;
+    ui_ctx->temp_elem.config.tilemap = config;
+    ui_element_set_layout(config.layout);
+    ui_element_end();
+}
+
 /* RANDOM *********************************************************************/
 // XorShift128+ implementation
 typedef struct {
@@ -618,14 +692,45 @@ static i32 random_int_range(Random* state, const i32 min, const i32 max) {
 
 /* PUBLIC API ******************************************************************/
 //TODO: as we now needed to link the gamelib to SDL the log functions are redundant
-void log_msg(const char* fmt, ...);
-void log_warning(const char* fmt, ...);
-void log_error(const char* fmt, ...);
+void log_msg(SDL_PRINTF_FORMAT_STRING const char* fmt, ...)
+    SDL_PRINTF_VARARG_FUNC(1);
+void log_warning(SDL_PRINTF_FORMAT_STRING const char* fmt, ...)
+    SDL_PRINTF_VARARG_FUNC(1);
+void log_error(SDL_PRINTF_FORMAT_STRING const char* fmt, ...)
+    SDL_PRINTF_VARARG_FUNC(1);
+
+//Render passes timed on the gpu
+typedef enum {
+    CRLF_GPU_PASS_GAME,      //game viewport, CRLF_USE_GAMEVIEWPORT only
+    CRLF_GPU_PASS_UI,        //ui viewport: rects, cached layers and tilemaps
+    CRLF_GPU_PASS_BLIT_GAME, //game viewport to the window
+    CRLF_GPU_PASS_BLIT_UI,   //ui viewport to the window
+    CRLF_GPU_PASS_COUNT,
+} CRLF_GPU_Pass;
+
+#define CRLF_GPU_TIMING_HISTORY 64
+
+typedef struct {
+    float history_ms[CRLF_GPU_TIMING_HISTORY]; //ring buffer
+    i32   newest;      //index of the latest sample in history_ms
+    i32   num_samples; //up to CRLF_GPU_TIMING_HISTORY
+    float avg_ms;      //over all samples in history_ms
+} CRLF_GPU_Pass_Timing;
+
+//Results lag a few frames behind, as they are read back without stalling
+typedef struct {
+    bool                 is_available; //false without timer query support
+    CRLF_GPU_Pass_Timing passes[CRLF_GPU_PASS_COUNT];
+} CRLF_GPU_Timings;
 
 typedef struct {
-    void (*log_msg)(const char* fmt, ...);
-    void (*log_warning)(const char* fmt, ...);
-    void (*log_error)(const char* fmt, ...);
+    void (*log_msg)(SDL_PRINTF_FORMAT_STRING const char* fmt, ...)
+        SDL_PRINTF_VARARG_FUNC(1);
+    void (*log_warning)(SDL_PRINTF_FORMAT_STRING const char* fmt, ...)
+        SDL_PRINTF_VARARG_FUNC(1);
+    void (*log_error)(SDL_PRINTF_FORMAT_STRING const char* fmt, ...)
+        SDL_PRINTF_VARARG_FUNC(1);
+    void (*get_gpu_timings)(CRLF_GPU_Timings* timings);
 } CRLF_API;
 
 #endif //C_ROGUELIKE_FRAMEWORK_H
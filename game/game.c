@@ -16,6 +16,18 @@ static const char* GAME_TITLE = "Micro Monarch";
 
 #define TXC_TILE_GRID ui_image_tex_coords_atlas_row_colum(3,3)
 
+//Draws the world as a single UI_TILEMAP instead of one UI_IMAGE per tile
+#define GAME_WORLD_USE_TILEMAP
+
+#if defined(GAME_WORLD_USE_TILEMAP)
+//World.tiles is handed to the tilemap as is
+SDL_COMPILE_TIME_ASSERT(tile_type_size, sizeof(Tile_Type) == sizeof(i32));
+
+static const i32 ZOOM_TILES_IN_VIEW[] = {11, 23, 47, 95, 191, WORLD_SIZE + 1};
+#define NUM_ZOOM_LEVELS \
+    (i32)(sizeof(ZOOM_TILES_IN_VIEW) / sizeof(ZOOM_TILES_IN_VIEW[0]))
+#endif
+
 /* CHARACTERS******************************************************************/
 #define TXC_CHARACTER_MONARCH ui_image_tex_coords_atlas_row_colum(0,0)
 #define TXC_CHARACTER_DEER ui_image_tex_coords_atlas_row_colum(3,0)
@@ -208,8 +220,7 @@ void draw_tile(
         const float wave_strength = 1.5f;
         const float wave_displace = 1.25f;
         UI_IMAGE({
-            .color = vec3_lerp(COLOR_BLUE, COLOR_AQUA,
-                (SDL_sin(ui_ctx->time + world_x * world_y) + 1.f ) / 2.0f),
+            .color = COLOR_BLUE,
             .pivot = {0.f, 0.f},
             .texture = {
                 .id = res_id->tiles,
@@ -218,21 +229,58 @@ void draw_tile(
             .layout = {
                 .anchor = {0.0f, 0.0f},
                 .offset = {
-                    x * tile_size + SDL_sin((ui_ctx->time + world_x*world_y) *
-                wave_strength) * tile_size * wave_displace / 40.f,
-                    y * tile_size + SDL_sin((ui_ctx->time + world_x) *
-                wave_strength * .75f) * tile_size * wave_displace / 20.f,
+                    x * tile_size,
+                    y * tile_size,
                     },
                 .size = tile_size_vec,
             },
+            .animation = {
+                .flags = UI_ANIMATION_PULSE | UI_ANIMATION_WOBBLE,
+                .phase = {(float)(world_x * world_y), (float)world_x},
+                .frequency = wave_strength,
+                .amplitude = {
+                    tile_size * wave_displace / 40.f,
+                    tile_size * wave_displace / 20.f,
+                },
+                .pulse_color = COLOR_AQUA,
+            },
         });
         break;
     }
     }
 }
 
+#if defined(GAME_WORLD_USE_TILEMAP)
+//Indexed by Tile_Type. Static as the tilemap is only drawn after game_draw.
+static const UI_Tilemap_Tile* world_tile_types(i32* num_tile_types) {
+    static UI_Tilemap_Tile tile_types[TILE_TYPE_GRID + 1];
+    tile_types[TILE_TYPE_FOREST] = (UI_Tilemap_Tile){
+        .cell = {3, 0}, .color = COLOR_WHITE,
+    };
+    tile_types[TILE_TYPE_MOUNTAIN] = (UI_Tilemap_Tile){
+        .cell = {3, 1}, .color = COLOR_WHITE,
+    };
+    tile_types[TILE_TYPE_WATER] = (UI_Tilemap_Tile){
+        .cell = {3, 2},
+        .color = COLOR_BLUE,
+        .is_animated = true,
+        .pulse_color = COLOR_AQUA,
+        .wobble_speed = 1.5f,
+        .wobble_displace = 1.25f,
+    };
+    tile_types[TILE_TYPE_GRASS] = (UI_Tilemap_Tile){
+        .cell = {2, 0}, .color = COLOR_WHITE,
+    };
+    tile_types[TILE_TYPE_GRID] = (UI_Tilemap_Tile){
+        .cell = {3, 3}, .color = COLOR_WHITE,
+    };
+    *num_tile_types = TILE_TYPE_GRID + 1;
+    return &tile_types[0];
+}
+#endif
+
 void draw_game_world(const Game* game) {
-    const int tiles_in_view = 11;
+    const int tiles_in_view = game->tiles_in_view;
     const int center        = tiles_in_view/2;
     const float tile_size   = 650.f / (float)tiles_in_view;
 
@@ -249,6 +297,25 @@ void draw_game_world(const Game* game) {
         .bg_color = COLOR_BLUE,
         .is_hidden = true,
     }) {
+#if defined(GAME_WORLD_USE_TILEMAP)
+        i32                    num_tile_types;
+        const UI_Tilemap_Tile* tile_types = world_tile_types(&num_tile_types);
+        UI_TILEMAP({
+            .id = UI_ID("GameWorldTiles"),
+            .layout = {
+                .anchor = UI_ANCHOR_CENTER,
+                .size = {650.f, 650.f},
+            },
+            .tiles = (const i32*)&game->world.tiles[0],
+            .size = {WORLD_SIZE, WORLD_SIZE},
+            .version = game->world.tiles_version,
+            .view_min = {(float)bottom_left_x, (float)bottom_left_y},
+            .view_size = {(float)tiles_in_view, (float)tiles_in_view},
+            .texture_id = res_id->tiles,
+            .tile_types = tile_types,
+            .num_tile_types = num_tile_types,
+        });
+#else
         for (int x = 0; x<tiles_in_view; x++) {
             for (int y = 0; y<tiles_in_view; y++) {
                 const i32 world_x = bottom_left_x + x;
@@ -264,6 +331,7 @@ void draw_game_world(const Game* game) {
                 }
             }
         }
+#endif
 
         UI({
             .layout = {
@@ -302,6 +370,7 @@ void draw_game_menu_top_bar() {
             .size = {650.f,64.f},
         },
         .bg_color = COLOR_RED,
+        .is_cached = true,
         }) {
         UI_TEXT(STRING("The Labrador Grasslands"), {
             .layout = {
@@ -337,6 +406,7 @@ void draw_game_menu_side_bar(const Game* game) {
             .size = {GAME_SIDEBAR_WIDTH, 1000.f},
         },
         .bg_color = COLOR_RED,
+        .is_cached = true,
     }) {
         UI_TEXT(STRING(GAME_TITLE), {
             .layout = {
@@ -514,6 +584,47 @@ void draw_game_menu_bottom() {
     draw_game_menu_actions(nav_size);
 }
 
+static const char* GPU_PASS_NAMES[CRLF_GPU_PASS_COUNT] = {
+    "game", "ui", "blit game", "blit ui",
+};
+
+//Shows the gpu time of the render passes, toggled with F3
+void draw_gpu_timings(const Game* game) {
+    if (!game->show_gpu_timings) return;
+    CRLF_GPU_Timings timings;
+    api->get_gpu_timings(&timings);
+
+#define GAME_GPU_TIMINGS_BYTES 256
+    char* str = arena_alloc(&ui_ctx->string_arena, GAME_GPU_TIMINGS_BYTES);
+    str[0]    = '\0';
+    if (!timings.is_available) {
+        SDL_snprintf(str, GAME_GPU_TIMINGS_BYTES, "gpu timings unavailable");
+    } else {
+        size_t len = 0;
+        for (i32 i = 0; i < CRLF_GPU_PASS_COUNT; i++) {
+            const CRLF_GPU_Pass_Timing* pass = &timings.passes[i];
+            if (pass->num_samples == 0 || len >= GAME_GPU_TIMINGS_BYTES)
+                continue;
+            len += SDL_snprintf(
+                &str[len], GAME_GPU_TIMINGS_BYTES - len, "%sgpu %s: %.3f ms",
+                len > 0 ? "\n" : "", GPU_PASS_NAMES[i], pass->avg_ms
+            );
+        }
+    }
+
+    UI_TEXT(STRING(str), {
+        .layout = {
+            .anchor = {0.f, 1.f},
+            .offset = {5.f, -80.f},
+        },
+        .align = {.x = UI_ALIGNMENT_X_RIGHT},
+        .color = COLOR_WHITE,
+        .scale = .1f,
+        .outline = 4.f,
+        .outline_color = COLOR_BLACK,
+    });
+}
+
 void draw_gameplay(const Game* game) {
     UI({
         .layout = ROOT_LAYOUT,
@@ -524,6 +635,7 @@ void draw_gameplay(const Game* game) {
         draw_game_menu_top_bar();
         draw_game_menu_side_bar(game);
         draw_game_menu_bottom();
+        draw_gpu_timings(game);
     }
 }
 
@@ -684,6 +796,7 @@ void draw_main_menu() {
                 .size = {400.f, 900.f},
             },
             .bg_color = COLOR_RED,
+            .is_cached = true,
         }) {
             UI_TEXT(STRING(GAME_TITLE), {
                 .id = UI_ID("Game_Title"),
@@ -844,6 +957,7 @@ void generate_world(Game* game) {
             game->world.tiles[TILE_INDEX(x, y)] = tile;
         }
     }
+    game->world.tiles_version++;
 
     for (int i = 0; i < START_NPC_NUM_DEER; i++) {
         const size_t pos_tile_index = random_int_range(
@@ -928,6 +1042,19 @@ void input_move_west(Game* game) {
     end_day(game);
 }
 
+#if defined(GAME_WORLD_USE_TILEMAP)
+//direction > 0 zooms out
+void input_zoom(Game* game, const i32 direction) {
+    i32 level = 0;
+    while (level < NUM_ZOOM_LEVELS - 1 &&
+        ZOOM_TILES_IN_VIEW[level] < game->tiles_in_view) {
+        level++;
+    }
+    level               = SDL_clamp(level + direction, 0, NUM_ZOOM_LEVELS - 1);
+    game->tiles_in_view = ZOOM_TILES_IN_VIEW[level];
+}
+#endif
+
 /* ACTIONS ********************************************************************/
 void action_chop_tree(Game* game) {
     SDL_assert(is_in_world_bounds(game->player.pos_x, game->player.pos_y));
@@ -936,6 +1063,7 @@ void action_chop_tree(Game* game) {
     const Tile_Type tile = game->world.tiles[tile_index];
     SDL_assert(tile == TILE_TYPE_FOREST);
     game->world.tiles[tile_index] = TILE_TYPE_GRASS;
+    game->world.tiles_version++;
     game->wood++;
     end_day(game);
 }
@@ -1070,5 +1198,13 @@ GAME_API void game_keyboard_input(Game* game, SDL_KeyboardEvent event) {
         return;
     case SDLK_E: action_chop_tree(game);
         return;
+    case SDLK_F3: game->show_gpu_timings = !game->show_gpu_timings;
+        return;
+#if defined(GAME_WORLD_USE_TILEMAP)
+    case SDLK_Z: input_zoom(game, 1);
+        return;
+    case SDLK_X: input_zoom(game, -1);
+        return;
+#endif
     }
 }
@@ -110,6 +110,7 @@ typedef struct {
 
 typedef struct {
     Tile_Type tiles[WORLD_SIZE * WORLD_SIZE];
+    u32       tiles_version; //bump on every change of tiles
     NPC       npcs[MAX_NPCs];
     i32       num_npcs;
 } World;
@@ -136,6 +137,8 @@ typedef struct {
     fnl_state  fnl;
     Random     random;
     bool       quit_requested;
+    i32        tiles_in_view;
+    bool       show_gpu_timings;
 } Game;
 
 static Game default_game() {
@@ -143,6 +146,7 @@ static Game default_game() {
         .state = GAME_STATE_MENU,
         .player = default_player(),
         .seed = 1337,
+        .tiles_in_view = 11,
     };
 }
 